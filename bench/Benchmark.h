@@ -0,0 +1,129 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "TimeFunction.h"
+
+// This header-only Benchmark namespace implements a minimal microbenchmark harness.
+// A benchmark is a callable that performs some number of operations over a fixed input set and returns that number.
+// It is run repeatedly until a minimum time has passed, and the per operation time of several such runs is reported.
+namespace Benchmark
+{
+	struct Settings
+	{
+		double min_seconds = .1;		// the minimum time of each timed run
+		int repetitions = 5;			// the number of timed runs, the median of which is reported
+		std::string filter {};			// only benchmarks whose name contains filter are run
+		std::string isa {};				// the instruction set of the kernels in use, recorded with the results
+	};
+
+	struct Result
+	{
+		std::string group;
+		std::string name;
+		double ns_per_op;				// median over the repetitions
+		double min_ns_per_op;			// best over the repetitions
+		std::uint64_t ops;				// operations per timed run
+
+		double ops_per_sec() const { return 1e9 / ns_per_op; }
+	};
+
+	// Keeps the compiler from optimizing away the computation of value
+	template <typename T>
+	inline void do_not_optimize(const T& value)
+	{
+		asm volatile("" : : "r"(&value) : "memory");
+	}
+
+	class Runner
+	{
+	public:
+		explicit Runner(Settings settings) : m_settings { std::move(settings) } {}
+
+		// Returns true if the benchmark named group/name matches the filter
+		bool selected(const std::string& group, const std::string& name) const
+		{
+			return (group + '/' + name).find(m_settings.filter) != std::string::npos;
+		}
+
+		// Runs body, which performs some operations and returns how many, and records the time per operation.
+		// Benchmarks that do not match the filter are skipped.
+		template <typename Body>
+		void run(const std::string& group, const std::string& name, Body&& body)
+		{
+			if (!selected(group, name))
+				return;
+			std::string full_name = group + '/' + name;
+
+			body();		// warm up caches and branch predictors
+
+			std::vector<double> ns_per_op;
+			std::uint64_t ops = 0;
+			for (int repetition = 0; repetition < m_settings.repetitions; ++repetition)
+			{
+				// CPU time of this thread, so that other processes do not inflate the results
+				Stopwatch stopwatch { CLOCK_THREAD_CPUTIME_ID };
+				ops = 0;
+				do
+				{
+					ops += static_cast<std::uint64_t>(body());
+				} while (stopwatch.elapsed_seconds() < m_settings.min_seconds);
+				ns_per_op.push_back(static_cast<double>(stopwatch.elapsed_ns()) / static_cast<double>(ops));
+			}
+			std::sort(ns_per_op.begin(), ns_per_op.end());
+
+			Result result { group, name, ns_per_op[ns_per_op.size() / 2], ns_per_op.front(), ops };
+			std::cout << std::left << std::setw(56) << full_name << std::right << std::fixed << std::setprecision(2)
+					  << std::setw(12) << result.ns_per_op << " ns/op" << std::setprecision(0)
+					  << std::setw(16) << result.ops_per_sec() << " ops/s" << std::endl;
+			m_results.push_back(std::move(result));
+		}
+
+		const std::vector<Result>& results() const { return m_results; }
+
+	private:
+		Settings m_settings;
+		std::vector<Result> m_results {};
+	};
+
+	// Writes results to filename as JSON, labelled with e.g. the commit that was benchmarked.
+	// Throws std::runtime_error if the file cannot be written.
+	inline void write_json(const std::string& filename, const std::string& label, const Settings& settings, const std::vector<Result>& results)
+	{
+		std::ofstream out { filename, std::ios::trunc };
+		if (!out)
+			throw std::runtime_error("Error: Unable to open benchmark file " + filename);
+
+		out << std::fixed << std::setprecision(3);
+		out << "{\n  \"label\": \"" << label << "\",\n"
+			<< "  \"timestamp\": " << std::time(nullptr) << ",\n"
+			<< "  \"min_seconds\": " << settings.min_seconds << ",\n"
+			<< "  \"repetitions\": " << settings.repetitions << ",\n"
+			<< "  \"isa\": \"" << settings.isa << "\",\n"
+			<< "  \"benchmarks\": [";
+		bool first = true;
+		for (const auto& result : results)
+		{
+			out << (first ? "\n" : ",\n")
+				<< "    {\"group\": \"" << result.group << "\", \"name\": \"" << result.name << '"'
+				<< ", \"ns_per_op\": " << result.ns_per_op
+				<< ", \"min_ns_per_op\": " << result.min_ns_per_op
+				<< ", \"ops_per_sec\": " << result.ops_per_sec()
+				<< ", \"ops\": " << result.ops << '}';
+			first = false;
+		}
+		out << "\n  ]\n}\n";
+		if (!out)
+			throw std::runtime_error("Error: Unable to write benchmark file " + filename);
+	}
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef IMAGEMETRICS_H
+#define IMAGEMETRICS_H
+
+#include <cmath>
+#include <stdexcept>
+#include "AccumulationBuffer.h"
+
+// This header-only ImageMetrics namespace compares a render against a reference render of the same scene.
+// Both are compared in linear color, before gamma correction and quantization.
+namespace ImageMetrics
+{
+	struct Errors
+	{
+		double rmse;		// root mean squared error over every channel of every pixel
+		double rel_mse;		// mean squared error relative to the squared reference value, so dark and bright regions weigh alike
+	};
+
+	// Keeps the relative error of black reference pixels finite
+	inline constexpr double rel_mse_epsilon = .01;
+
+	// Throws std::invalid_argument if the images are not the same size
+	inline Errors compare(const AccumulationBuffer& image, const AccumulationBuffer& reference)
+	{
+		if (image.width() != reference.width() || image.height() != reference.height())
+			throw std::invalid_argument("Error: the image and reference are not the same size");
+
+		double squared_error = 0;
+		double relative_squared_error = 0;
+		for (int j = 0; j < image.height(); ++j)
+		{
+			for (int i = 0; i < image.width(); ++i)
+			{
+				Color value = image.average(j, i);
+				Color expected = reference.average(j, i);
+				for (std::size_t c = 0; c < 3; ++c)
+				{
+					double error = static_cast<double>(value[c]) - static_cast<double>(expected[c]);
+					squared_error += error * error;
+					relative_squared_error += error * error / (static_cast<double>(expected[c]) * expected[c] + rel_mse_epsilon);
+				}
+			}
+		}
+		double count = 3.0 * image.width() * image.height();
+		return Errors { std::sqrt(squared_error / count), relative_squared_error / count };
+	}
+};
+
+#endif
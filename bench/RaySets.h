@@ -0,0 +1,88 @@
+#ifndef RAYSETS_H
+#define RAYSETS_H
+
+#include <vector>
+#include <cstddef>
+#include "Constants.h"
+#include "Vector3D.h"
+#include "Ray3D.h"
+#include "AABB.h"
+#include "Random.h"
+#include "Camera.h"
+#include "RayPacket.h"
+
+// This header-only RaySets namespace generates the fixed sets of random inputs that the benchmarks run over.
+// Every set reseeds the global generator, so it is identical across runs and independent of which benchmarks are run.
+namespace RaySets
+{
+	// Rays from random points around box toward random points in the box grown by half its size on every side,
+	// so that a fraction of the rays miss. Ray times are spread over [0, 1] for moving objects.
+	inline std::vector<Ray3D> toward(const AABB& box, std::size_t count, unsigned int seed)
+	{
+		Random::mt.seed(seed);
+		Vector3D center { (box.x.min + box.x.max) / 2, (box.y.min + box.y.max) / 2, (box.z.min + box.z.max) / 2 };
+		Vector3D half_size { (box.x.max - box.x.min) / 2, (box.y.max - box.y.min) / 2, (box.z.max - box.z.min) / 2 };
+		float_type distance = 4 * half_size.length();
+
+		std::vector<Ray3D> rays;
+		rays.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			Vector3D origin = center + distance * Vector3D::random_sphere_unit_vector_rejection();	// the same rays as before the closed form samplers
+			Vector3D target = center + 2 * Vector3D::random(-1, 1) * half_size;
+			rays.emplace_back(origin, target - origin, Random::random_float(0, 1));
+		}
+		return rays;
+	}
+
+	// Camera rays of Scene through random pixels of its image
+	template <typename Scene>
+	inline std::vector<Ray3D> camera_rays(std::size_t count, unsigned int seed)
+	{
+		Random::mt.seed(seed);
+		Camera<Scene> camera {};
+
+		std::vector<Ray3D> rays;
+		rays.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			int col = Random::random_int(0, CameraParameters<Scene>::image_width - 1);
+			int row = Random::random_int(0, CameraParameters<Scene>::image_height - 1);
+			rays.push_back(camera.get_ray_sample(col, row));
+		}
+		return rays;
+	}
+
+	// Camera rays of Scene, in groups of RayPacket::size rays through the RayPacket::width x RayPacket::width pixels 
+	// of a random block of its image, as rendered with packets
+	template <typename Scene>
+	inline std::vector<Ray3D> camera_packets(std::size_t count, unsigned int seed)
+	{
+		Random::mt.seed(seed);
+		Camera<Scene> camera {};
+
+		std::vector<Ray3D> rays;
+		rays.reserve(count);
+		while (rays.size() + RayPacket::size <= count)
+		{
+			int block_col = Random::random_int(0, CameraParameters<Scene>::image_width - RayPacket::width);
+			int block_row = Random::random_int(0, CameraParameters<Scene>::image_height - RayPacket::width);
+			for (int lane = 0; lane < RayPacket::size; ++lane)
+				rays.push_back(camera.get_ray_sample(block_col + lane % RayPacket::width, block_row + lane / RayPacket::width));
+		}
+		return rays;
+	}
+
+	// Random points in the cube [-extent, extent]^3
+	inline std::vector<Vector3D> points(float_type extent, std::size_t count, unsigned int seed)
+	{
+		Random::mt.seed(seed);
+		std::vector<Vector3D> points;
+		points.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+			points.push_back(Vector3D::random(-extent, extent));
+		return points;
+	}
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef REDUCEDSCENE_H
+#define REDUCEDSCENE_H
+
+#include <algorithm>
+#include "Constants.h"
+#include "CameraParameters.h"
+
+//the factor that the width and height of benchmarked scenes are divided by
+inline constexpr int scene_reduction_factor = 4;
+
+/**
+ * @brief Scene Tag of a scene rendered at a reduced resolution, so that every scene can be benchmarked quickly.
+ * The world is still made with make_world<Scene>().
+ *
+ * @tparam Scene the tag of the full size scene
+ */
+template <typename Scene>
+struct ReducedScene {};
+
+/**
+ * @brief Defines the Camera parameters of a reduced scene: those of the full size scene,
+ * with the width and height divided by scene_reduction_factor.
+ *
+ */
+template <typename Scene>
+struct CameraParameters<ReducedScene<Scene>> : CameraParameters<Scene> {
+    constexpr static int image_width = std::max(CameraParameters<Scene>::image_width / scene_reduction_factor, 1);
+    constexpr static int image_height = get_image_height(image_width, CameraParameters<Scene>::aspect_ratio);
+};
+
+#endif
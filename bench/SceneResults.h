@@ -0,0 +1,188 @@
+#ifndef SCENERESULTS_H
+#define SCENERESULTS_H
+
+#include <cmath>
+#include <ctime>
+#include <limits>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <algorithm>
+
+// This header-only SceneResults namespace stores the results of the end-to-end scene benchmarks,
+// writes and reads them as JSON, and compares them against the results of a baseline run.
+namespace SceneResults
+{
+	inline constexpr double missing = std::numeric_limits<double>::quiet_NaN();
+
+	struct Result
+	{
+		std::string scene;
+		int width = 0;
+		int height = 0;
+		long samples_per_pixel = 0;
+		double wall_seconds = 0;						// making the world, building the BVH and rendering
+		double render_seconds = 0;
+		double camera_rays_per_sec = 0;
+		double rays_per_sec = missing;					// camera and bounce rays, only counted in a RAYTRACER_STATS build
+		long peak_rss_kb = 0;
+		double rmse = missing;							// against the reference, if there is one
+		double rel_mse = missing;
+		double efficiency = missing;					// 1 / (relMSE * render seconds): quality per second, higher is better
+		double denoise_seconds = missing;				// only with --denoise
+		double denoised_rel_mse = missing;
+		double equivalent_spp = missing;				// the spp that reach the denoised relMSE without denoising, as relMSE ~ 1/spp
+	};
+
+	// Writes a number, or null if it is missing
+	inline std::string json_number(double value)
+	{
+		if (std::isnan(value))
+			return "null";
+		std::ostringstream out;
+		out << std::setprecision(9) << value;
+		return out.str();
+	}
+
+	// Writes results to filename as JSON, one scene per line. Throws std::runtime_error if the file cannot be written.
+	inline void write_json(const std::string& filename, const std::string& label, unsigned int seed, const std::vector<Result>& results)
+	{
+		std::ofstream out { filename, std::ios::trunc };
+		if (!out)
+			throw std::runtime_error("Error: Unable to open results file " + filename);
+
+		out << "{\n  \"label\": \"" << label << "\",\n"
+			<< "  \"timestamp\": " << std::time(nullptr) << ",\n"
+			<< "  \"seed\": " << seed << ",\n"
+			<< "  \"scenes\": [";
+		bool first = true;
+		for (const auto& result : results)
+		{
+			out << (first ? "\n" : ",\n")
+				<< "    {\"scene\": \"" << result.scene << '"'
+				<< ", \"width\": " << result.width
+				<< ", \"height\": " << result.height
+				<< ", \"spp\": " << result.samples_per_pixel
+				<< ", \"wall_seconds\": " << json_number(result.wall_seconds)
+				<< ", \"render_seconds\": " << json_number(result.render_seconds)
+				<< ", \"camera_rays_per_sec\": " << json_number(result.camera_rays_per_sec)
+				<< ", \"rays_per_sec\": " << json_number(result.rays_per_sec)
+				<< ", \"peak_rss_kb\": " << result.peak_rss_kb
+				<< ", \"rmse\": " << json_number(result.rmse)
+				<< ", \"rel_mse\": " << json_number(result.rel_mse)
+				<< ", \"efficiency\": " << json_number(result.efficiency)
+				<< ", \"denoise_seconds\": " << json_number(result.denoise_seconds)
+				<< ", \"denoised_rel_mse\": " << json_number(result.denoised_rel_mse)
+				<< ", \"equivalent_spp\": " << json_number(result.equivalent_spp) << '}';
+			first = false;
+		}
+		out << "\n  ]\n}\n";
+		if (!out)
+			throw std::runtime_error("Error: Unable to write results file " + filename);
+	}
+
+	// Returns the position just past "key": in line, if it is there
+	inline std::optional<std::size_t> find_value(const std::string& line, const std::string& key)
+	{
+		std::size_t position = line.find('"' + key + "\":");
+		if (position == std::string::npos)
+			return std::nullopt;
+		position += key.size() + 3;
+		while (position < line.size() && line[position] == ' ')
+			++position;
+		return position;
+	}
+
+	inline double read_number(const std::string& line, const std::string& key)
+	{
+		auto position = find_value(line, key);
+		if (!position || line.compare(*position, 4, "null") == 0)
+			return missing;
+		return std::stod(line.substr(*position));
+	}
+
+	// Reads the results written by write_json. Throws std::runtime_error if the file cannot be read.
+	inline std::vector<Result> read_json(const std::string& filename)
+	{
+		std::ifstream in { filename };
+		if (!in)
+			throw std::runtime_error("Error: Unable to open results file " + filename);
+
+		std::vector<Result> results;
+		std::string line;
+		while (std::getline(in, line))
+		{
+			auto position = find_value(line, "scene");
+			if (!position)
+				continue;
+			Result result;
+			std::size_t end = line.find('"', *position + 1);
+			result.scene = line.substr(*position + 1, end - *position - 1);
+			result.width = static_cast<int>(read_number(line, "width"));
+			result.height = static_cast<int>(read_number(line, "height"));
+			result.samples_per_pixel = static_cast<long>(read_number(line, "spp"));
+			result.wall_seconds = read_number(line, "wall_seconds");
+			result.render_seconds = read_number(line, "render_seconds");
+			result.camera_rays_per_sec = read_number(line, "camera_rays_per_sec");
+			result.rays_per_sec = read_number(line, "rays_per_sec");
+			result.peak_rss_kb = static_cast<long>(read_number(line, "peak_rss_kb"));
+			result.rmse = read_number(line, "rmse");
+			result.rel_mse = read_number(line, "rel_mse");
+			result.efficiency = read_number(line, "efficiency");
+			result.denoise_seconds = read_number(line, "denoise_seconds");
+			result.denoised_rel_mse = read_number(line, "denoised_rel_mse");
+			result.equivalent_spp = read_number(line, "equivalent_spp");
+			results.push_back(std::move(result));
+		}
+		return results;
+	}
+
+	// Prints how results changed from baseline. A scene regressed if it renders more than tolerance slower,
+	// or its quality per second dropped by more than tolerance. Returns the number of regressed scenes.
+	inline int compare(std::ostream& out, const std::vector<Result>& results, const std::vector<Result>& baseline, double tolerance)
+	{
+		auto percent_change = [](double now, double before) { return 100 * (now - before) / before; };
+		int regressions = 0;
+		out << "Comparison with baseline (tolerance " << tolerance * 100 << "%):\n";
+		for (const auto& result : results)
+		{
+			auto base = std::find_if(baseline.begin(), baseline.end(), [&](const Result& other) { return other.scene == result.scene; });
+			out << "  " << std::left << std::setw(24) << result.scene << std::right;
+			if (base == baseline.end())
+			{
+				out << "not in baseline\n";
+				continue;
+			}
+			if (base->width != result.width || base->height != result.height || base->samples_per_pixel != result.samples_per_pixel)
+			{
+				out << "baseline was rendered with a different size or spp, skipped\n";
+				continue;
+			}
+
+			bool slower = result.render_seconds > base->render_seconds * (1 + tolerance);
+			bool less_efficient = !std::isnan(result.efficiency) && !std::isnan(base->efficiency) &&
+								  result.efficiency < base->efficiency / (1 + tolerance);
+			out << std::fixed << std::setprecision(1)
+				<< "time " << std::showpos << std::setw(7) << percent_change(result.render_seconds, base->render_seconds) << "%";
+			if (!std::isnan(result.efficiency) && !std::isnan(base->efficiency))
+				out << "   efficiency " << std::setw(7) << percent_change(result.efficiency, base->efficiency) << "%";
+			out << std::noshowpos << std::defaultfloat << std::setprecision(6);
+			if (slower || less_efficient)
+			{
+				out << "   REGRESSION (" << (slower ? "slower" : "") << (slower && less_efficient ? ", " : "")
+					<< (less_efficient ? "less efficient" : "") << ')';
+				++regressions;
+			}
+			out << '\n';
+		}
+		out << std::flush;
+		return regressions;
+	}
+};
+
+#endif
@@ -0,0 +1,501 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <array>
+#include <bit>
+#include "Benchmark.h"
+#include "RaySets.h"
+#include "ProcessArguments.h"
+#include "SceneInfo.h"
+#include "ImageData.h"
+#include "AccumulationBuffer.h"
+#include "Kernels.h"
+
+/**
+ * @brief The options that the benchmarks were invoked with.
+ *
+ */
+struct BenchOptions {
+    Benchmark::Settings settings {};
+    std::string json_filename {};   //where the results are written as JSON. empty disables JSON output
+    std::string label {};           //identifies the results in the JSON output, e.g. a commit hash
+    unsigned int seed = 1;          //seeds every input set
+};
+
+constexpr std::size_t set_size = 4096;  //the number of inputs in every fixed input set
+
+/**
+ * @brief Returns the usage message of the benchmarks.
+ *
+ * @param program_name the name the program was invoked with (argv[0])
+ * @return std::string the usage message
+ */
+std::string bench_usage(const std::string& program_name) {
+    return "Usage: " + program_name + " [options]\n"
+           "Options:\n"
+           "  --json <file>          also write the results to file as JSON\n"
+           "  --label <label>        label the JSON results, e.g. with the commit that was benchmarked\n"
+           "  --filter <text>        only run benchmarks whose group/name contains text\n"
+           "  --min-time <s>         the minimum time of every timed run (default: .1)\n"
+           "  --repetitions <n>      the number of timed runs, the median of which is reported (default: 5)\n"
+           "  --seed <n>             the seed of the random input sets (default: 1)\n"
+           "  --isa <name>           use the baseline, avx2 or avx512 kernels (default: the best the CPU supports)";
+}
+
+/**
+ * @brief Takes the main arguments, returns the options of the benchmarks.
+ * Throws std::invalid_argument if an option is invalid.
+ *
+ * @param argc The number of arguments passed into main.
+ * @param argv The arguments passed into main.
+ * @return BenchOptions the options of the benchmarks
+ */
+BenchOptions process_bench_arguments(int argc, char *argv[]) {
+    auto string_value = [&](int& i) {
+        if (i + 1 >= argc) {
+            throw std::invalid_argument(std::string(argv[i]) + " requires a value");
+        }
+        return std::string(argv[++i]);
+    };
+
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--json") {
+            options.json_filename = string_value(i);
+        }
+        else if (option == "--label") {
+            options.label = string_value(i);
+        }
+        else if (option == "--filter") {
+            options.settings.filter = string_value(i);
+        }
+        else if (option == "--min-time") {
+            options.settings.min_seconds = parse_positive_value<double>(argc, argv, i);
+        }
+        else if (option == "--repetitions") {
+            options.settings.repetitions = parse_positive_integer<int>(argc, argv, i);
+        }
+        else if (option == "--seed") {
+            options.seed = parse_positive_integer<unsigned int>(argc, argv, i);
+        }
+        else if (option == "--isa") {
+            Kernels::select(Kernels::parse_isa(string_value(i)));
+        }
+        else {
+            throw std::invalid_argument("Unknown option '" + option + "'\n" + bench_usage(argv[0]));
+        }
+    }
+    return options;
+}
+
+/**
+ * @brief Benchmarks the hit function of a Hittable over a fixed set of rays aimed at it.
+ *
+ * @tparam HittableType the concrete type of the Hittable
+ * @param runner the benchmark runner
+ * @param name the name of the benchmark
+ * @param hittable the Hittable
+ * @param seed the seed of the ray set
+ */
+template <typename HittableType>
+void bench_hit(Benchmark::Runner& runner, const std::string& name, const HittableType& hittable, unsigned int seed) {
+    std::vector<Ray3D> rays = RaySets::toward(hittable.bounding_box(), set_size, seed);
+    runner.run("hit", name, [&] {
+        int hits = 0;
+        for (const auto& ray : rays) {
+            hits += hittable.hit(ray, Interval{.001, infinity}).is_hit;
+        }
+        Benchmark::do_not_optimize(hits);
+        return rays.size();
+    });
+}
+
+/**
+ * @brief Benchmarks the packet hit function of a Hittable, which runs the packet kernels, 
+ * over a fixed set of rays aimed at it in packets of RayPacket::size.
+ *
+ * @tparam HittableType the concrete type of the Hittable
+ * @param runner the benchmark runner
+ * @param name the name of the benchmark
+ * @param hittable the Hittable
+ * @param seed the seed of the ray set
+ */
+template <typename HittableType>
+void bench_hit_packet(Benchmark::Runner& runner, const std::string& name, const HittableType& hittable, unsigned int seed) {
+    std::vector<Ray3D> rays = RaySets::toward(hittable.bounding_box(), set_size, seed);
+    std::vector<RayPacket> packets(rays.size() / RayPacket::size);
+    for (std::size_t i = 0; i < packets.size() * RayPacket::size; ++i) {
+        packets[i / RayPacket::size].set(static_cast<int>(i % RayPacket::size), rays[i]);
+    }
+    runner.run("hit_packet", name, [&] {
+        int hits = 0;
+        for (const auto& packet : packets) {
+            PacketHits packet_hits {};
+            hittable.hit_packet(packet, .001, packet_hits, RayPacket::all_lanes);
+            for (const auto& record : packet_hits.records) {
+                hits += record.is_hit;
+            }
+        }
+        Benchmark::do_not_optimize(hits);
+        return packets.size() * RayPacket::size;
+    });
+}
+
+/**
+ * @brief Benchmarks AABB::hit and the hit functions of every primitive, one ray at a time and in packets.
+ *
+ * @param runner the benchmark runner
+ * @param seed the seed of the input sets
+ */
+void bench_primitives(Benchmark::Runner& runner, unsigned int seed) {
+    auto material = std::make_shared<Lambertian>(Color{.5, .5, .5});
+
+    AABB box {Vector3D{-1, -1, -1}, Vector3D{1, 1, 1}};
+    std::vector<Ray3D> box_rays = RaySets::toward(box, set_size, seed);
+    runner.run("hit", "AABB", [&] {
+        int hits = 0;
+        for (const auto& ray : box_rays) {
+            hits += box.hit(ray, Interval{.001, infinity});
+        }
+        Benchmark::do_not_optimize(hits);
+        return box_rays.size();
+    });
+
+    bench_hit(runner, "Sphere", Sphere{Vector3D{0, 0, 0}, 1, material}, seed);
+    bench_hit(runner, "Sphere (moving)", Sphere{Vector3D{0, 0, 0}, Vector3D{0, 1, 0}, 1, material}, seed);
+    bench_hit(runner, "Quad", Quad{Vector3D{-1, -1, 0}, Vector3D{2, 0, 0}, Vector3D{0, 2, 0}, material}, seed);
+    bench_hit(runner, "ConstantMedium", ConstantMedium{std::make_shared<Sphere>(Vector3D{0, 0, 0}, 1, material), 1, Color{1, 1, 1}}, seed);
+
+    std::vector<RayPacket> box_packets(box_rays.size() / RayPacket::size);
+    for (std::size_t i = 0; i < box_packets.size() * RayPacket::size; ++i) {
+        box_packets[i / RayPacket::size].set(static_cast<int>(i % RayPacket::size), box_rays[i]);
+    }
+    std::array<float_type, RayPacket::size> t_max {};
+    t_max.fill(infinity);
+    runner.run("hit_packet", "AABB", [&] {
+        int hits = 0;
+        for (const auto& packet : box_packets) {
+            hits += std::popcount(packet.hit_box(box, .001, t_max, RayPacket::all_lanes));
+        }
+        Benchmark::do_not_optimize(hits);
+        return box_packets.size() * RayPacket::size;
+    });
+    bench_hit_packet(runner, "Sphere", Sphere{Vector3D{0, 0, 0}, 1, material}, seed);
+    bench_hit_packet(runner, "Quad", Quad{Vector3D{-1, -1, 0}, Vector3D{2, 0, 0}, Vector3D{0, 2, 0}, material}, seed);
+}
+
+/**
+ * @brief Benchmarks BVH_node::hit on the camera rays of a scene, and on the camera rays of pixel blocks
+ * traced one by one and as packets.
+ *
+ * @tparam Scene the scene tag
+ * @param runner the benchmark runner
+ * @param seed the seed of the input sets
+ */
+template <typename Scene>
+void bench_scene(Benchmark::Runner& runner, unsigned int seed) {
+    if (!runner.selected("BVH_node::hit", scene_name<Scene>) && !runner.selected("primary/single", scene_name<Scene>) 
+        && !runner.selected("primary/packet", scene_name<Scene>)) {
+        return;     //building the world is too slow to do for nothing
+    }
+    Random::mt.seed(seed);
+    BVH_node bvh {make_world<Scene>()};
+    std::vector<Ray3D> rays = RaySets::camera_rays<Scene>(set_size, seed);
+    runner.run("BVH_node::hit", scene_name<Scene>, [&] {
+        int hits = 0;
+        for (const auto& ray : rays) {
+            hits += bvh.hit(ray, Interval{.001, infinity}).is_hit;
+        }
+        Benchmark::do_not_optimize(hits);
+        return rays.size();
+    });
+
+    //primary ray throughput of the coherent rays of pixel blocks, traced one by one and as packets
+    std::vector<Ray3D> block_rays = RaySets::camera_packets<Scene>(set_size, seed);
+    runner.run("primary/single", scene_name<Scene>, [&] {
+        int hits = 0;
+        for (const auto& ray : block_rays) {
+            hits += bvh.hit(ray, Interval{.001, infinity}).is_hit;
+        }
+        Benchmark::do_not_optimize(hits);
+        return block_rays.size();
+    });
+    std::vector<RayPacket> packets(block_rays.size() / RayPacket::size);
+    for (std::size_t i = 0; i < block_rays.size(); ++i) {
+        packets[i / RayPacket::size].set(static_cast<int>(i % RayPacket::size), block_rays[i]);
+    }
+    runner.run("primary/packet", scene_name<Scene>, [&] {
+        int hits = 0;
+        for (const auto& packet : packets) {
+            PacketHits packet_hits {};
+            bvh.hit_packet(packet, .001, packet_hits, RayPacket::all_lanes);
+            for (const auto& record : packet_hits.records) {
+                hits += record.is_hit;
+            }
+        }
+        Benchmark::do_not_optimize(hits);
+        return packets.size() * RayPacket::size;
+    });
+}
+
+/**
+ * @brief Benchmarks BVH_node::hit on every scene in a SceneList.
+ *
+ * @tparam Scenes the scene tags
+ * @param runner the benchmark runner
+ * @param seed the seed of the input sets
+ */
+template <typename... Scenes>
+void bench_scenes(Benchmark::Runner& runner, SceneList<Scenes...>, unsigned int seed) {
+    (bench_scene<Scenes>(runner, seed), ...);
+}
+
+/**
+ * @brief Benchmarks Perlin::turbulence and ImageTexture::value.
+ *
+ * @param runner the benchmark runner
+ * @param seed the seed of the input sets
+ */
+void bench_textures(Benchmark::Runner& runner, unsigned int seed) {
+    Random::mt.seed(seed);
+    Perlin perlin {};
+    std::vector<Vector3D> points = RaySets::points(10, set_size, seed);
+    runner.run("texture", "Perlin::turbulence", [&] {
+        float_type sum = 0;
+        for (const auto& point : points) {
+            sum += perlin.turbulence(point);
+        }
+        Benchmark::do_not_optimize(sum);
+        return points.size();
+    });
+
+    if (runner.selected("texture", "ImageTexture::value")) {
+        ImageTexture texture {"earthmap.jpg"};
+        std::vector<Vector3D> uvs = RaySets::points(1, set_size, seed);     //x and y remapped to u and v
+        runner.run("texture", "ImageTexture::value", [&] {
+            Color sum {};
+            for (const auto& uv : uvs) {
+                sum += texture.value((uv.x() + 1) / 2, (uv.y() + 1) / 2, uv);
+            }
+            Benchmark::do_not_optimize(sum);
+            return uvs.size();
+        });
+    }
+}
+
+/**
+ * @brief Benchmarks the scatter function of a Material at a fixed set of hits on a unit sphere.
+ *
+ * @param runner the benchmark runner
+ * @param name the name of the benchmark
+ * @param material the Material
+ * @param hits the rays and the hits on the sphere that they make
+ */
+void bench_scatter(Benchmark::Runner& runner, const std::string& name, const Material& material,
+                   const std::vector<std::pair<Ray3D, HitRecord>>& hits) {
+    runner.run("Material::scatter", name, [&] {
+        int successes = 0;
+        for (const auto& [ray, hit_record] : hits) {
+            successes += material.scatter(ray, hit_record).success;
+        }
+        Benchmark::do_not_optimize(successes);
+        return hits.size();
+    });
+}
+
+/**
+ * @brief Benchmarks the scatter function of every Material.
+ *
+ * @param runner the benchmark runner
+ * @param seed the seed of the input sets
+ */
+void bench_materials(Benchmark::Runner& runner, unsigned int seed) {
+    Sphere sphere {Vector3D{0, 0, 0}, 1, std::make_shared<Lambertian>(Color{.5, .5, .5})};
+    std::vector<std::pair<Ray3D, HitRecord>> hits;
+    for (const auto& ray : RaySets::toward(sphere.bounding_box(), set_size, seed)) {
+        HitRecord hit_record = sphere.hit(ray, Interval{.001, infinity});
+        if (hit_record.is_hit) {
+            hits.emplace_back(ray, hit_record);
+        }
+    }
+
+    bench_scatter(runner, "Lambertian", Lambertian{Color{.5, .5, .5}}, hits);
+    bench_scatter(runner, "Metal", Metal{Color{.8, .8, .8}, .2}, hits);
+    bench_scatter(runner, "Dielectric", Dielectric{1.5}, hits);
+    bench_scatter(runner, "DiffuseLights", DiffuseLights{Color{4, 4, 4}}, hits);
+    bench_scatter(runner, "Isotropic", Isotropic{Color{.5, .5, .5}}, hits);
+}
+
+/**
+ * @brief Benchmarks a sampling function of Vector3D, drawing set_size samples per run.
+ *
+ * @param runner the benchmark runner
+ * @param name the name of the benchmark
+ * @param sample the sampling function
+ * @param seed the seed of the generator
+ */
+template <typename SampleFunction>
+void bench_sample(Benchmark::Runner& runner, const std::string& name, SampleFunction sample, unsigned int seed) {
+    Random::mt.seed(seed);
+    runner.run("sampling", name, [&] {
+        Vector3D sum {};
+        for (std::size_t i = 0; i < set_size; ++i) {
+            sum += sample();
+        }
+        Benchmark::do_not_optimize(sum);
+        return set_size;
+    });
+}
+
+/**
+ * @brief Benchmarks the closed form sampling functions of Vector3D against the rejection sampled ones.
+ *
+ * @param runner the benchmark runner
+ * @param seed the seed of the generator
+ */
+void bench_sampling(Benchmark::Runner& runner, unsigned int seed) {
+    bench_sample(runner, "random_in_unit_disk", Vector3D::random_in_unit_disk, seed);
+    bench_sample(runner, "random_in_unit_disk_rejection", Vector3D::random_in_unit_disk_rejection, seed);
+    bench_sample(runner, "random_in_unit_sphere", Vector3D::random_in_unit_sphere, seed);
+    bench_sample(runner, "random_in_unit_sphere_rejection", Vector3D::random_in_unit_sphere_rejection, seed);
+    bench_sample(runner, "random_sphere_unit_vector", Vector3D::random_sphere_unit_vector, seed);
+    bench_sample(runner, "random_sphere_unit_vector_rejection", Vector3D::random_sphere_unit_vector_rejection, seed);
+    bench_sample(runner, "random_cosine_direction", Vector3D::random_cosine_direction, seed);
+}
+
+/**
+ * @brief Benchmarks Color::write_pixel into a temporary image file.
+ *
+ * @param runner the benchmark runner
+ * @param seed the seed of the input sets
+ */
+void bench_write_pixel(Benchmark::Runner& runner, unsigned int seed) {
+    constexpr int width = 256;
+    constexpr int height = 256;
+    if (!runner.selected("output", "Color::write_pixel")) {
+        return;
+    }
+    std::vector<Vector3D> colors = RaySets::points(1, width * height, seed);
+    for (auto& color : colors) {
+        color = (color + Vector3D{1, 1, 1}) / 2;
+    }
+
+    std::string filename = (std::filesystem::temp_directory_path() / "ray-tracer-bench.ppm").string();
+    {
+        ImageData<width, height> image {filename};
+        runner.run("output", "Color::write_pixel", [&] {
+            for (int j = 0; j < height; ++j) {
+                for (int i = 0; i < width; ++i) {
+                    const Vector3D& color = colors[static_cast<unsigned long>(j * width + i)];
+                    Color{color.x(), color.y(), color.z()}.write_pixel(j, i, image);
+                }
+            }
+            return width * height;
+        });
+    }
+    std::remove(filename.c_str());
+}
+
+/**
+ * @brief Benchmarks the tonemap kernel, which converts rows of pixel sums to gamma corrected components.
+ *
+ * @param runner the benchmark runner
+ * @param seed the seed of the input sets
+ */
+void bench_tonemap(Benchmark::Runner& runner, unsigned int seed) {
+    constexpr int width = 256;
+    constexpr int height = 256;
+    if (!runner.selected("output", "tonemap_row")) {
+        return;
+    }
+    AccumulationBuffer buffer {width, height};
+    std::vector<Vector3D> colors = RaySets::points(1, width * height, seed);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            const Vector3D& color = colors[static_cast<unsigned long>(j * width + i)];
+            buffer.add(j, i, ColorSum{color.x() + 1, color.y() + 1, color.z() + 1});
+        }
+    }
+    buffer.add_samples(2);
+
+    std::vector<int> components(3 * width);
+    runner.run("output", "tonemap_row", [&] {
+        for (int j = 0; j < height; ++j) {
+            for (int i = 0, n = 0; i < width; i += n) {
+                n = buffer.contiguous_pixels(i);
+                Kernels::active().tonemap_row(buffer.sums(j, i), AccumulationBuffer::sum_stride, static_cast<std::size_t>(n), .5, 
+                                              &components[static_cast<std::size_t>(3 * i)]);
+            }
+        }
+        Benchmark::do_not_optimize(components);
+        return width * height;
+    });
+}
+
+/**
+ * @brief Benchmarks writing an 800x800 image: tonemapping the rows of an accumulation buffer 
+ * and encoding them into a memory mapped image file, as Camera::write_image does.
+ *
+ * @param runner the benchmark runner
+ * @param seed the seed of the input sets
+ */
+void bench_write_image(Benchmark::Runner& runner, unsigned int seed) {
+    constexpr int width = 800;
+    constexpr int height = 800;
+    if (!runner.selected("output", "write_image/800x800")) {
+        return;
+    }
+    AccumulationBuffer buffer {width, height};
+    std::vector<Vector3D> colors = RaySets::points(1, width * height, seed);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            const Vector3D& color = colors[static_cast<unsigned long>(j * width + i)];
+            buffer.add(j, i, ColorSum{color.x() + 1, color.y() + 1, color.z() + 1});
+        }
+    }
+    buffer.add_samples(2);
+
+    std::string filename = (std::filesystem::temp_directory_path() / "ray-tracer-bench-image.ppm").string();
+    {
+        ImageData<width, height> image {filename};
+        std::vector<int> components(3 * width);
+        runner.run("output", "write_image/800x800", [&] {
+            for (int j = 0; j < height; ++j) {
+                for (int i = 0, n = 0; i < width; i += n) {
+                    n = buffer.contiguous_pixels(i);
+                    Kernels::active().tonemap_row(buffer.sums(j, i), AccumulationBuffer::sum_stride, static_cast<std::size_t>(n), .5, 
+                                                  &components[static_cast<std::size_t>(3 * i)]);
+                }
+                image.write_row(j, 0, components.data(), width);
+            }
+            return width * height;
+        });
+    }
+    std::remove(filename.c_str());
+}
+
+int main(int argc, char *argv[]) {
+    BenchOptions options = process_bench_arguments(argc, argv);
+    options.settings.isa = Kernels::active().name;
+    std::cout << "Kernels: " << options.settings.isa << std::endl;
+    Benchmark::Runner runner {options.settings};
+
+    bench_primitives(runner, options.seed);
+    bench_scenes(runner, AllScenes{}, options.seed);
+    bench_textures(runner, options.seed);
+    bench_sampling(runner, options.seed);
+    bench_materials(runner, options.seed);
+    bench_write_pixel(runner, options.seed);
+    bench_tonemap(runner, options.seed);
+    bench_write_image(runner, options.seed);
+
+    if (!options.json_filename.empty()) {
+        Benchmark::write_json(options.json_filename, options.label, options.settings, runner.results());
+        std::cout << "Wrote " << runner.results().size() << " results to " << options.json_filename << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,360 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <iostream>
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "ProcessArguments.h"
+#include "SceneInfo.h"
+#include "Camera.h"
+#include "BVH.h"
+#include "Random.h"
+#include "RenderStats.h"
+#include "TimeFunction.h"
+#include "AccumulationBuffer.h"
+#include "ReducedScene.h"
+#include "ImageMetrics.h"
+#include "SceneResults.h"
+#include "Kernels.h"
+#include "FeatureBuffer.h"
+#include "Denoiser.h"
+
+/**
+ * @brief The options that the scene benchmarks were invoked with.
+ *
+ */
+struct SceneBenchOptions {
+    int samples_per_pixel = 0;                  //0 uses default_samples or default_reference_samples
+    unsigned int seed = 1;                      //seeds the world and every render
+    bool make_references = false;               //render and store the references instead of benchmarking
+    std::string references_dir = "../bench/references";
+    std::string output_dir = (std::filesystem::temp_directory_path() / "ray-tracer-scene-bench").string();
+    std::string json_filename {};               //where the results are written as JSON. empty disables JSON output
+    std::string baseline_filename {};           //the JSON results that the results are compared against. empty disables
+    std::string label {};                       //identifies the results in the JSON output, e.g. a commit hash
+    std::string filter {};                      //only scenes whose name contains filter are run
+    bool denoise = false;                       //also denoise every render, and measure the quality it gains
+    double tolerance = .05;                     //the relative slowdown or efficiency loss that counts as a regression
+};
+
+constexpr int default_samples = 16;
+constexpr int default_reference_samples = 1024;
+
+/**
+ * @brief Returns the usage message of the scene benchmarks.
+ *
+ * @param program_name the name the program was invoked with (argv[0])
+ * @return std::string the usage message
+ */
+std::string scene_bench_usage(const std::string& program_name) {
+    return "Usage: " + program_name + " [options]\n"
+           "Renders every scene at 1/" + std::to_string(scene_reduction_factor) + " resolution with a fixed seed, "
+           "and compares it against a stored high spp reference.\n"
+           "Options:\n"
+           "  --spp <n>              samples per pixel (default: " + std::to_string(default_samples) + ", "
+                                     + std::to_string(default_reference_samples) + " with --make-references)\n"
+           "  --seed <n>             the seed of the worlds and renders (default: 1)\n"
+           "  --make-references      render the references instead of benchmarking\n"
+           "  --references <dir>     where the references are stored (default: ../bench/references)\n"
+           "  --output-dir <dir>     where the benchmark images are written (default: a temporary directory)\n"
+           "  --json <file>          also write the results to file as JSON\n"
+           "  --label <label>        label the JSON results, e.g. with the commit that was benchmarked\n"
+           "  --baseline <file>      compare the results against earlier JSON results, exiting with 1 on a regression\n"
+           "  --tolerance <t>        the relative slowdown or efficiency loss that is a regression (default: .05)\n"
+           "  --filter <text>        only run scenes whose name contains text\n"
+           "  --denoise              also denoise every render, reporting its time and the spp that match its quality\n"
+           "  --isa <name>           use the baseline, avx2 or avx512 kernels (default: the best the CPU supports)";
+}
+
+/**
+ * @brief Takes the main arguments, returns the options of the scene benchmarks.
+ * Throws std::invalid_argument if an option is invalid.
+ *
+ * @param argc The number of arguments passed into main.
+ * @param argv The arguments passed into main.
+ * @return SceneBenchOptions the options of the scene benchmarks
+ */
+SceneBenchOptions process_scene_bench_arguments(int argc, char *argv[]) {
+    auto string_value = [&](int& i) {
+        if (i + 1 >= argc) {
+            throw std::invalid_argument(std::string(argv[i]) + " requires a value");
+        }
+        return std::string(argv[++i]);
+    };
+
+    SceneBenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--spp") {
+            options.samples_per_pixel = parse_positive_integer<int>(argc, argv, i);
+        }
+        else if (option == "--seed") {
+            options.seed = parse_positive_integer<unsigned int>(argc, argv, i);
+        }
+        else if (option == "--make-references") {
+            options.make_references = true;
+        }
+        else if (option == "--references") {
+            options.references_dir = string_value(i);
+        }
+        else if (option == "--output-dir") {
+            options.output_dir = string_value(i);
+        }
+        else if (option == "--json") {
+            options.json_filename = string_value(i);
+        }
+        else if (option == "--label") {
+            options.label = string_value(i);
+        }
+        else if (option == "--baseline") {
+            options.baseline_filename = string_value(i);
+        }
+        else if (option == "--tolerance") {
+            options.tolerance = parse_positive_value<double>(argc, argv, i);
+        }
+        else if (option == "--filter") {
+            options.filter = string_value(i);
+        }
+        else if (option == "--denoise") {
+            options.denoise = true;
+        }
+        else if (option == "--isa") {
+            Kernels::select(Kernels::parse_isa(string_value(i)));     //inherited by the render processes
+        }
+        else {
+            throw std::invalid_argument("Unknown option '" + option + "'\n" + scene_bench_usage(argv[0]));
+        }
+    }
+    if (options.samples_per_pixel == 0) {
+        options.samples_per_pixel = options.make_references ? default_reference_samples : default_samples;
+    }
+    return options;
+}
+
+/**
+ * @brief The timings that a child process measured while rendering a scene.
+ *
+ */
+struct RenderTiming {
+    double wall_seconds;
+    double render_seconds;
+    double rays;            //camera and bounce rays. 0 unless RAYTRACER_STATS is enabled
+};
+
+/**
+ * @brief Makes the world of Scene and renders it at reduced resolution, writing the image and a checkpoint
+ * of the accumulated samples.
+ *
+ * @tparam Scene the scene tag
+ * @param settings the settings of the render, including its seed and checkpoint filename
+ * @param image_filename the .ppm image filename
+ * @return RenderTiming the timings of the render
+ */
+template <typename Scene>
+RenderTiming render_reduced(const RenderSettings& settings, const std::string& image_filename) {
+    Stopwatch wall_time;
+    Random::seed(settings.seed);
+    HittableList world = make_world<Scene>();
+    world = HittableList{std::make_shared<BVH_node>(world)};
+
+    Camera<ReducedScene<Scene>> camera {};
+    Stopwatch render_time;
+    camera.render(world, image_filename, settings);
+    double render_seconds = render_time.elapsed_seconds();
+
+    double rays = 0;
+    if constexpr (RenderStats::enabled) {
+        rays = static_cast<double>(RenderStats::collect().total_rays());
+    }
+    return RenderTiming{wall_time.elapsed_seconds(), render_seconds, rays};
+}
+
+/**
+ * @brief Runs render in a child process, so that its peak memory use is measured on its own.
+ * Throws std::runtime_error if the child process fails.
+ *
+ * @tparam RenderFunction callable with the signature RenderTiming()
+ * @param render the render
+ * @param peak_rss_kb set to the peak resident set size of the child process in kilobytes
+ * @return RenderTiming the timings that the child process measured
+ */
+template <typename RenderFunction>
+RenderTiming run_in_child(const RenderFunction& render, long& peak_rss_kb) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("Error: pipe failed");
+    }
+    std::cout << std::flush;    //or the child would inherit and repeat buffered output
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("Error: fork failed");
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        int exit_status = 0;
+        try {
+            RenderTiming timing = render();
+            if (write(fds[1], &timing, sizeof(timing)) != static_cast<ssize_t>(sizeof(timing))) {
+                exit_status = 1;
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            exit_status = 1;
+        }
+        _exit(exit_status);
+    }
+
+    close(fds[1]);
+    RenderTiming timing {};
+    ssize_t bytes_read = read(fds[0], &timing, sizeof(timing));
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage {};
+    wait4(pid, &status, 0, &usage);
+    if (bytes_read != static_cast<ssize_t>(sizeof(timing)) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("Error: the render process failed");
+    }
+    peak_rss_kb = usage.ru_maxrss;
+    return timing;
+}
+
+/**
+ * @brief Renders Scene at reduced resolution and records its results, or renders and stores its reference.
+ *
+ * @tparam Scene the scene tag
+ * @param options the options of the scene benchmarks
+ * @param results the results that the results of Scene are added to
+ */
+template <typename Scene>
+void bench_scene(const SceneBenchOptions& options, std::vector<SceneResults::Result>& results) {
+    std::string name = scene_name<Scene>;
+    if (name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    constexpr int width = CameraParameters<ReducedScene<Scene>>::image_width;
+    constexpr int height = CameraParameters<ReducedScene<Scene>>::image_height;
+    std::string reference_filename = options.references_dir + '/' + name + ".ckpt";
+
+    RenderSettings settings;
+    settings.samples_per_pixel = options.samples_per_pixel;
+    settings.seed = options.seed;
+    settings.checkpoint_filename = options.output_dir + '/' + name + ".ckpt";
+    settings.denoise = options.denoise;
+    std::string image_filename = options.output_dir + '/' + name + ".ppm";
+    if (options.make_references) {
+        //an independent seed, so that the noise of the benchmark renders does not correlate with the reference
+        settings.seed = static_cast<unsigned int>(Random::mix_seed(options.seed, 1)) | 1;
+        settings.checkpoint_filename = reference_filename;
+        settings.denoise = false;
+        image_filename = options.references_dir + '/' + name + ".ppm";
+    }
+
+    SceneResults::Result result;
+    result.scene = name;
+    result.width = width;
+    result.height = height;
+    result.samples_per_pixel = options.samples_per_pixel;
+    RenderTiming timing = run_in_child([&] { return render_reduced<Scene>(settings, image_filename); }, result.peak_rss_kb);
+    result.wall_seconds = timing.wall_seconds;
+    result.render_seconds = timing.render_seconds;
+    result.camera_rays_per_sec = static_cast<double>(width) * height * options.samples_per_pixel / timing.render_seconds;
+    if constexpr (RenderStats::enabled) {
+        result.rays_per_sec = timing.rays / timing.render_seconds;
+    }
+
+    if (!options.make_references && std::filesystem::exists(reference_filename)) {
+        AccumulationBuffer image {width, height};
+        image.load(settings.checkpoint_filename);
+        AccumulationBuffer reference {width, height};
+        reference.load(reference_filename);
+        ImageMetrics::Errors errors = ImageMetrics::compare(image, reference);
+        result.rmse = errors.rmse;
+        result.rel_mse = errors.rel_mse;
+        result.efficiency = 1 / (errors.rel_mse * timing.render_seconds);
+
+        if (options.denoise) {
+            FeatureBuffer features {width, height};
+            features.load(FeatureBuffer::filename_for(settings.checkpoint_filename));
+            Stopwatch denoise_time;
+            AccumulationBuffer denoised = Denoiser::denoise(image, features);
+            result.denoise_seconds = denoise_time.elapsed_seconds();
+            result.denoised_rel_mse = ImageMetrics::compare(denoised, reference).rel_mse;
+            result.equivalent_spp = options.samples_per_pixel * errors.rel_mse / result.denoised_rel_mse;
+        }
+    }
+
+    auto print_number = [](double value, int width_, int precision) {
+        if (std::isnan(value)) {
+            std::cout << std::setw(width_) << '-';
+        }
+        else {
+            std::cout << std::setw(width_) << std::setprecision(precision) << value;
+        }
+    };
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::setw(5) << width << 'x' << std::left << std::setw(5) << height << std::right
+              << std::setw(6) << options.samples_per_pixel << std::fixed;
+    print_number(result.wall_seconds, 9, 2);
+    print_number(result.render_seconds, 9, 2);
+    print_number(result.camera_rays_per_sec * 1e-6, 11, 3);
+    print_number(result.rays_per_sec * 1e-6, 11, 3);
+    print_number(static_cast<double>(result.peak_rss_kb) / 1024, 9, 1);
+    std::cout << std::scientific;
+    print_number(result.rmse, 11, 3);
+    print_number(result.rel_mse, 11, 3);
+    print_number(result.efficiency, 14, 3);
+    std::cout << std::defaultfloat << std::endl;
+    if (!std::isnan(result.denoised_rel_mse)) {
+        std::cout << "  denoised in " << std::fixed << std::setprecision(3) << result.denoise_seconds << " s: relMSE " 
+                  << std::scientific << result.denoised_rel_mse << std::fixed << std::setprecision(0) << ", as good as " 
+                  << result.equivalent_spp << " spp without denoising (" << std::setprecision(1) 
+                  << result.equivalent_spp / options.samples_per_pixel << "x)" << std::defaultfloat << std::endl;
+    }
+    results.push_back(std::move(result));
+}
+
+/**
+ * @brief Runs bench_scene on every scene in a SceneList.
+ *
+ * @tparam Scenes the scene tags
+ * @param options the options of the scene benchmarks
+ * @param results the results that the results of every scene are added to
+ */
+template <typename... Scenes>
+void bench_scenes(SceneList<Scenes...>, const SceneBenchOptions& options, std::vector<SceneResults::Result>& results) {
+    (bench_scene<Scenes>(options, results), ...);
+}
+
+int main(int argc, char *argv[]) {
+    SceneBenchOptions options = process_scene_bench_arguments(argc, argv);
+    std::filesystem::create_directories(options.make_references ? options.references_dir : options.output_dir);
+
+    if (options.make_references) {
+        std::cout << "Rendering references to " << options.references_dir << std::endl;
+    }
+    std::cout << "Kernels: " << Kernels::active().name << std::endl;
+    std::cout << std::left << std::setw(24) << "scene" << std::right << std::setw(11) << "size" << std::setw(6) << "spp"
+              << std::setw(9) << "wall s" << std::setw(9) << "render s" << std::setw(11) << "Mcam/s" << std::setw(11) << "Mrays/s"
+              << std::setw(9) << "RSS MB" << std::setw(11) << "RMSE" << std::setw(11) << "relMSE" << std::setw(14) << "1/(relMSE*s)"
+              << std::endl;
+    std::vector<SceneResults::Result> results;
+    bench_scenes(AllScenes{}, options, results);
+
+    if (!options.json_filename.empty()) {
+        SceneResults::write_json(options.json_filename, options.label, options.seed, results);
+        std::cout << "Wrote " << results.size() << " results to " << options.json_filename << std::endl;
+    }
+    if (!options.baseline_filename.empty()) {
+        int regressions = SceneResults::compare(std::cout, results, SceneResults::read_json(options.baseline_filename), options.tolerance);
+        if (regressions > 0) {
+            std::cout << regressions << " scene(s) regressed" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -128,7 +128,7 @@ public:
  * @param offset the offset vector
  * @return AABB the resulting bounding box with some displacement
  */
-AABB operator+(const AABB& aabb, const Vector3D& offset) {
+inline AABB operator+(const AABB& aabb, const Vector3D& offset) {
     return AABB{aabb.x + offset.x(), aabb.y + offset.y(), aabb.z + offset.z()};
 }
 
@@ -139,7 +139,7 @@ AABB operator+(const AABB& aabb, const Vector3D& offset) {
  * @param aabb the AABB
  * @return AABB the resulting bounding box with some displacement
  */
-AABB operator+(const Vector3D& offset, const AABB& aabb) {
+inline AABB operator+(const Vector3D& offset, const AABB& aabb) {
     return AABB{aabb.x + offset.x(), aabb.y + offset.y(), aabb.z + offset.z()};
 }
 
@@ -0,0 +1,117 @@
+#ifndef AOVFILE_H
+#define AOVFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Constants.h"
+#include "Color.h"
+#include "AccumulationBuffer.h"
+#include "FeatureBuffer.h"
+
+// This header-only AOVFile namespace writes the arbitrary output variables (AOVs) of a render: the beauty image
+// and the features of the first surface hit in every pixel, as planar 32 bit float channels of a single file, so
+// that compositing gets depth, normals, albedo and id masks without rendering the scene again.
+//
+// The file starts with a text header, followed by the channels one after another, each one row after another
+// from the top, in native byte order:
+//     RTAOV1
+//     <width> <height> <channel count>
+//     <channel names, separated by spaces>
+namespace AOVFile
+{
+	struct Channel
+	{
+		std::string name;
+		std::vector<float> data;	// width * height values, row after row from the top
+		bool exact = false;			// must not be stored at a reduced precision, e.g. depths and ids
+	};
+
+	inline const char magic[] = "RTAOV1";
+
+	// The linear R, G, B channels of an image, unclamped
+	inline std::vector<Channel> beauty_channels(const AccumulationBuffer& beauty)
+	{
+		const auto pixel_count = static_cast<std::size_t>(beauty.width()) * static_cast<std::size_t>(beauty.height());
+		std::vector<Channel> channels;
+		for (const char* name : {"R", "G", "B"})
+			channels.push_back(Channel{name, std::vector<float>(pixel_count)});
+		std::size_t p = 0;
+		for (int j = 0; j < beauty.height(); ++j)
+		{
+			for (int i = 0; i < beauty.width(); ++i, ++p)
+			{
+				Color color = beauty.average(j, i);
+				for (std::size_t c = 0; c < 3; ++c)
+					channels[c].data[p] = color[c];
+			}
+		}
+		return channels;
+	}
+
+	// The channels of a render: the linear beauty R, G, B, the depth Z along the viewing direction (infinite where
+	// nothing was hit), the world space normal N, the albedo, the material and primitive ids of the first hit
+	// (-1 where nothing was hit) and the samples per pixel. Ids are small integers, so they are exact as floats.
+	inline std::vector<Channel> make_channels(const AccumulationBuffer& beauty, const FeatureBuffer& features)
+	{
+		const auto pixel_count = static_cast<std::size_t>(beauty.width()) * static_cast<std::size_t>(beauty.height());
+		std::vector<Channel> channels = beauty_channels(beauty);
+		const std::size_t first_feature = channels.size();
+		for (std::string name : {"Z", "N.X", "N.Y", "N.Z", "albedo.R", "albedo.G", "albedo.B", "material_id", "primitive_id", "samples"})
+		{
+			bool exact = name == "Z" || name == "material_id" || name == "primitive_id" || name == "samples";
+			channels.push_back(Channel{name, std::vector<float>(pixel_count), exact});
+		}
+
+		const auto samples = static_cast<float>(beauty.samples_per_pixel());
+		std::size_t p = 0;
+		for (int j = 0; j < beauty.height(); ++j)
+		{
+			for (int i = 0; i < beauty.width(); ++i, ++p)
+			{
+				Vector3D normal = features.normal(j, i);
+				Color albedo = features.albedo(j, i);
+				float values[] = {features.depth(j, i), normal.x(), normal.y(), normal.z(), albedo.x(), albedo.y(), albedo.z(),
+								  static_cast<float>(features.material_id(j, i)), static_cast<float>(features.primitive_id(j, i)), samples};
+				for (std::size_t c = 0; c < std::size(values); ++c)
+					channels[first_feature + c].data[p] = values[c];
+			}
+		}
+		return channels;
+	}
+
+	// Writes the channels to a temporary file which then replaces filename.
+	// Throws std::invalid_argument if a channel is not width * height values, std::runtime_error if the file cannot be written.
+	inline void write(const std::string& filename, int width, int height, const std::vector<Channel>& channels)
+	{
+		const auto pixel_count = static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+		for (const Channel& channel : channels)
+		{
+			if (channel.data.size() != pixel_count || channel.name.empty() || channel.name.find(' ') != std::string::npos)
+				throw std::invalid_argument("Error: AOV channel '" + channel.name + "' does not match the image");
+		}
+
+		std::string temp_filename = filename + ".tmp";
+		{
+			std::ofstream out {temp_filename, std::ios::binary | std::ios::trunc};
+			if (!out)
+				throw std::runtime_error("Error: Unable to open AOV file " + temp_filename);
+			out << magic << '\n' << width << ' ' << height << ' ' << channels.size() << '\n';
+			for (std::size_t c = 0; c < channels.size(); ++c)
+				out << (c == 0 ? "" : " ") << channels[c].name;
+			out << '\n';
+			for (const Channel& channel : channels)
+				out.write(reinterpret_cast<const char*>(channel.data.data()), static_cast<std::streamsize>(pixel_count * sizeof(float)));
+			if (!out)
+				throw std::runtime_error("Error: Unable to write AOV file " + temp_filename);
+		}
+		if (std::rename(temp_filename.c_str(), filename.c_str()) != 0)
+			throw std::runtime_error("Error: Unable to replace AOV file " + filename);
+	}
+};
+
+#endif
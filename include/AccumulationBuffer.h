@@ -0,0 +1,294 @@
+#ifndef ACCUMULATIONBUFFER_H
+#define ACCUMULATIONBUFFER_H
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include "Constants.h"
+#include "Color.h"
+
+/**
+ * @brief Allocates memory that starts on a page boundary, so that equally sized blocks of it own whole pages.
+ *
+ * @tparam T the type of the elements
+ */
+template <typename T>
+struct PageAlignedAllocator {
+    using value_type = T;
+    constexpr static std::size_t page_size = 4096;
+
+    PageAlignedAllocator() = default;
+    template <typename U>
+    PageAlignedAllocator(const PageAlignedAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{page_size}));
+    }
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t{page_size});
+    }
+
+    template <typename U>
+    bool operator==(const PageAlignedAllocator<U>&) const {return true;}
+};
+
+/**
+ * @brief Stores the running sum of every color sample taken for each pixel of an image,
+ * along with the number of samples that every pixel has received.
+ * Used to render an image progressively in passes, and to checkpoint and resume a render.
+ * 
+ * The sums are stored in square tiles of tile_size pixels, one tile after another and each row after row,
+ * starting on a page boundary. A tile is a whole number of cache lines and pages, so threads that render
+ * whole tiles never write to the same cache line or page. Rows are copied into raster order when written.
+ *
+ */
+class AccumulationBuffer {
+public:
+    constexpr static int tile_size = 32;
+
+private:
+    constexpr static int tile_pixels = tile_size * tile_size;
+    static_assert(tile_pixels * sizeof(ColorSum) % PageAlignedAllocator<ColorSum>::page_size == 0, 
+                  "a tile must be a whole number of pages");
+
+    int m_width;
+    int m_height;
+    int m_tiles_per_row;
+    long m_samples_per_pixel = 0;
+    std::vector<ColorSum, PageAlignedAllocator<ColorSum>> m_sums;
+
+    constexpr static char checkpoint_magic[8] = {'R', 'T', 'C', 'K', 'P', 'T', '2', '\0'};
+
+public:
+    /**
+     * @brief What a checkpoint was rendered from, which a render must match to be resumed from it.
+     *
+     */
+    struct CheckpointIdentity {
+        std::string scene {};
+        std::uint64_t seed = 0;     //0 if the render was not seeded
+    };
+
+    /**
+     * @brief Construct a new Accumulation Buffer object where every pixel sum is black and no samples have been taken.
+     *
+     * @param width the width of the image in pixels
+     * @param height the height of the image in pixels
+     */
+    AccumulationBuffer(int width, int height) :
+        m_width{width},
+        m_height{height},
+        m_tiles_per_row{(width + tile_size - 1) / tile_size},
+        m_sums(static_cast<unsigned long>(m_tiles_per_row) * static_cast<unsigned long>((height + tile_size - 1) / tile_size) * tile_pixels, 
+               ColorSum{0, 0, 0})
+    {}
+
+    int width() const {return m_width;}
+    int height() const {return m_height;}
+
+    /**
+     * @brief Returns the number of samples that have been summed into every pixel.
+     *
+     * @return long the samples per pixel
+     */
+    long samples_per_pixel() const {return m_samples_per_pixel;}
+
+    /**
+     * @brief Records that every pixel has received some additional number of samples.
+     * Should be called once after all pixels have been updated in a pass.
+     *
+     * @param samples the number of samples that every pixel received during the pass.
+     */
+    void add_samples(long samples) {m_samples_per_pixel += samples;}
+
+    /**
+     * @brief Adds a sum of color samples to the pixel at row row and column col.
+     * Pixels are owned by exactly one tile, so this is safe to call concurrently for different pixels.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @param sum the sum of the new color samples
+     */
+    void add(int row, int col, const ColorSum& sum) {
+        m_sums[index(row, col)] += sum;
+    }
+
+    /**
+     * @brief Returns the sum of the color samples of the pixel at row row and column col, and resets it to black.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return ColorSum the sum of the pixel
+     */
+    ColorSum take(int row, int col) {
+        ColorSum sum = m_sums[index(row, col)];
+        m_sums[index(row, col)] = ColorSum{0, 0, 0};
+        return sum;
+    }
+
+    /**
+     * @brief Multiplies the sums of the pixels from rows row_min to row_max and columns col_min to col_max by factor.
+     *
+     * @param row_min the first row, 0 indexed from the top. inclusive.
+     * @param row_max the row after the last. exclusive.
+     * @param col_min the first column, 0 indexed from the left. inclusive.
+     * @param col_max the column after the last. exclusive.
+     * @param factor what the sums are multiplied by
+     */
+    void scale(int row_min, int row_max, int col_min, int col_max, float_type factor) {
+        for (int j = row_min; j < row_max; ++j) {
+            for (int i = col_min; i < col_max; ++i) {
+                ColorSum& sum = m_sums[index(j, i)];
+                sum = ColorSum{sum.x() * factor, sum.y() * factor, sum.z() * factor};
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the average Color of all samples taken for the pixel at row row and column col.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return Color the averaged pixel color, or black if no samples have been taken
+     */
+    Color average(int row, int col) const {
+        if (m_samples_per_pixel == 0) {
+            return Color{0, 0, 0};
+        }
+        return m_sums[index(row, col)].scale(m_samples_per_pixel);
+    }
+
+    /**
+     * @brief Returns the sums of the pixels of a row from column col to the end of its tile, sum_stride float_types apart.
+     *
+     * @param row the row, 0 indexed from the top
+     * @param col the column of the first pixel, 0 indexed from the left
+     * @return const float_type* the red component of the first pixel
+     */
+    const float_type* sums(int row, int col) const {
+        return m_sums[index(row, col)].m_vec.data();
+    }
+    constexpr static std::size_t sum_stride = sizeof(ColorSum) / sizeof(float_type);
+
+    /**
+     * @brief Returns how many pixels of a row are stored one after another from column col: those to the end of its tile.
+     *
+     * @param col the column of the first pixel, 0 indexed from the left
+     * @return int the number of pixels that sums(row, col) points to
+     */
+    int contiguous_pixels(int col) const {
+        return std::min(tile_size - col % tile_size, m_width - col);
+    }
+
+    /**
+     * @brief Writes the buffer to a checkpoint file, so that the render can later be resumed.
+     * The data is written to a temporary file which then replaces filename,
+     * so an interrupted write never corrupts an existing checkpoint.
+     * Throws std::runtime_error if the file cannot be written.
+     *
+     * @param filename the name of the checkpoint file, with path and extension.
+     * @param identity the scene and seed that the buffer was rendered from.
+     */
+    void save(const std::string& filename, const CheckpointIdentity& identity) const {
+        std::string temp_filename = filename + ".tmp";
+        {
+            std::ofstream out {temp_filename, std::ios::binary | std::ios::trunc};
+            if (!out) {
+                throw std::runtime_error("Error: Unable to open checkpoint file " + temp_filename);
+            }
+            auto width = static_cast<std::int32_t>(m_width);
+            auto height = static_cast<std::int32_t>(m_height);
+            auto samples = static_cast<std::int64_t>(m_samples_per_pixel);
+            auto scene_length = static_cast<std::uint32_t>(identity.scene.size());
+            out.write(checkpoint_magic, sizeof(checkpoint_magic));
+            out.write(reinterpret_cast<const char*>(&width), sizeof(width));
+            out.write(reinterpret_cast<const char*>(&height), sizeof(height));
+            out.write(reinterpret_cast<const char*>(&samples), sizeof(samples));
+            out.write(reinterpret_cast<const char*>(&identity.seed), sizeof(identity.seed));
+            out.write(reinterpret_cast<const char*>(&scene_length), sizeof(scene_length));
+            out.write(identity.scene.data(), static_cast<std::streamsize>(scene_length));
+            for (int j = 0; j < m_height; ++j) {
+                for (int i = 0; i < m_width; ++i) {
+                    const ColorSum& sum = m_sums[index(j, i)];
+                    float components[3] = {sum.x(), sum.y(), sum.z()};
+                    out.write(reinterpret_cast<const char*>(components), sizeof(components));
+                }
+            }
+            if (!out) {
+                throw std::runtime_error("Error: Unable to write checkpoint file " + temp_filename);
+            }
+        }
+        if (std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+            throw std::runtime_error("Error: Unable to replace checkpoint file " + filename);
+        }
+    }
+
+    /**
+     * @brief Replaces the contents of the buffer with those of a checkpoint file.
+     * Throws std::runtime_error if the file cannot be read, was written for an image of a different size,
+     * or, if identity is set, was rendered from a different scene or seed.
+     *
+     * @param filename the name of the checkpoint file, with path and extension.
+     * @param identity if set, the scene and seed that the checkpoint must have been rendered from to be resumed.
+     * Comparing the images of different renders needs none.
+     */
+    void load(const std::string& filename, const std::optional<CheckpointIdentity>& identity = std::nullopt) {
+        std::ifstream in {filename, std::ios::binary};
+        if (!in) {
+            throw std::runtime_error("Error: Unable to open checkpoint file " + filename);
+        }
+        char magic[sizeof(checkpoint_magic)] {};
+        std::int32_t width {}, height {};
+        std::int64_t samples {};
+        CheckpointIdentity checkpoint;
+        std::uint32_t scene_length {};
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(&width), sizeof(width));
+        in.read(reinterpret_cast<char*>(&height), sizeof(height));
+        in.read(reinterpret_cast<char*>(&samples), sizeof(samples));
+        in.read(reinterpret_cast<char*>(&checkpoint.seed), sizeof(checkpoint.seed));
+        in.read(reinterpret_cast<char*>(&scene_length), sizeof(scene_length));
+        constexpr std::uint32_t max_scene_length = 256;
+        if (!in || !std::equal(std::begin(magic), std::end(magic), std::begin(checkpoint_magic)) || scene_length > max_scene_length) {
+            throw std::runtime_error("Error: " + filename + " is not a checkpoint file");
+        }
+        checkpoint.scene.resize(scene_length);
+        in.read(checkpoint.scene.data(), static_cast<std::streamsize>(scene_length));
+        if (width != m_width || height != m_height) {
+            throw std::runtime_error("Error: checkpoint " + filename + " was rendered at a different resolution");
+        }
+        if (identity && checkpoint.scene != identity->scene) {
+            throw std::runtime_error("Error: checkpoint " + filename + " was rendered from the scene " + checkpoint.scene);
+        }
+        if (identity && checkpoint.seed != identity->seed) {
+            throw std::runtime_error("Error: checkpoint " + filename + (checkpoint.seed == 0 ? " was not seeded" 
+                                     : " was rendered with the seed " + std::to_string(checkpoint.seed)));
+        }
+        for (int j = 0; j < m_height; ++j) {
+            for (int i = 0; i < m_width; ++i) {
+                float components[3] {};
+                in.read(reinterpret_cast<char*>(components), sizeof(components));
+                m_sums[index(j, i)] = ColorSum{components[0], components[1], components[2]};
+            }
+        }
+        if (!in) {
+            throw std::runtime_error("Error: checkpoint file " + filename + " is truncated");
+        }
+        m_samples_per_pixel = samples;
+    }
+
+private:
+    unsigned long index(int row, int col) const {
+        auto tile = static_cast<unsigned long>(row / tile_size) * static_cast<unsigned long>(m_tiles_per_row) 
+                  + static_cast<unsigned long>(col / tile_size);
+        return tile * tile_pixels + static_cast<unsigned long>((row % tile_size) * tile_size + col % tile_size);
+    }
+};
+
+#endif
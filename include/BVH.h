@@ -7,7 +7,9 @@
 #include "Hittable.h"
 #include "HittableList.h"
 #include "AABB.h"
+#include "RayPacket.h"
 #include "Random.h"
+#include "RenderStats.h"
 
 /**
  * @brief A Bounding Volume Heirarchy class, which serves as an alternative to the HittableList.
@@ -60,6 +62,7 @@ public:
     BVH_node(const HittableList& hittable_list) : BVH_node(hittable_list.hittables) {}
 
     HitRecord hit(const Ray3D& ray, const Interval& t_interval) const override {
+        RenderStats::count_bvh_node();
         if (!bbox.hit(ray, t_interval)) {
             return HitRecord{false};
         }
@@ -78,6 +81,26 @@ public:
         }
     }
 
+    /**
+     * @brief Finds the closest hits of a packet of rays within this node.
+     * The node's box is tested against every active ray at once, and the subtrees are skipped 
+     * as soon as no ray of the packet travels through it.
+     * 
+     * @param packet The incoming light rays.
+     * @param t_min The minimum travel distance of a valid collision.
+     * @param hits The closest hits so far, which are replaced by any closer hits.
+     * @param active The rays of the packet to test.
+     */
+    void hit_packet(const RayPacket& packet, float_type t_min, PacketHits& hits, RayPacket::Mask active) const override {
+        RenderStats::count_bvh_node();
+        active = packet.hit_box(bbox, t_min, hits.t_max, active);
+        if (active == 0) {
+            return;
+        }
+        left->hit_packet(packet, t_min, hits, active);
+        right->hit_packet(packet, t_min, hits, active);    //tested against the closer hits found in left
+    }
+
     /**
      * @brief returns the bounding box that contains all hittable objects contained in this node.
      * 
@@ -20,8 +20,8 @@ inline std::shared_ptr<HittableList> box(const Vector3D& corner1, const Vector3D
     auto sides = std::make_shared<HittableList>();
 
     //for convenience, find two opposing vertices s.t. one has strictly lower coordinates in all dimensions
-    auto low = Vector3D{fmin(corner1.x(), corner2.x()), fmin(corner1.y(), corner2.y()), fmin(corner1.z(), corner2.z())};
-    auto high = Vector3D{fmax(corner1.x(), corner2.x()), fmax(corner1.y(), corner2.y()), fmax(corner1.z(), corner2.z())};
+    auto low = Vector3D{std::fmin(corner1.x(), corner2.x()), std::fmin(corner1.y(), corner2.y()), std::fmin(corner1.z(), corner2.z())};
+    auto high = Vector3D{std::fmax(corner1.x(), corner2.x()), std::fmax(corner1.y(), corner2.y()), std::fmax(corner1.z(), corner2.z())};
 
     auto dx = Vector3D{high.x() - low.x(), 0, 0};
     auto dy = Vector3D{0, high.y() - low.y(), 0};
@@ -2,8 +2,18 @@
 #define CAMERA_H
 
 #include <fstream>
+#include <functional>
+#include <array>
+#include <vector>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <deque>
 #include <future>
+#include <limits>
+#include <optional>
+#include <semaphore>
+#include <thread>
 #include "Constants.h"
 #include "Vector3D.h"
 #include "Ray3D.h"
@@ -14,6 +24,21 @@
 #include "Random.h"
 #include "ImageData.h"
 #include "SceneInfo.h"
+#include "AccumulationBuffer.h"
+#include "RenderSettings.h"
+#include "TimeFunction.h"
+#include "RenderStats.h"
+#include "Trace.h"
+#include "CostBuffer.h"
+#include "Kernels.h"
+#include "FeatureBuffer.h"
+#include "AOVFile.h"
+#include "EXRFile.h"
+#include "Parallel.h"
+#include "PPMStream.h"
+#include "Denoiser.h"
+#include "Distributed.h"
+#include "PartialRender.h"
 
 /**
  * @brief A class representing a camera that can capture light from the world.
@@ -24,6 +49,7 @@
 template <typename Scene>
 class Camera {
 private:
+    Vector3D center {};                //the center of the camera
     //viewport info
     Vector3D pixel_delta_u {};         //length of single pixel along width, pointing right
     Vector3D pixel_delta_v {};         //length of single pixel along height, pointing down
@@ -35,18 +61,25 @@ private:
     Vector3D defocus_disk_v {}; //defocus disk vertical radius
     
 public:
+    /**
+     * @brief Construct a new Camera object with the pose of the scene
+     */
+    Camera() : Camera(CameraPose::of<Scene>()) {}
+
     /**
      * @brief Construct a new Camera object
+     * 
+     * @param pose where the camera is, where it points and its vertical field of view.
      */
-    Camera()
+    explicit Camera(const CameraPose& pose) : center{pose.center}
     {
         //viewport dimensions
-        float_type theta = degrees_to_radians(CameraParameters<Scene>::vfov);
+        float_type theta = degrees_to_radians(pose.vfov);
         float_type h = CameraParameters<Scene>::focus_distance * std::tan(theta/2);
         float_type viewport_height = 2 * h;
         float_type viewport_width = viewport_height * (static_cast<float_type>(CameraParameters<Scene>::image_width)/CameraParameters<Scene>::image_height);
         //calculate the w,u,v basis vectors for the camera coordinate frame
-        w = -CameraParameters<Scene>::camera_lens_direction.unit_vector();       //negative direction of camera lens
+        w = -(pose.target - pose.center).unit_vector();                         //negative direction of camera lens
         u = CameraParameters<Scene>::camera_up_direction.cross(w).unit_vector(); //vector pointing right of camera
         v = w.cross(u);                                 //vector pointing up
         //calculate vectors going right along the horizontal and down along the vertical viewport edges
@@ -56,7 +89,7 @@ public:
         pixel_delta_u = viewport_u / CameraParameters<Scene>::image_width;
         pixel_delta_v = viewport_v / CameraParameters<Scene>::image_height;
         //determine the location of the upper left pixel
-        Vector3D viewport_upper_left    = CameraParameters<Scene>::camera_center 
+        Vector3D viewport_upper_left    = center 
                                         - (CameraParameters<Scene>::focus_distance*w) 
                                         - viewport_u/2 - viewport_v/2;
         pixel00_loc = viewport_upper_left + .5*(pixel_delta_u + pixel_delta_v);
@@ -74,77 +107,1237 @@ public:
      * The file will be truncated if it already exists, or created if it doesn't.
      */
     void render(const Hittable& world, const std::string& filename) const {
-        ImageData<CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height> image_data{filename};
-        parallel_render_tile(0, CameraParameters<Scene>::image_height, 0, CameraParameters<Scene>::image_width, world, image_data);
+        render(world, filename, RenderSettings{});
+    }
+
+    /**
+     * @brief Progressively renders an image of world in passes of samples over the whole image,
+     * writing it in PPM format to a file. 
+     * Depending on settings, a preview image and a checkpoint of the accumulated samples are written periodically,
+     * and the render may be resumed from an earlier checkpoint.
+     * With a crop window, only the tiles that overlap it are rendered, with the seeds they have in the whole image,
+     * so a seeded crop matches the same pixels of a seeded render of the whole image exactly.
+     * A partial render only takes a range of the samples, seeded as they are in a whole render, 
+     * and writes their sums to a partial render file instead of the image.
+     * Once the cancellation token of settings is set, the tiles left are skipped and the samples taken so far are written.
+     * The tiles that a pass which was cut short did render are scaled to the samples of the others.
+     * 
+     * @param world The world that the camera can observe.
+     * @param filename The name of the file to be written. The file name must include a path and .ppm extension.
+     * The file will be truncated if it already exists, or created if it doesn't.
+     * @param settings The runtime options of the render.
+     */
+    void render(const Hittable& world, const std::string& filename, const RenderSettings& settings) const {
+        PixelWindow output = output_window(settings);
+        AccumulationBuffer buffer {CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height};
+        if (settings.resume) {
+            resume_from_checkpoint(buffer, settings);
+        }
+        //the samples before the range are skipped, so that passes are seeded as they are in a whole render
+        if (settings.partial()) {
+            buffer.add_samples(settings.sample_range_begin);
+        }
+
+        //a time budget without a sample target keeps refining until the deadline
+        long default_target_samples = settings.time_budgeted() ? std::numeric_limits<long>::max() 
+                                                               : CameraParameters<Scene>::samples_per_pixel;
+        long target_samples = settings.partial() ? settings.sample_range_end
+                            : (settings.samples_per_pixel > 0) ? settings.samples_per_pixel : default_target_samples;
+        long samples_per_pass = (settings.samples_per_pass > 0) ? settings.samples_per_pass 
+                              : settings.time_budgeted() ? 1 : target_samples;
+        
+        std::optional<CostBuffer> costs;
+        if (settings.cost_heatmaps()) {
+            costs.emplace(CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height);
+        }
+        std::optional<FeatureBuffer> features;
+        if (settings.samples_features()) {
+            features.emplace(CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height);
+            if (settings.resume) {
+                resume_features(*features, settings.checkpoint_filename);
+            }
+        }
+        std::optional<PPMStream> stream;
+        if (settings.streaming()) {
+            stream.emplace(settings.stream_target, output.width(), output.height());
+        }
+        std::optional<Distributed::Coordinator> coordinator;
+        if (settings.distributed()) {
+            coordinator.emplace(settings.distribute, distributed_hello(settings));
+        }
+
+        RenderStats::reset();
+        Stopwatch render_time;
+        long starting_samples = buffer.samples_per_pixel();
+        RenderProgress own_progress;
+        RenderProgress& progress = settings.progress ? *settings.progress : own_progress;
+        start_progress(progress, settings, target_samples - starting_samples);
+        std::optional<ProgressReporter> reporter;
+        if (settings.progress_every_seconds > 0) {
+            reporter.emplace(progress, settings.progress_every_seconds);
+        }
+        Stopwatch since_checkpoint;
+        int passes_since_checkpoint = 0;
+        bool finished = buffer.samples_per_pixel() >= target_samples || settings.cancelled();
+        while (!finished) {
+            Stopwatch pass_time;
+            //seeding passes by the samples taken so far keeps resumed renders deterministic too
+            std::optional<std::uint64_t> pass_seed;
+            if (settings.seeded()) {
+                pass_seed = Random::mix_seed(settings.seed, static_cast<std::uint64_t>(buffer.samples_per_pixel()));
+            }
+            long pass_samples = std::min(samples_per_pass, target_samples - buffer.samples_per_pixel());
+            //the rows of the last pass are final as soon as they are rendered, unless the denoiser still has to filter them
+            bool stream_pass = stream && !settings.denoise && buffer.samples_per_pixel() + pass_samples >= target_samples;
+            render_pass(world, buffer, pass_samples, costs ? &*costs : nullptr, features ? &*features : nullptr, 
+                        stream_pass ? &*stream : nullptr, coordinator ? &*coordinator : nullptr, pass_seed, progress, settings);
+            long long pass_ns = pass_time.elapsed_ns();
+            ++passes_since_checkpoint;
+            
+            finished = buffer.samples_per_pixel() >= target_samples || !time_remains_for_pass(settings, render_time, pass_ns)
+                    || settings.cancelled();
+            if (!finished && checkpoint_due(settings, passes_since_checkpoint, since_checkpoint)) {
+                if (!stream) {
+                    write_image(buffer, filename, settings);
+                }
+                write_checkpoint(buffer, features ? &*features : nullptr, settings);
+                std::cout << "Checkpoint: " << buffer.samples_per_pixel() << " samples per pixel" << std::endl;
+                passes_since_checkpoint = 0;
+                since_checkpoint.reset();
+            }
+        }
+
+        reporter.reset();
+        //a cancelled render writes the samples it has, as if it had been asked for that many
+        bool cancelled = settings.cancelled();
+        if (cancelled) {
+            std::cout << "Cancelled: writing " << buffer.samples_per_pixel() << " samples per pixel" << std::endl;
+        }
+
+        std::optional<AccumulationBuffer> denoised;
+        //the features of a cancelled render may miss the tiles of its last pass
+        if (settings.denoise && !cancelled) {
+            denoised = denoise(buffer, *features);
+        }
+        const AccumulationBuffer& final_image = denoised ? *denoised : buffer;
+        if (settings.partial()) {
+            if (buffer.samples_per_pixel() > settings.sample_range_begin) {
+                write_partial(buffer, settings);
+            }
+        }
+        else if (!stream) {
+            write_image(final_image, filename, settings);
+        }
+        else {
+            //the rows that the last pass has not streamed, or all of them
+            write_stream(final_image, *stream, crop_window(settings), output, output.row_max, sample_scale(final_image.samples_per_pixel()));
+        }
+        //an OpenEXR file holds the AOVs as extra channels, instead of a file of their own
+        if (settings.writes_exr()) {
+            write_exr(final_image, settings.aovs() ? &*features : nullptr, settings);
+        }
+        else if (settings.aovs()) {
+            write_aovs(buffer, *features, settings.aov_filename);
+        }
+        if (costs) {
+            write_heatmaps(*costs, settings.heatmap_filename_stem);
+        }
+        //the final checkpoint allows more samples to be added to a finished render
+        if (settings.checkpointing()) {
+            write_checkpoint(buffer, features ? &*features : nullptr, settings);
+        }
+        if (settings.time_budgeted()) {
+            report_time_budget(buffer, buffer.samples_per_pixel() - starting_samples, crop_window(settings), render_time);
+        }
+        if (coordinator) {
+            coordinator->report(std::cout);
+        }
+        if constexpr (RenderStats::enabled) {
+            RenderStats::report(std::cout, RenderStats::collect(), render_time.elapsed_seconds());
+        }
+    }
+
+    /**
+     * @brief Renders a tile job of a distributed render, as render_pass renders the same tile of a local render.
+     * 
+     * @param world The world that the camera can observe.
+     * @param job the tile, its samples per pixel and the seed of its pass.
+     * @param scratch a buffer of the size of the image, black where the tile lies. It is left black there.
+     * @param settings the runtime options of the render, which choose how the tile is traced.
+     * @param sums where the sums of the color samples of the tile are written, in raster order.
+     */
+    void render_job(const Hittable& world, const Distributed::TileJob& job, AccumulationBuffer& scratch, 
+                    const RenderSettings& settings, float_type* sums) const {
+        render_seeded_tile(job.row_min, job.row_max, job.col_min, job.col_max, world, scratch, job.samples, nullptr, 
+                           job.pass_seed, settings);
+        for (int j = job.row_min; j < job.row_max; ++j) {
+            for (int i = job.col_min; i < job.col_max; ++i) {
+                ColorSum sum = scratch.take(j, i);
+                *sums++ = sum.x();
+                *sums++ = sum.y();
+                *sums++ = sum.z();
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the Hello that a distributed render sends to its workers.
+     * 
+     * @param settings the runtime options of the render, which must be seeded.
+     * @return Distributed::Hello what the workers need to render the same image as this camera
+     */
+    static Distributed::Hello distributed_hello(const RenderSettings& settings) {
+        Distributed::Hello hello;
+        hello.seed = settings.seed;
+        hello.width = CameraParameters<Scene>::image_width;
+        hello.height = CameraParameters<Scene>::image_height;
+        hello.packets = settings.packets;
+        hello.wavefront = settings.wavefront;
+        return hello;
+    }
+
+    /**
+     * @brief Progressively renders an image of world into a buffer in memory, in passes of samples over the crop window,
+     * seeded as render seeds them. No file is read or written.
+     *
+     * @param world The world that the camera can observe.
+     * @param buffer the buffer that accumulates the samples of the render, the size of the image.
+     * @param settings The runtime options of the render. Only the samples, pass size, time budget, seed, crop window,
+     * tracer, cancellation token and progress counter are used. A cancelled render keeps the samples it has, as render does.
+     * @param after_pass called with buffer after every pass. The render stops early if it returns false.
+     */
+    void render_passes(const Hittable& world, AccumulationBuffer& buffer, const RenderSettings& settings,
+                       const std::function<bool(const AccumulationBuffer&)>& after_pass) const {
+        long default_target_samples = settings.time_budgeted() ? std::numeric_limits<long>::max()
+                                                               : CameraParameters<Scene>::samples_per_pixel;
+        long target_samples = (settings.samples_per_pixel > 0) ? settings.samples_per_pixel : default_target_samples;
+        long samples_per_pass = (settings.samples_per_pass > 0) ? settings.samples_per_pass
+                              : settings.time_budgeted() ? 1 : target_samples;
+        Stopwatch render_time;
+        RenderProgress own_progress;
+        RenderProgress& progress = settings.progress ? *settings.progress : own_progress;
+        start_progress(progress, settings, target_samples - buffer.samples_per_pixel());
+        bool finished = buffer.samples_per_pixel() >= target_samples || settings.cancelled();
+        while (!finished) {
+            Stopwatch pass_time;
+            std::optional<std::uint64_t> pass_seed;
+            if (settings.seeded()) {
+                pass_seed = Random::mix_seed(settings.seed, static_cast<std::uint64_t>(buffer.samples_per_pixel()));
+            }
+            long pass_samples = std::min(samples_per_pass, target_samples - buffer.samples_per_pixel());
+            render_pass(world, buffer, pass_samples, nullptr, nullptr, nullptr, nullptr, pass_seed, progress, settings);
+            bool more = after_pass(buffer);
+            finished = !more || buffer.samples_per_pixel() >= target_samples
+                    || !time_remains_for_pass(settings, render_time, pass_time.elapsed_ns()) || settings.cancelled();
+        }
+    }
+
+    /**
+     * @brief Writes the averaged samples of buffer as 8 bit R, G and B components of the output window, in raster order,
+     * tonemapped and clamped as the .ppm image that render writes.
+     *
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param settings the runtime options of the render, with the crop window and whether the image is cropped to it.
+     * @param rgb where 3 components of every pixel of the output window are written.
+     */
+    void write_pixels(const AccumulationBuffer& buffer, const RenderSettings& settings, std::uint8_t* rgb) const {
+        PixelWindow crop = crop_window(settings);
+        PixelWindow output = output_window(settings);
+        float_type scale = sample_scale(buffer.samples_per_pixel());
+        auto write_rows = [&](int row_min, int row_max) {
+            std::vector<int> components(3 * static_cast<std::size_t>(CameraParameters<Scene>::image_width));
+            for (int j = row_min; j < row_max; ++j) {
+                tonemap_row(buffer, j + output.row_min, scale, components.data());
+                clear_outside(crop, j + output.row_min, components.data());
+                auto row = static_cast<std::size_t>(j) * 3 * static_cast<std::size_t>(output.width());
+                //clamped as PixelEncoder clamps the components of an image file
+                std::transform(components.begin() + 3 * output.col_min, components.begin() + 3 * output.col_max, rgb + row,
+                               [](int component) {return static_cast<std::uint8_t>(std::clamp(component, 0, ColorConstants::max_pixel_val));});
+            }
+        };
+        Parallel::rows(output.height(), write_rows);
+    }
+
+    /**
+     * @brief Get a random ray that travels from some point on the lens to some point on the pixel.
+     * 
+     * @param i the horizontal index of the pixel
+     * @param j the vertical index of the pixel
+     * @return Ray3D the ranodm ray
+     */
+    Ray3D get_ray_sample(int i, int j) const {
+        Vector3D pixel_center = pixel00_loc + i*pixel_delta_u + j*pixel_delta_v;
+        Vector3D random_point_in_pixel = get_random_point_in_pixel(pixel_center);           //antialiasing
+        Vector3D ray_origin = (CameraParameters<Scene>::defocus_angle > 0)                  //defocus if applicable
+                                ? defocus_disk_sample() 
+                                : center;  
+        constexpr float_type start_time = 0;
+        constexpr float_type end_time = 1;
+        float_type ray_time = Random::random_float(start_time, end_time);
+        return Ray3D{ray_origin, random_point_in_pixel - ray_origin, ray_time};
     }
 
 private:   
+    using Image = ImageData<CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height>;
+
+    constexpr static float_type min_travel_distance = 0.001;  //avoid shadow acne
+
+    /**
+     * @brief Returns the scene and seed of a render, which its checkpoints record.
+     * 
+     * @param settings the runtime options of the render, with its seed.
+     * @return AccumulationBuffer::CheckpointIdentity the identity of the render's checkpoints
+     */
+    static AccumulationBuffer::CheckpointIdentity checkpoint_identity(const RenderSettings& settings) {
+        return AccumulationBuffer::CheckpointIdentity{scene_name<Scene>, settings.seed};
+    }
+
+    /**
+     * @brief Loads a checkpoint into buffer if the checkpoint file exists. 
+     * Otherwise the render starts from scratch.
+     * Throws std::runtime_error if the checkpoint was rendered from another scene or seed, 
+     * since their samples cannot be added to those of this render.
+     * 
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param settings the runtime options of the render, with its seed and checkpoint filename.
+     */
+    static void resume_from_checkpoint(AccumulationBuffer& buffer, const RenderSettings& settings) {
+        const std::string& checkpoint_filename = settings.checkpoint_filename;
+        if (!std::ifstream{checkpoint_filename}) {
+            std::cout << "No checkpoint found at " << checkpoint_filename << ", starting a new render" << std::endl;
+            return;
+        }
+        buffer.load(checkpoint_filename, checkpoint_identity(settings));
+        std::cout << "Resuming from checkpoint with " << buffer.samples_per_pixel() << " samples per pixel" << std::endl;
+    }
+
+    /**
+     * @brief Loads the features saved alongside a checkpoint into features if they exist. 
+     * Otherwise features are sampled from scratch as the render continues.
+     * 
+     * @param features the buffer of the features that guide the denoiser.
+     * @param checkpoint_filename the name of the checkpoint file
+     */
+    static void resume_features(FeatureBuffer& features, const std::string& checkpoint_filename) {
+        std::string features_filename = FeatureBuffer::filename_for(checkpoint_filename);
+        if (std::ifstream{features_filename}) {
+            features.load(features_filename);
+        }
+    }
+
+    /**
+     * @brief Returns whether a preview image and checkpoint should be written after the current pass.
+     * 
+     * @param settings the runtime options of the render
+     * @param passes_since_checkpoint the number of passes rendered since the last checkpoint
+     * @param since_checkpoint a Stopwatch started at the last checkpoint
+     * @return true if either checkpoint interval has been reached
+     * @return false otherwise
+     */
+    static bool checkpoint_due(const RenderSettings& settings, int passes_since_checkpoint, const Stopwatch& since_checkpoint) {
+        if (!settings.checkpointing()) {
+            return false;
+        }
+        bool passes_reached = settings.checkpoint_every_passes > 0 && passes_since_checkpoint >= settings.checkpoint_every_passes;
+        bool seconds_reached = settings.checkpoint_every_seconds > 0 && since_checkpoint.elapsed_seconds() >= settings.checkpoint_every_seconds;
+        return passes_reached || seconds_reached;
+    }
+
+    /**
+     * @brief Returns whether another pass is expected to finish before the time budget runs out.
+     * Passes are never interrupted, so the estimate uses the duration of the previous pass.
+     * 
+     * @param settings the runtime options of the render
+     * @param render_time a Stopwatch started at the beginning of the render
+     * @param last_pass_ns the duration of the previous pass in nanoseconds
+     * @return true if there is no time budget, or another pass fits in the remaining time
+     * @return false otherwise
+     */
+    static bool time_remains_for_pass(const RenderSettings& settings, const Stopwatch& render_time, long long last_pass_ns) {
+        if (!settings.time_budgeted()) {
+            return true;
+        }
+        auto budget_ns = static_cast<long long>(static_cast<double>(settings.time_budget_seconds) * 1e9);
+        return render_time.elapsed_ns() + last_pass_ns <= budget_ns;
+    }
+
+    /**
+     * @brief Prints the quality and throughput that a time budgeted render reached.
+     * 
+     * @param buffer the buffer that accumulated the samples of the render.
+     * @param samples_rendered the samples per pixel added during this render (excluding resumed samples).
+     * @param crop the pixels that the samples were added to.
+     * @param render_time a Stopwatch started at the beginning of the render
+     */
+    static void report_time_budget(const AccumulationBuffer& buffer, long samples_rendered, const PixelWindow& crop, 
+                                   const Stopwatch& render_time) {
+        double seconds = render_time.elapsed_seconds();
+        double camera_rays = static_cast<double>(samples_rendered) * crop.width() * crop.height();
+        std::cout << "Time budget: reached " << buffer.samples_per_pixel() << " samples per pixel in " 
+                  << seconds << " seconds (" << camera_rays / seconds << " camera rays/sec)" << std::endl;
+    }
+
+    /**
+     * @brief Adds samples new samples to every pixel of the crop window, or of the image if there is none.
+     * 
+     * @param world the world that the camera will render.
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param samples the number of samples taken for every pixel during the pass.
+     * @param costs if not null, the buffer that the cost of rendering each pixel is added to.
+     * @param features if not null, the buffer that first-hit features are added to, 
+     * until it has FeatureBuffer::max_samples per pixel.
+     * @param stream if not null, the stream that the rows of the image are written to, in order, as soon as they are rendered.
+     * The image is then rendered in bands of rows from the top, a few at a time.
+     * @param coordinator if not null, the tiles are rendered by its workers, and their sums merged into buffer.
+     * @param pass_seed if set, every tile reseeds its thread's generator from pass_seed and its position,
+     * so that the pass is deterministic however the tiles are scheduled.
+     * @param progress counts the tiles as they are rendered.
+     * @param settings the runtime options of the render, which choose the crop window and how tiles are traced. 
+     * Packets and waves are not used when costs are measured per pixel. Once it is cancelled, the remaining tiles are skipped
+     * and the pass is cut short by cut_pass. The features that a cut pass sampled are dropped, unless they are the first,
+     * as the skipped tiles then have none to be consistent with.
+     */
+    void render_pass(const Hittable& world, AccumulationBuffer& buffer, long samples, CostBuffer* costs, FeatureBuffer* features,
+                     PPMStream* stream, Distributed::Coordinator* coordinator, std::optional<std::uint64_t> pass_seed, 
+                     RenderProgress& progress, const RenderSettings& settings) const {
+        Trace::ScopedTimer timer {"render_pass"};
+        long feature_samples = features ? features->samples_wanted(samples) : 0;
+        //the features before the pass, which a cut pass returns to
+        std::optional<FeatureBuffer> features_before;
+        if (feature_samples > 0 && features->samples_per_pixel() > 0) {
+            features_before = *features;
+        }
+        PixelWindow crop = crop_window(settings);
+        PixelWindow tiles = tile_window(crop);
+        constexpr int tile_size = AccumulationBuffer::tile_size;
+        int tiles_per_row = (tiles.width() + tile_size - 1) / tile_size;
+        //every tile is marked by the one thread that renders it
+        std::vector<char> rendered(static_cast<std::size_t>(tiles_per_row) * static_cast<std::size_t>((tiles.height() + tile_size - 1) / tile_size), 0);
+        //the recursive tiling starts a thread for every tile, but only one tile per hardware thread is rendered at once,
+        //so that the tiles still waiting for a slot when the render is cancelled are skipped
+        std::counting_semaphore<> slots {std::max<std::ptrdiff_t>(1, std::thread::hardware_concurrency())};
+        auto render_samples = [&](int row_min, int row_max, int col_min, int col_max) {
+            slots.acquire();
+            bool cancelled = settings.cancelled();
+            if (!cancelled) {
+                render_seeded_tile(row_min, row_max, col_min, col_max, world, buffer, samples, costs, pass_seed, settings);
+                //after the color samples, so that they are the same as without features
+                if (feature_samples > 0) {
+                    sample_features(row_min, row_max, col_min, col_max, world, *features, feature_samples);
+                }
+            }
+            slots.release();
+            if (!cancelled) {
+                rendered[static_cast<std::size_t>((row_min - tiles.row_min) / tile_size * tiles_per_row + (col_min - tiles.col_min) / tile_size)] = 1;
+                progress.add_tile(static_cast<long long>(row_max - row_min) * (col_max - col_min) * samples);
+            }
+        };
+        if (stream) {
+            //rows are written with the samples that the pass is adding, which are only recorded once it is done.
+            //a band is only complete if the render was not cancelled before it was
+            float_type scale = sample_scale(buffer.samples_per_pixel() + samples);
+            PixelWindow output = output_window(settings);
+            auto write_band = [&](int, int row_max) {
+                if (!settings.cancelled()) {
+                    write_stream(buffer, *stream, crop, output, row_max, scale);
+                }
+            };
+            parallel_render_bands(tiles, render_samples, write_band);
+            //the black rows below the crop of a full size image
+            if (!settings.cancelled()) {
+                write_stream(buffer, *stream, crop, output, output.row_max, scale);
+            }
+        }
+        else if (coordinator) {
+            auto merge = [&](const Distributed::TileJob& job, const float_type* sums) {
+                for (int j = job.row_min; j < job.row_max; ++j) {
+                    for (int i = job.col_min; i < job.col_max; ++i, sums += 3) {
+                        buffer.add(j, i, ColorSum{sums[0], sums[1], sums[2]});
+                    }
+                }
+                rendered[static_cast<std::size_t>((job.row_min - tiles.row_min) / tile_size * tiles_per_row + (job.col_min - tiles.col_min) / tile_size)] = 1;
+                progress.add_tile(static_cast<long long>(job.row_max - job.row_min) * (job.col_max - job.col_min) * samples);
+            };
+            coordinator->render_pass(tile_jobs(tiles, samples, *pass_seed), merge, [&] {return settings.cancelled();});
+        }
+        else {
+            parallel_render_tile(tiles.row_min, tiles.row_max, tiles.col_min, tiles.col_max, render_samples);
+        }
+        if (std::find(rendered.begin(), rendered.end(), 0) != rendered.end()) {
+            cut_pass(buffer, samples, tiles, rendered, settings);
+            if (features_before) {
+                *features = std::move(*features_before);
+            }
+            else if (features) {
+                features->add_samples(feature_samples);
+            }
+            return;
+        }
+        buffer.add_samples(samples);
+        if (features) {
+            features->add_samples(feature_samples);
+        }
+    }
+
+    /**
+     * @brief Leaves buffer with a valid image after a cancellation skipped some tiles of a pass.
+     * The rendered tiles hold more samples than the others, so their sums are scaled to the samples that the others hold,
+     * which keeps their averages. If the others hold none, the pass keeps its samples and they stay black,
+     * unless it is the first pass of a partial render, which is dropped.
+     *
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param samples the number of samples that the pass took for every rendered pixel.
+     * @param tiles the window of the tiles of the pass.
+     * @param rendered whether every tile of the pass was rendered, from the top.
+     * @param settings the runtime options of the render.
+     */
+    static void cut_pass(AccumulationBuffer& buffer, long samples, const PixelWindow& tiles, const std::vector<char>& rendered,
+                         const RenderSettings& settings) {
+        constexpr int tile_size = AccumulationBuffer::tile_size;
+        int tiles_per_row = (tiles.width() + tile_size - 1) / tile_size;
+        //the samples of a partial render before its range are counted, but not summed
+        long summed = buffer.samples_per_pixel() - (settings.partial() ? settings.sample_range_begin : 0);
+        if (summed == 0 && !settings.partial()) {
+            buffer.add_samples(samples);
+            return;
+        }
+        float_type factor = static_cast<float_type>(static_cast<double>(summed) / static_cast<double>(summed + samples));
+        for (std::size_t tile = 0; tile < rendered.size(); ++tile) {
+            if (rendered[tile]) {
+                int row_min = tiles.row_min + static_cast<int>(tile) / tiles_per_row * tile_size;
+                int col_min = tiles.col_min + static_cast<int>(tile) % tiles_per_row * tile_size;
+                buffer.scale(row_min, std::min(row_min + tile_size, tiles.row_max), col_min, std::min(col_min + tile_size, tiles.col_max), factor);
+            }
+        }
+    }
+
+    /**
+     * @brief Starts counting the progress of a render.
+     *
+     * @param progress the progress of the render.
+     * @param settings the runtime options of the render, with its crop window and time budget.
+     * @param samples the samples per pixel that the render will add, or more than any render takes if only a time budget ends it.
+     */
+    static void start_progress(RenderProgress& progress, const RenderSettings& settings, long samples) {
+        PixelWindow tiles = tile_window(crop_window(settings));
+        bool counted = samples < std::numeric_limits<long>::max() / 2;
+        progress.start(counted ? static_cast<long long>(tiles.width()) * tiles.height() * samples : 0, settings.time_budget_seconds);
+    }
+
+    /**
+     * @brief Seeds the generator of this thread for a tile if the pass is seeded, then renders it 
+     * with the tracer that settings choose.
+     * 
+     * @param row_min the minimum vertical index of the pixel range. inclusive.
+     * @param row_max the maximum vertical index of the pixel range. exclusive.
+     * @param col_min the minimum horizontal index of the pixel range. inclusive.
+     * @param col_max the maximum horizontal index of the pixel range. exclusive.
+     * @param world the world that the camera will render.
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param samples the number of samples taken for every pixel.
+     * @param costs if not null, the buffer that the cost of rendering each pixel is added to.
+     * @param pass_seed if set, the seed of the pass, which is mixed with the position of the tile.
+     * @param settings the runtime options of the render. Packets and waves are not used when costs are measured per pixel.
+     */
+    void render_seeded_tile(int row_min, int row_max, int col_min, int col_max, const Hittable& world, AccumulationBuffer& buffer,
+                            long samples, CostBuffer* costs, std::optional<std::uint64_t> pass_seed, const RenderSettings& settings) const {
+        if (pass_seed) {
+            Random::seed(Random::mix_seed(*pass_seed, static_cast<std::uint64_t>(row_min) * CameraParameters<Scene>::image_width 
+                                                      + static_cast<std::uint64_t>(col_min)));
+        }
+        if (settings.wavefront && costs == nullptr) {
+            render_tile_wavefront(row_min, row_max, col_min, col_max, world, buffer, samples);
+        }
+        else if (settings.packets && costs == nullptr) {
+            render_tile_packets(row_min, row_max, col_min, col_max, world, buffer, samples);
+        }
+        else {
+            render_tile(row_min, row_max, col_min, col_max, world, buffer, samples, costs);
+        }
+    }
+
+    /**
+     * @brief Returns a job for every tile of the image grid in a window, from the top.
+     * 
+     * @param window the pixels rendered, which must start on the tile grid.
+     * @param samples the number of samples taken for every pixel during the pass.
+     * @param pass_seed the seed of the pass.
+     * @return std::vector<Distributed::TileJob> the jobs of the pass
+     */
+    static std::vector<Distributed::TileJob> tile_jobs(const PixelWindow& window, long samples, std::uint64_t pass_seed) {
+        constexpr int tile_size = AccumulationBuffer::tile_size;
+        std::vector<Distributed::TileJob> jobs;
+        for (int row_min = window.row_min; row_min < window.row_max; row_min += tile_size) {
+            for (int col_min = window.col_min; col_min < window.col_max; col_min += tile_size) {
+                jobs.push_back({row_min, std::min(row_min + tile_size, window.row_max), 
+                                col_min, std::min(col_min + tile_size, window.col_max), samples, pass_seed});
+            }
+        }
+        return jobs;
+    }
+
+    /**
+     * @brief Writes buffer to a checkpoint file so that the render can be resumed.
+     * 
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param features if not null, the features that guide the denoiser, which are saved alongside the checkpoint.
+     * @param settings the runtime options of the render, with its seed and checkpoint filename.
+     */
+    static void write_checkpoint(const AccumulationBuffer& buffer, const FeatureBuffer* features, const RenderSettings& settings) {
+        Trace::ScopedTimer timer {"write_checkpoint"};
+        const std::string& checkpoint_filename = settings.checkpoint_filename;
+        buffer.save(checkpoint_filename, checkpoint_identity(settings));
+        if (features) {
+            features->save(FeatureBuffer::filename_for(checkpoint_filename));
+        }
+    }
+
+    /**
+     * @brief Returns the denoised image of buffer, reporting how long the denoiser took.
+     * 
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param features the features that guide the denoiser.
+     * @return AccumulationBuffer the denoised image
+     */
+    static AccumulationBuffer denoise(const AccumulationBuffer& buffer, const FeatureBuffer& features) {
+        Trace::ScopedTimer timer {"denoise"};
+        Stopwatch denoise_time;
+        AccumulationBuffer denoised = Denoiser::denoise(buffer, features);
+        std::cout << "Denoise: " << denoise_time.elapsed_seconds() << " seconds" << std::endl;
+        return denoised;
+    }
+
+    /**
+     * @brief Writes the beauty image and the first-hit features of a render as the channels of an AOV file.
+     * 
+     * @param buffer the accumulated samples of the render, written before denoising.
+     * @param features the features sampled during the render.
+     * @param aov_filename the name of the file, with path and extension.
+     */
+    static void write_aovs(const AccumulationBuffer& buffer, const FeatureBuffer& features, const std::string& aov_filename) {
+        Trace::ScopedTimer timer {"write_aovs"};
+        std::vector<AOVFile::Channel> channels = AOVFile::make_channels(buffer, features);
+        AOVFile::write(aov_filename, buffer.width(), buffer.height(), channels);
+        std::cout << "AOVs: " << channels.size() << " channels written to " << aov_filename << std::endl;
+    }
+
+    /**
+     * @brief Writes the final image of a render as an OpenEXR file, unclamped and linear.
+     * 
+     * @param image the final image of the render.
+     * @param features if not null, the first-hit features that are written as extra channels.
+     * @param settings the runtime options of the render, with the name, pixel type and compression of the file.
+     */
+    static void write_exr(const AccumulationBuffer& image, const FeatureBuffer* features, const RenderSettings& settings) {
+        Trace::ScopedTimer timer {"write_exr"};
+        std::vector<AOVFile::Channel> channels = features ? AOVFile::make_channels(image, *features) 
+                                                          : AOVFile::beauty_channels(image);
+        EXRFile::write(settings.exr_filename, image.width(), image.height(), channels, settings.exr);
+        std::cout << "EXR: " << channels.size() << " channels written to " << settings.exr_filename << std::endl;
+    }
+
+    /**
+     * @brief Writes the sums of the samples of a partial render, over the crop window, to a partial render file.
+     * 
+     * @param buffer the buffer that accumulated the samples of the range, and counts the samples before it.
+     * @param settings the runtime options of the render, with the sample range, seed, crop window and file name.
+     */
+    static void write_partial(const AccumulationBuffer& buffer, const RenderSettings& settings) {
+        Trace::ScopedTimer timer {"write_partial"};
+        PartialRender::Header header;
+        header.width = buffer.width();
+        header.height = buffer.height();
+        header.seed = settings.seed;
+        header.sample_begin = settings.sample_range_begin;
+        header.sample_end = buffer.samples_per_pixel();
+        header.window = crop_window(settings);
+        PartialRender partial {header};
+        for (int j = header.window.row_min; j < header.window.row_max; ++j) {
+            for (int i = header.window.col_min; i < header.window.col_max; ++i) {
+                const float_type* sum = buffer.sums(j, i);
+                partial.sum(j, i) = ColorSum{sum[0], sum[1], sum[2]};
+            }
+        }
+        partial.save(settings.partial_filename);
+        std::cout << "Partial: samples " << header.sample_begin << " to " << header.sample_end 
+                  << " written to " << settings.partial_filename << std::endl;
+    }
+
+    /**
+     * @brief Writes the averaged samples of buffer to a .ppm image file.
+     * 
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param filename The name of the file to be written. The file name must include a path and .ppm extension.
+     * @param settings the runtime options of the render, with the crop window and whether the image is cropped to it.
+     */
+    void write_image(const AccumulationBuffer& buffer, const std::string& filename, const RenderSettings& settings) const {
+        Trace::ScopedTimer timer {"write_image"};
+        PixelWindow crop = crop_window(settings);
+        PixelWindow output = output_window(settings);
+        float_type scale = sample_scale(buffer.samples_per_pixel());
+        //a cropped image is smaller than the fixed size of Image, so it is written one row after another
+        if (output != image_window()) {
+            PPMStream cropped_image {filename, output.width(), output.height()};
+            write_stream(buffer, cropped_image, crop, output, output.row_max, scale);
+            return;
+        }
+        Image image_data {filename};
+        //whole rows in one band per thread: encoding costs the same everywhere, so tiles would only add threads
+        auto write_rows = [&](int row_min, int row_max) {
+            auto count = static_cast<std::size_t>(CameraParameters<Scene>::image_width);
+            std::vector<int> components(3 * count);
+            for (int j = row_min; j < row_max; ++j) {
+                tonemap_row(buffer, j, scale, components.data());
+                clear_outside(crop, j, components.data());
+                image_data.write_row(j, 0, components.data(), count);
+            }
+        };
+        Parallel::rows(CameraParameters<Scene>::image_height, write_rows);
+    }
+
+    /**
+     * @brief Writes the averaged samples of buffer to a stream, from the next row that it expects up to row_max.
+     * 
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param stream the stream of the image, which is the size of output.
+     * @param crop the rendered pixels. Pixels outside of it are written black.
+     * @param output the pixels of the image that the stream holds.
+     * @param row_max the row of the image before which writing stops. exclusive.
+     * @param scale the reciprocal of the samples per pixel that the rows hold.
+     */
+    static void write_stream(const AccumulationBuffer& buffer, PPMStream& stream, const PixelWindow& crop, 
+                             const PixelWindow& output, int row_max, float_type scale) {
+        Trace::ScopedTimer timer {"write_stream"};
+        std::vector<int> components(3 * static_cast<std::size_t>(buffer.width()));
+        for (int j = output.row_min + stream.rows_written(); j < std::min(row_max, output.row_max); ++j) {
+            tonemap_row(buffer, j, scale, components.data());
+            clear_outside(crop, j, components.data());
+            stream.write_row(components.data() + 3 * static_cast<std::size_t>(output.col_min));
+        }
+    }
+
+    /**
+     * @brief Sets the components of the pixels of a row that lie outside of the crop window to black.
+     * Tiles that overlap the edges of the window are rendered whole, so these pixels may hold samples.
+     * 
+     * @param crop the rendered pixels.
+     * @param row the row, 0 indexed from the top
+     * @param components the R, G and B components of every pixel of the row
+     */
+    static void clear_outside(const PixelWindow& crop, int row, int* components) {
+        constexpr int width = CameraParameters<Scene>::image_width;
+        bool row_inside = row >= crop.row_min && row < crop.row_max;
+        std::fill(components, components + 3 * (row_inside ? crop.col_min : width), 0);
+        if (row_inside) {
+            std::fill(components + 3 * crop.col_max, components + 3 * width, 0);
+        }
+    }
+
+    /**
+     * @brief Returns the window of every pixel of the image.
+     * 
+     * @return PixelWindow the whole image
+     */
+    static PixelWindow image_window() {
+        return PixelWindow{0, 0, CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height};
+    }
+
+    /**
+     * @brief Returns the pixels that are rendered.
+     * Throws std::invalid_argument if the crop window of settings does not fit in the image.
+     * 
+     * @param settings the runtime options of the render.
+     * @return PixelWindow the crop window, or the whole image if there is none
+     */
+    static PixelWindow crop_window(const RenderSettings& settings) {
+        if (!settings.cropped()) {
+            return image_window();
+        }
+        if (!image_window().contains(settings.crop)) {
+            throw std::invalid_argument("--crop window does not fit in the " + std::to_string(CameraParameters<Scene>::image_width) 
+                                        + "x" + std::to_string(CameraParameters<Scene>::image_height) + " image");
+        }
+        return settings.crop;
+    }
+
     /**
-     * @brief Renders a rectangle of pixels.
+     * @brief Returns the pixels of the image that the output file or stream holds.
+     * 
+     * @param settings the runtime options of the render.
+     * @return PixelWindow the crop window, unless the whole image is written
+     */
+    static PixelWindow output_window(const RenderSettings& settings) {
+        return settings.crop_full_size ? image_window() : crop_window(settings);
+    }
+
+    /**
+     * @brief Returns the smallest window of whole tiles of the image grid that covers window.
+     * Rendering it cuts the same tiles, with the same seeds, as rendering the whole image.
+     * 
+     * @param window the pixels that must be rendered.
+     * @return PixelWindow window, grown to the tile grid and clipped to the image
+     */
+    static PixelWindow tile_window(const PixelWindow& window) {
+        constexpr int tile_size = AccumulationBuffer::tile_size;
+        auto round_up = [](int value, int limit) {return std::min((value + tile_size - 1) / tile_size * tile_size, limit);};
+        return PixelWindow{window.col_min / tile_size * tile_size, window.row_min / tile_size * tile_size, 
+                           round_up(window.col_max, CameraParameters<Scene>::image_width), 
+                           round_up(window.row_max, CameraParameters<Scene>::image_height)};
+    }
+
+    /**
+     * @brief Converts a row of the averaged samples of buffer to gamma corrected components, in raster order.
+     * 
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param row the row, 0 indexed from the top
+     * @param scale the reciprocal of the samples per pixel that the row holds.
+     * @param components where the R, G and B components of every pixel of the row are written
+     */
+    static void tonemap_row(const AccumulationBuffer& buffer, int row, float_type scale, int* components) {
+        //the buffer stores rows in pieces, one per tile
+        for (int i = 0, n = 0; i < buffer.width(); i += n) {
+            n = buffer.contiguous_pixels(i);
+            Kernels::active().tonemap_row(buffer.sums(row, i), AccumulationBuffer::sum_stride, static_cast<std::size_t>(n), 
+                                          scale, components + 3 * static_cast<std::size_t>(i));
+        }
+    }
+
+    /**
+     * @brief Returns the factor that turns the sums of a number of samples into their average.
+     * 
+     * @param samples_per_pixel the samples summed in every pixel
+     * @return float_type the reciprocal of samples_per_pixel, or 0 if no samples have been taken
+     */
+    static float_type sample_scale(long samples_per_pixel) {
+        return samples_per_pixel == 0 ? 0 : static_cast<float_type>(1.0 / static_cast<double>(samples_per_pixel));
+    }
+
+    /**
+     * @brief Writes a false-color heatmap image for each cost metric, named <stem>_heat_<metric>.ppm.
+     * Counter based metrics are only measured in a RAYTRACER_STATS build, so otherwise only the time heatmap is written.
+     * 
+     * @param costs the cost of rendering each pixel
+     * @param stem the path and name that the heatmap filenames start with
+     */
+    void write_heatmaps(const CostBuffer& costs, const std::string& stem) const {
+        Trace::ScopedTimer timer {"write_heatmaps"};
+        if constexpr (!RenderStats::enabled) {
+            std::cout << "Heatmaps: BVH node, primitive test and path depth counts require a RAYTRACER_STATS build, "
+                      << "writing the time heatmap only" << std::endl;
+        }
+        for (int m = 0; m < CostBuffer::num_metrics; ++m) {
+            auto metric = static_cast<CostMetric>(m);
+            if (!RenderStats::enabled && metric != CostMetric::time) {
+                continue;
+            }
+            double max_value = costs.max_value(metric);
+            Image image_data {stem + "_heat_" + CostBuffer::metric_names[m] + ".ppm"};
+            auto write_rows = [&](int row_min, int row_max) {
+                for (int j = row_min; j < row_max; ++j) {
+                    for (int i = 0; i < CameraParameters<Scene>::image_width; ++i) {
+                        CostBuffer::false_color(costs.value(metric, j, i), max_value).write_pixel(j, i, image_data);
+                    }
+                }
+            };
+            Parallel::rows(CameraParameters<Scene>::image_height, write_rows);
+            std::cout << "Heatmap " << CostBuffer::metric_names[m] << ": max " << max_value 
+                      << (metric == CostMetric::path_depth ? " bounces per camera ray" 
+                        : metric == CostMetric::time ? " ns per pixel" : " per pixel") << std::endl;
+        }
+    }
+
+    /**
+     * @brief Renders a rectangle of pixels, adding samples new samples to each of them.
      * 
      * @param row_min the minimum vertical index of the pixel range. inclusive.
      * @param row_max the maximum vertical index of the pixel range. exclusive.
      * @param col_min the minimum horizontal index of the pixel range. inclusive.
      * @param col_max the maximum horizontal index of the pixel range. exclusive.
      * @param world the world that the camera will render.
-     * @param image_data the object where pixel data will be written to.
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param samples the number of samples taken for every pixel.
+     * @param costs if not null, the buffer that the cost of rendering each pixel is added to.
      */
     void render_tile(   int row_min, int row_max, int col_min, int col_max, 
                         const Hittable& world, 
-                        ImageData<CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height>& image_data) const
+                        AccumulationBuffer& buffer,
+                        long samples,
+                        CostBuffer* costs) const
     {   
         for (int j = row_min; j < row_max; ++j) {
             for (int i = col_min; i < col_max; ++i) {
-                ColorSum sum_color_samples {0, 0, 0};    
-                for (int s = 0; s < CameraParameters<Scene>::samples_per_pixel; ++s) {
-                    Color color_sample = ray_color(get_ray_sample(i, j), world);
-                    sum_color_samples += color_sample;
+                if (costs == nullptr) {
+                    buffer.add(j, i, sample_pixel(i, j, world, samples));
+                }
+                else {
+                    PixelCost before = PixelCost::snapshot();
+                    Stopwatch pixel_time {CLOCK_THREAD_CPUTIME_ID};   //excludes time that the thread was descheduled
+                    buffer.add(j, i, sample_pixel(i, j, world, samples));
+                    costs->add(j, i, PixelCost::between(before, PixelCost::snapshot(), pixel_time.elapsed_ns()));
                 }
-                Color pixel_color = sum_color_samples.scale(CameraParameters<Scene>::samples_per_pixel);
-                pixel_color.write_pixel(j, i, image_data);
             }
         }
     }
 
     /**
-     * @brief Divide-and-conquer to render a rectangle of pixels on multiple threads. 
+     * @brief Adds samples of the albedo, normal, depth and ids of the first surface that camera rays hit 
+     * to every pixel of a rectangle. Rays that miss see the background, and no normal.
      * 
      * @param row_min the minimum vertical index of the pixel range. inclusive.
      * @param row_max the maximum vertical index of the pixel range. exclusive.
      * @param col_min the minimum horizontal index of the pixel range. inclusive.
      * @param col_max the maximum horizontal index of the pixel range. exclusive.
      * @param world the world that the camera will render.
-     * @param image_data the object where pixel data will be written to.
+     * @param features the buffer that the features are added to.
+     * @param samples the number of feature samples taken for every pixel.
      */
+    void sample_features(int row_min, int row_max, int col_min, int col_max, 
+                         const Hittable& world, 
+                         FeatureBuffer& features,
+                         long samples) const
+    {
+        for (int j = row_min; j < row_max; ++j) {
+            for (int i = col_min; i < col_max; ++i) {
+                for (long s = 0; s < samples; ++s) {
+                    HitRecord hit_record = world.hit(get_ray_sample(i, j), Interval(min_travel_distance, infinity));
+                    FeatureSample sample {CameraParameters<Scene>::background};
+                    if (hit_record.is_hit) {
+                        sample.albedo = hit_record.material_ptr->surface_albedo(hit_record);
+                        sample.unit_normal = hit_record.unit_normal;
+                        //linear depth along the viewing direction, not the distance along the ray, as compositing expects
+                        sample.depth = (hit_record.point - center).dot(-w);
+                        sample.material_id = hit_record.material_ptr->id();
+                        sample.primitive_id = hit_record.primitive_id;
+                    }
+                    features.add(j, i, sample);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Renders a rectangle of pixels like render_tile, but traces the camera rays of each 
+     * RayPacket::width x RayPacket::width block of pixels together as a packet. 
+     * Rays that bounce are traced on their own.
+     * 
+     * @param row_min the minimum vertical index of the pixel range. inclusive.
+     * @param row_max the maximum vertical index of the pixel range. exclusive.
+     * @param col_min the minimum horizontal index of the pixel range. inclusive.
+     * @param col_max the maximum horizontal index of the pixel range. exclusive.
+     * @param world the world that the camera will render.
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param samples the number of samples taken for every pixel.
+     */
+    void render_tile_packets(int row_min, int row_max, int col_min, int col_max, 
+                             const Hittable& world, 
+                             AccumulationBuffer& buffer,
+                             long samples) const
+    {
+        for (int block_row = row_min; block_row < row_max; block_row += RayPacket::width) {
+            for (int block_col = col_min; block_col < col_max; block_col += RayPacket::width) {
+                std::array<ColorSum, RayPacket::size> sums {};
+                for (long s = 0; s < samples; ++s) {
+                    RayPacket packet;
+                    RayPacket::Mask active = 0;
+                    for (int lane = 0; lane < RayPacket::size; ++lane) {
+                        int j = block_row + lane / RayPacket::width;
+                        int i = block_col + lane % RayPacket::width;
+                        if (j < row_max && i < col_max) {
+                            packet.set(lane, get_ray_sample(i, j));
+                            active |= RayPacket::Mask{1} << lane;
+                        }
+                    }
+
+                    PacketHits hits {};
+                    world.hit_packet(packet, min_travel_distance, hits, active);
+                    for (int lane = 0; lane < RayPacket::size; ++lane) {
+                        if ((active >> lane) & 1) {
+                            RenderStats::count_camera_ray();
+                            auto l = static_cast<std::size_t>(lane);
+                            sums[l] += shade(packet.ray(lane), hits.records[l], world, 0);
+                        }
+                    }
+                }
+
+                for (int lane = 0; lane < RayPacket::size; ++lane) {
+                    int j = block_row + lane / RayPacket::width;
+                    int i = block_col + lane % RayPacket::width;
+                    if (j < row_max && i < col_max) {
+                        buffer.add(j, i, sums[static_cast<std::size_t>(lane)]);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief The state of a light path that is traced breadth-first as part of a wave.
+     * 
+     */
+    struct PathState {
+        Ray3D ray;              //the next ray of the path
+        Color throughput;       //the product of the attenuations of every collision so far
+        int pixel;              //the index of the pixel in its tile that the path is a sample of
+        int depth;              //the number of object interactions so far
+    };
+
+    /**
+     * @brief Renders a rectangle of pixels like render_tile, but traces all of the paths of the tile breadth-first:
+     * every wave of rays is sorted by direction and intersected together, its hits are grouped by material
+     * and shaded one material type at a time without virtual calls, and the scattered rays are compacted into the next wave.
+     * 
+     * @param row_min the minimum vertical index of the pixel range. inclusive.
+     * @param row_max the maximum vertical index of the pixel range. exclusive.
+     * @param col_min the minimum horizontal index of the pixel range. inclusive.
+     * @param col_max the maximum horizontal index of the pixel range. exclusive.
+     * @param world the world that the camera will render.
+     * @param buffer the buffer that accumulates the samples of the render.
+     * @param samples the number of samples taken for every pixel.
+     */
+    void render_tile_wavefront(int row_min, int row_max, int col_min, int col_max, 
+                               const Hittable& world, 
+                               AccumulationBuffer& buffer,
+                               long samples) const
+    {
+        constexpr long max_wave_size = 4096;    //paths traced at once, bounding the memory of the wave
+        int tile_width = col_max - col_min;
+        int num_pixels = tile_width * (row_max - row_min);
+        long samples_per_wave = std::max(1L, max_wave_size / num_pixels);
+
+        std::vector<ColorSum> sums(static_cast<std::size_t>(num_pixels));
+        std::vector<PathState> wave, sorted_wave;
+        std::vector<HitRecord> hits;
+        std::vector<std::size_t> by_material;
+        for (long samples_done = 0; samples_done < samples; samples_done += samples_per_wave) {
+            long wave_samples = std::min(samples_per_wave, samples - samples_done);
+            wave.clear();
+            for (int p = 0; p < num_pixels; ++p) {
+                for (long s = 0; s < wave_samples; ++s) {
+                    wave.push_back(PathState{get_ray_sample(col_min + p % tile_width, row_min + p / tile_width), Color{1, 1, 1}, p, 0});
+                }
+            }
+
+            while (!wave.empty()) {
+                sort_by_direction(wave, sorted_wave);
+                std::swap(wave, sorted_wave);
+
+                hits.resize(wave.size());
+                for (std::size_t k = 0; k < wave.size(); ++k) {
+                    if (wave[k].depth == 0) {
+                        RenderStats::count_camera_ray();
+                    }
+                    else {
+                        RenderStats::count_bounce_ray();
+                    }
+                    hits[k] = world.hit(wave[k].ray, Interval(min_travel_distance, infinity));
+                }
+
+                //misses gather the background, hits are grouped by material
+                std::array<std::size_t, static_cast<std::size_t>(MaterialKind::count) + 1> group_start {};
+                for (std::size_t k = 0; k < wave.size(); ++k) {
+                    if (hits[k].is_hit) {
+                        ++group_start[static_cast<std::size_t>(hits[k].material_ptr->kind()) + 1];
+                    }
+                    else {
+                        RenderStats::count_path_length(wave[k].depth);
+                        sums[static_cast<std::size_t>(wave[k].pixel)] += wave[k].throughput * CameraParameters<Scene>::background;
+                    }
+                }
+                for (std::size_t kind = 1; kind < group_start.size(); ++kind) {
+                    group_start[kind] += group_start[kind - 1];
+                }
+                by_material.resize(group_start.back());
+                std::array<std::size_t, static_cast<std::size_t>(MaterialKind::count)> next_in_group {};
+                std::copy(group_start.begin(), group_start.end() - 1, next_in_group.begin());
+                for (std::size_t k = 0; k < wave.size(); ++k) {
+                    if (hits[k].is_hit) {
+                        by_material[next_in_group[static_cast<std::size_t>(hits[k].material_ptr->kind())]++] = k;
+                    }
+                }
+
+                sorted_wave.clear();    //reused for the next wave
+                for (std::size_t kind = 0; kind + 1 < group_start.size(); ++kind) {
+                    auto begin = by_material.begin() + static_cast<long>(group_start[kind]);
+                    auto end = by_material.begin() + static_cast<long>(group_start[kind + 1]);
+                    switch (static_cast<MaterialKind>(kind)) {
+                        case MaterialKind::lambertian:      shade_wave<Lambertian>(begin, end, wave, hits, sums, sorted_wave); break;
+                        case MaterialKind::metal:           shade_wave<Metal>(begin, end, wave, hits, sums, sorted_wave); break;
+                        case MaterialKind::dielectric:      shade_wave<Dielectric>(begin, end, wave, hits, sums, sorted_wave); break;
+                        case MaterialKind::diffuse_lights:  shade_wave<DiffuseLights>(begin, end, wave, hits, sums, sorted_wave); break;
+                        case MaterialKind::isotropic:       shade_wave<Isotropic>(begin, end, wave, hits, sums, sorted_wave); break;
+                        default:                            shade_wave<Material>(begin, end, wave, hits, sums, sorted_wave); break;
+                    }
+                }
+                std::swap(wave, sorted_wave);
+            }
+        }
+
+        for (int p = 0; p < num_pixels; ++p) {
+            buffer.add(row_min + p / tile_width, col_min + p % tile_width, sums[static_cast<std::size_t>(p)]);
+        }
+    }
+
+    /**
+     * @brief Sorts the paths of a wave by the octant of their ray direction, so that rays that are intersected 
+     * one after another tend to visit the same BVH nodes. 
+     * 
+     * @param wave the paths to sort
+     * @param sorted set to the sorted paths
+     */
+    static void sort_by_direction(const std::vector<PathState>& wave, std::vector<PathState>& sorted) {
+        auto octant = [](const Ray3D& ray) {
+            return (ray.direction().x() < 0 ? 1 : 0) | (ray.direction().y() < 0 ? 2 : 0) | (ray.direction().z() < 0 ? 4 : 0);
+        };
+        std::array<std::size_t, 9> octant_start {};
+        for (const auto& path : wave) {
+            ++octant_start[static_cast<std::size_t>(octant(path.ray)) + 1];
+        }
+        for (std::size_t i = 1; i < octant_start.size(); ++i) {
+            octant_start[i] += octant_start[i - 1];
+        }
+        sorted.resize(wave.size());
+        for (const auto& path : wave) {
+            sorted[octant_start[static_cast<std::size_t>(octant(path.ray))]++] = path;
+        }
+    }
+
+    /**
+     * @brief Shades the hits of a wave on materials of one concrete type, adding the emitted light to the pixel sums
+     * and the scattered paths to the next wave. MaterialType is final, so its functions are called without virtual dispatch.
+     * 
+     * @tparam MaterialType the concrete type of the materials that were hit, or Material if unknown
+     * @tparam IndexIterator an iterator over indices into wave
+     * @param begin the first index of a path to shade
+     * @param end one past the last index of a path to shade
+     * @param wave the paths of the wave
+     * @param hits the hit of each path of the wave
+     * @param sums the sum of the samples of every pixel of the tile
+     * @param next_wave the paths that continue after scattering
+     */
+    template <typename MaterialType, typename IndexIterator>
+    void shade_wave(IndexIterator begin, IndexIterator end, 
+                    const std::vector<PathState>& wave, const std::vector<HitRecord>& hits, 
+                    std::vector<ColorSum>& sums, std::vector<PathState>& next_wave) const 
+    {
+        for (auto it = begin; it != end; ++it) {
+            const PathState& path = wave[*it];
+            const HitRecord& hit_record = hits[*it];
+            const auto& material = static_cast<const MaterialType&>(*hit_record.material_ptr);
+            ScatterRecord scatter_record = Material::to_scatter_record(path.ray, hit_record, material.sample(path.ray, hit_record));
+            ColorSum& sum = sums[static_cast<std::size_t>(path.pixel)];
+            sum += path.throughput * material.emitted(hit_record.u, hit_record.v, hit_record.point);
+            if (!scatter_record.success) {
+                RenderStats::count_path_length(path.depth);
+                continue;
+            }
+
+            Color throughput = path.throughput * scatter_record.attenuation;
+            if (path.depth + 1 >= CameraParameters<Scene>::max_depth) {
+                RenderStats::count_path_length(path.depth + 1);
+                sum += throughput * CameraParameters<Scene>::background;
+                continue;
+            }
+            next_wave.push_back(PathState{scatter_record.ray_out, throughput, path.pixel, path.depth + 1});
+        }
+    }
+
+    /**
+     * @brief Returns the sum of some number of color samples of a pixel.
+     * 
+     * @param i the horizontal index of the pixel
+     * @param j the vertical index of the pixel
+     * @param world the world that the camera will render.
+     * @param samples the number of samples to take
+     * @return ColorSum the sum of the samples
+     */
+    ColorSum sample_pixel(int i, int j, const Hittable& world, long samples) const {
+        ColorSum sum_color_samples {0, 0, 0};    
+        for (long s = 0; s < samples; ++s) {
+            Color color_sample = ray_color(get_ray_sample(i, j), world);
+            sum_color_samples += color_sample;
+        }
+        return sum_color_samples;
+    }
+
+    /**
+     * @brief Processes a window of the image in bands of one row of tiles, from the top, on multiple threads,
+     * and calls band_function on every band in order as soon as it and all the bands above it are done.
+     * At most max_bands_in_flight bands are processed at once: a band that finishes before those above it 
+     * waits for them, and no new band is started until the oldest one has been passed to band_function.
+     * 
+     * @tparam TileFunction callable with the signature void(int row_min, int row_max, int col_min, int col_max)
+     * @tparam BandFunction callable with the signature void(int row_min, int row_max)
+     * @param window the pixels processed, which must start on the tile grid.
+     * @param tile_function the work done for each tile of pixels.
+     * @param band_function the work done for each finished band, on this thread.
+     */
+    template <typename TileFunction, typename BandFunction>
+    void parallel_render_bands(const PixelWindow& window, const TileFunction& tile_function, const BandFunction& band_function) const {
+        constexpr int band_height = AccumulationBuffer::tile_size;
+        constexpr std::size_t max_bands_in_flight = 4;  //enough tiles to keep the threads busy while the oldest band finishes
+        std::deque<std::pair<int, std::future<void>>> bands;
+        auto finish_oldest_band = [&] {
+            auto& [row_min, band] = bands.front();
+            band.get();
+            band_function(row_min, std::min(row_min + band_height, window.row_max));
+            bands.pop_front();
+        };
+        for (int row_min = window.row_min; row_min < window.row_max; row_min += band_height) {
+            int row_max = std::min(row_min + band_height, window.row_max);
+            bands.emplace_back(row_min, std::async(std::launch::async, [this, row_min, row_max, &window, &tile_function] {
+                parallel_render_tile(row_min, row_max, window.col_min, window.col_max, tile_function);
+            }));
+            if (bands.size() == max_bands_in_flight) {
+                finish_oldest_band();
+            }
+        }
+        while (!bands.empty()) {
+            finish_oldest_band();
+        }
+    }
+
+    /**
+     * @brief Divide-and-conquer to process a rectangle of pixels on multiple threads. 
+     * Cuts fall on the tile grid of AccumulationBuffer, so that every tile of pixels, and the cache lines and pages
+     * that store it, are written by a single thread.
+     * 
+     * @tparam TileFunction callable with the signature void(int row_min, int row_max, int col_min, int col_max)
+     * @param row_min the minimum vertical index of the pixel range. inclusive.
+     * @param row_max the maximum vertical index of the pixel range. exclusive.
+     * @param col_min the minimum horizontal index of the pixel range. inclusive.
+     * @param col_max the maximum horizontal index of the pixel range. exclusive.
+     * @param tile_function the work done for each small rectangle (tile) of pixels.
+     */
+    template <typename TileFunction>
     void parallel_render_tile(  int row_min, int row_max, int col_min, int col_max, 
-                                const Hittable& world, 
-                                ImageData<CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height>& image_data) const
+                                const TileFunction& tile_function) const
     {   
-        //if the number of pixels is small enough, render them all on this thread
-        constexpr int max_pixels_per_thread = 100;  //rougly 10x10 pixel grid
-        if ((row_max - row_min) * (col_max - col_min) <= max_pixels_per_thread) {
-            render_tile(row_min, row_max, col_min, col_max, world, image_data);
+        //if the pixels are a single tile, process them all on this thread
+        constexpr int tile_size = AccumulationBuffer::tile_size;
+        if (row_max - row_min <= tile_size && col_max - col_min <= tile_size) {
+            Trace::TileSpan span {row_min, row_max, col_min, col_max};
+            tile_function(row_min, row_max, col_min, col_max);
         }
-        //divide the region into two, rendering one with std::async and the other on this thread.
+        //divide the region into two, processing one with std::async and the other on this thread.
         else {
             int horizontal_pixels = row_max - row_min;
             int vertical_pixels = col_max - col_min;
             if (horizontal_pixels >= vertical_pixels) {
                 //horizontal cut
-                int row_mid = row_min + (row_max - row_min)/2;
-                std::future<void> left_half = std::async(&Camera::parallel_render_tile, this, 
+                int row_mid = row_min + (row_max - row_min + tile_size - 1)/tile_size/2*tile_size;
+                std::future<void> left_half = std::async(&Camera::parallel_render_tile<TileFunction>, this, 
                                                         row_min, row_mid, col_min, col_max, 
-                                                        std::ref(world), std::ref(image_data));
-                parallel_render_tile(row_mid, row_max, col_min, col_max, world, image_data);
+                                                        std::cref(tile_function));
+                parallel_render_tile(row_mid, row_max, col_min, col_max, tile_function);
                 left_half.get();
             }
             else {
                 //vertical cut
-                int col_mid = col_min + (col_max - col_min)/2;
-                std::future<void> top_half = std::async(&Camera::parallel_render_tile, this, 
+                int col_mid = col_min + (col_max - col_min + tile_size - 1)/tile_size/2*tile_size;
+                std::future<void> top_half = std::async(&Camera::parallel_render_tile<TileFunction>, this, 
                                                         row_min, row_max, col_min, col_mid, 
-                                                        std::ref(world), std::ref(image_data));
-                parallel_render_tile(row_min, row_max, col_mid, col_max, world, image_data);
+                                                        std::cref(tile_function));
+                parallel_render_tile(row_min, row_max, col_mid, col_max, tile_function);
                 top_half.get();
             }
         }
@@ -170,30 +1363,11 @@ private:
     Vector3D defocus_disk_sample() const {
         //returns random point in the defocus disk
         Vector3D random_unit_disk_point = Vector3D::random_in_unit_disk();
-        return  CameraParameters<Scene>::camera_center + 
+        return  center + 
                 (defocus_disk_u * random_unit_disk_point.x()) + 
                 (defocus_disk_v * random_unit_disk_point.y());
     }
 
-    /**
-     * @brief Get a random ray that travels from some point on the lens to some point on the pixel.
-     * 
-     * @param i the horizontal index of the pixel
-     * @param j the vertical index of the pixel
-     * @return Ray3D the ranodm ray
-     */
-    Ray3D get_ray_sample(int i, int j) const {
-        Vector3D pixel_center = pixel00_loc + i*pixel_delta_u + j*pixel_delta_v;
-        Vector3D random_point_in_pixel = get_random_point_in_pixel(pixel_center);           //antialiasing
-        Vector3D ray_origin = (CameraParameters<Scene>::defocus_angle > 0)                  //defocus if applicable
-                                ? defocus_disk_sample() 
-                                : CameraParameters<Scene>::camera_center;  
-        constexpr float_type start_time = 0;
-        constexpr float_type end_time = 1;
-        float_type ray_time = Random::random_float(start_time, end_time);
-        return Ray3D{ray_origin, random_point_in_pixel - ray_origin, ray_time};
-    }
-
     /**
      * @brief Traces a ray of light from the camera through the world to get the resulting color.
      * 
@@ -205,15 +1379,39 @@ private:
     Color ray_color(const Ray3D& pixel_ray, const Hittable& world, int depth = 0) const {
         //if we've exceeded the ray reflection limit, no more light is gathered
         if (depth >= CameraParameters<Scene>::max_depth) {
+            RenderStats::count_path_length(depth);
             return CameraParameters<Scene>::background;
         }
 
-        constexpr float_type min_travel_distance = 0.001;  //avoid shadow acne
+        if (depth == 0) {
+            RenderStats::count_camera_ray();
+        }
+        else {
+            RenderStats::count_bounce_ray();
+        }
+
         HitRecord hit_record = world.hit(pixel_ray, Interval(min_travel_distance, infinity));
+        return shade(pixel_ray, hit_record, world, depth);
+    }
+
+    /**
+     * @brief Returns the light gathered by a ray of light from where it hit the world, 
+     * tracing the rest of its path through the world.
+     * 
+     * @param pixel_ray The light ray.
+     * @param hit_record The closest collision of the ray with the world.
+     * @param world The world that the camer is observing
+     * @param depth The number of object interactions that the ray has already undergone.
+     * @return Color: the resulting color captured by the light ray.
+     */
+    Color shade(const Ray3D& pixel_ray, const HitRecord& hit_record, const Hittable& world, int depth) const {
         if (hit_record.is_hit) { 
             ScatterRecord scatter_record = hit_record.material_ptr->scatter(pixel_ray, hit_record);  
             Color emitted_color = hit_record.material_ptr->emitted(hit_record.u, hit_record.v, hit_record.point); 
             //failed scatter means purely emission    
+            if (!scatter_record.success) {
+                RenderStats::count_path_length(depth);
+            }
             Color scattered_color = (scatter_record.success) 
                                   ? scatter_record.attenuation * ray_color(scatter_record.ray_out, world, depth+1)  
                                   : Color {0, 0, 0};                             
@@ -221,6 +1419,7 @@ private:
         }
 
         //failed to hit anything
+        RenderStats::count_path_length(depth);
         return CameraParameters<Scene>::background;
     }
 };
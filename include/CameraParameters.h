@@ -39,5 +39,27 @@ struct CameraParameters {
     constexpr static Color background{0.70, 0.80, 1.00};
 };
 
+/**
+ * @brief Where a camera is, where it points and how wide it sees, which a render may change at runtime.
+ * The image size, lens and up direction of a scene stay those of its CameraParameters.
+ * 
+ */
+struct CameraPose {
+    Vector3D center {};         //the center of the camera
+    Vector3D target {};         //where the camera is pointing
+    float_type vfov = 0;        //degrees
+
+    /**
+     * @brief Returns the pose that the CameraParameters of a scene define.
+     * 
+     * @tparam Scene the scene tag
+     * @return CameraPose the pose of the scene
+     */
+    template <typename Scene>
+    static CameraPose of() {
+        return CameraPose{CameraParameters<Scene>::camera_center, CameraParameters<Scene>::camera_target, CameraParameters<Scene>::vfov};
+    }
+};
+
 
 #endif
\ No newline at end of file
@@ -53,11 +53,10 @@ public:
     template <unsigned long WIDTH, unsigned long HEIGHT>
     void write_pixel(int row, int col, ImageData<WIDTH, HEIGHT>& image_data) const { 
         Color gamma = get_gamma();
-        std::string r = std::to_string(static_cast<int>(gamma.x() * (ColorConstants::max_pixel_val+.999)));
-        std::string g = std::to_string(static_cast<int>(gamma.y() * (ColorConstants::max_pixel_val+.999)));
-        std::string b = std::to_string(static_cast<int>(gamma.z() * (ColorConstants::max_pixel_val+.999)));
-        std::string pixel_data = r + ' ' + g + ' ' + b + '\n';
-        image_data.write_pixel(row, col, pixel_data);
+        int components[ColorConstants::num_components] = {static_cast<int>(gamma.x() * (ColorConstants::max_pixel_val+.999)),
+                                                          static_cast<int>(gamma.y() * (ColorConstants::max_pixel_val+.999)),
+                                                          static_cast<int>(gamma.z() * (ColorConstants::max_pixel_val+.999))};
+        image_data.write_pixel(row, col, components);
     }
 
 private:
@@ -88,7 +87,7 @@ public:
      * @param number_of_samples the number of samples summed in the current object.
      * @return Color: the average Color of the samples.
      */
-    Color scale(int number_of_samples) const {
+    Color scale(long number_of_samples) const {
         float_type scale = 1.0/number_of_samples;
         return scale * Color{x(), y(), z()};
     }
@@ -99,6 +98,13 @@ public:
         m_vec[2] += color.z();
         return *this;
     }
+
+    ColorSum operator+=(const ColorSum& other) {
+        m_vec[0] += other.x();
+        m_vec[1] += other.y();
+        m_vec[2] += other.z();
+        return *this;
+    }
 };
 
 #endif
\ No newline at end of file
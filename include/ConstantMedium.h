@@ -8,6 +8,7 @@
 #include "Material.h"
 #include "Texture.h"
 #include "Interval.h"
+#include "RenderStats.h"
 
 /**
  * @brief Represents a convex volume that has constant density.
@@ -50,6 +51,7 @@ public:
      * @return HitRecord The resulting collision data.
      */
     HitRecord hit(const Ray3D& ray, const Interval& t_interval) const override {
+        RenderStats::count_primitive_test(RenderStats::Primitive::constant_medium);
         //find first point that the ray collides with the boundary of the medium
         HitRecord entry_hit = boundary->hit(ray, Interval::universe);
         //early return if no hit at all
@@ -79,13 +81,14 @@ public:
 
         auto ray_length = ray.direction().length();
         auto distance_inside_boundary = (exit_hit.t - entry_hit.t) * ray_length;
-        auto hit_distance = neg_inv_density * log(Random::random_float(0, 1));  //solution to diff eq lets us randomly generate travel distance like this
+        auto hit_distance = neg_inv_density * std::log(Random::random_float(0, 1));  //solution to diff eq lets us randomly generate travel distance like this
         //check if ray goes through medium without hit
         if (hit_distance > distance_inside_boundary) {
             return HitRecord{false};
         }
 
-        //hit was successful
+        //hit was successful: the ray scatters inside of the medium
+        RenderStats::count_medium_scatter();
         constexpr bool success = true;
         HitRecord hit_record {success};
         hit_record.t = entry_hit.t + hit_distance / ray_length;
@@ -93,6 +96,7 @@ public:
         hit_record.unit_normal = Vector3D{1, 0, 0}; //arbitrary
         hit_record.front_face = true;               //arbitrary
         hit_record.material_ptr = phase_function;
+        hit_record.primitive_id = id;
         //note: we do not generate texture u, v coordinates
         return hit_record;
     }
@@ -110,6 +114,7 @@ private:
     std::shared_ptr<Hittable> boundary;
     float_type neg_inv_density;
     std::shared_ptr<Material> phase_function;
+    int id {next_primitive_id()};   //the volume is a primitive of its own, apart from its boundary
 };
 
 #endif
\ No newline at end of file
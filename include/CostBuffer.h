@@ -0,0 +1,172 @@
+#ifndef COSTBUFFER_H
+#define COSTBUFFER_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "Constants.h"
+#include "Color.h"
+#include "RenderStats.h"
+#include "TimeFunction.h"
+
+/**
+ * @brief The measures of how expensive a pixel was to render, that can be displayed as heatmaps.
+ *
+ */
+enum class CostMetric { bvh_nodes, primitive_tests, path_depth, time, count };
+
+/**
+ * @brief The work done by the calling thread while rendering some pixel.
+ * BVH node, primitive and ray counts come from the RenderStats counters, so they are only measured in a
+ * RAYTRACER_STATS build. Time is the CPU time of the thread, and is always measured.
+ *
+ */
+struct PixelCost {
+    std::uint64_t bvh_nodes = 0;
+    std::uint64_t primitive_tests = 0;
+    std::uint64_t camera_rays = 0;
+    std::uint64_t bounce_rays = 0;
+    std::uint64_t time_ns = 0;
+
+    /**
+     * @brief Returns the running totals of the counters of the calling thread.
+     * The difference of two snapshots is the work done between them.
+     *
+     * @return PixelCost the running totals (time is left at 0)
+     */
+    static PixelCost snapshot() {
+        PixelCost cost {};
+        if constexpr (RenderStats::enabled) {
+            const RenderStats::Counters& counters = RenderStats::local();
+            cost.bvh_nodes = counters.bvh_nodes_visited;
+            cost.primitive_tests = counters.total_primitive_tests();
+            cost.camera_rays = counters.camera_rays;
+            cost.bounce_rays = counters.bounce_rays;
+        }
+        return cost;
+    }
+
+    /**
+     * @brief Returns the work done between an earlier snapshot and a later one.
+     *
+     * @param before the earlier snapshot
+     * @param after the later snapshot
+     * @param elapsed_ns the time between the snapshots
+     * @return PixelCost the work done
+     */
+    static PixelCost between(const PixelCost& before, const PixelCost& after, long long elapsed_ns) {
+        return PixelCost{after.bvh_nodes - before.bvh_nodes,
+                         after.primitive_tests - before.primitive_tests,
+                         after.camera_rays - before.camera_rays,
+                         after.bounce_rays - before.bounce_rays,
+                         static_cast<std::uint64_t>(elapsed_ns)};
+    }
+};
+
+/**
+ * @brief Stores the cost of rendering each pixel of an image, accumulated over all of its samples,
+ * and maps it to false colors for heatmap images.
+ *
+ */
+class CostBuffer {
+public:
+    constexpr static int num_metrics = static_cast<int>(CostMetric::count);
+    constexpr static const char* metric_names[num_metrics] = {"bvh_nodes", "primitive_tests", "path_depth", "time"};
+
+    /**
+     * @brief Construct a new Cost Buffer object where every pixel has cost nothing.
+     *
+     * @param width the width of the image in pixels
+     * @param height the height of the image in pixels
+     */
+    CostBuffer(int width, int height) :
+        m_width{width},
+        m_costs(static_cast<unsigned long>(width) * static_cast<unsigned long>(height))
+    {}
+
+    /**
+     * @brief Adds the cost of rendering some samples of the pixel at row row and column col.
+     * Pixels are owned by exactly one tile, so this is safe to call concurrently for different pixels.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @param cost the cost of the samples
+     */
+    void add(int row, int col, const PixelCost& cost) {
+        PixelCost& total = m_costs[index(row, col)];
+        total.bvh_nodes += cost.bvh_nodes;
+        total.primitive_tests += cost.primitive_tests;
+        total.camera_rays += cost.camera_rays;
+        total.bounce_rays += cost.bounce_rays;
+        total.time_ns += cost.time_ns;
+    }
+
+    /**
+     * @brief Returns the value of a metric for the pixel at row row and column col.
+     * Path depth is the average number of bounces per camera ray, every other metric is the total over all samples.
+     *
+     * @param metric the cost metric
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return double the value of the metric
+     */
+    double value(CostMetric metric, int row, int col) const {
+        const PixelCost& cost = m_costs[index(row, col)];
+        switch (metric) {
+            case CostMetric::bvh_nodes:         return static_cast<double>(cost.bvh_nodes);
+            case CostMetric::primitive_tests:   return static_cast<double>(cost.primitive_tests);
+            case CostMetric::path_depth:        return cost.camera_rays ? static_cast<double>(cost.bounce_rays) / static_cast<double>(cost.camera_rays) : 0;
+            default:                            return static_cast<double>(cost.time_ns);
+        }
+    }
+
+    /**
+     * @brief Returns the largest value of a metric over all pixels.
+     *
+     * @param metric the cost metric
+     * @return double the maximum value
+     */
+    double max_value(CostMetric metric) const {
+        double max = 0;
+        int height = static_cast<int>(m_costs.size()) / m_width;
+        for (int j = 0; j < height; ++j) {
+            for (int i = 0; i < m_width; ++i) {
+                max = std::max(max, value(metric, j, i));
+            }
+        }
+        return max;
+    }
+
+    /**
+     * @brief Maps a metric value to a false color, on a logarithmic scale from black (no cost)
+     * through purple and orange to pale yellow (max_value).
+     * The Color is linear, so that it is displayed with the intended brightness once gamma corrected.
+     *
+     * @param value the metric value of a pixel
+     * @param max_value the maximum metric value over all pixels
+     * @return Color the false color of the pixel
+     */
+    static Color false_color(double value, double max_value) {
+        constexpr std::array<Color, 5> gradient {Color{0, 0, 0}, Color{.25, .05, .45}, Color{.75, .15, .40},
+                                                 Color{.98, .55, .10}, Color{.99, .98, .65}};
+        double t = (max_value > 0) ? std::log1p(value) / std::log1p(max_value) : 0;
+        double position = std::clamp(t, 0.0, 1.0) * (gradient.size() - 1);
+        auto lower = std::min(static_cast<std::size_t>(position), gradient.size() - 2);
+        auto fraction = static_cast<float_type>(position - static_cast<double>(lower));
+        Color display = gradient[lower] * (1 - fraction) + gradient[lower + 1] * fraction;
+        return display * display;   //undo the gamma correction of Color::write_pixel
+    }
+
+private:
+    int m_width;
+    std::vector<PixelCost> m_costs;
+
+    unsigned long index(int row, int col) const {
+        return static_cast<unsigned long>(row) * static_cast<unsigned long>(m_width) + static_cast<unsigned long>(col);
+    }
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "Constants.h"
+#include "Color.h"
+#include "Vector3D.h"
+#include "AccumulationBuffer.h"
+#include "FeatureBuffer.h"
+#include "Parallel.h"
+
+// This header-only Denoiser namespace filters the noise out of a render with the edge-avoiding a-trous wavelet
+// transform (Dammertz et al. 2010): a 5x5 B3 spline kernel applied with holes of 1, 2, 4, ... pixels, so that a few
+// iterations cover a wide footprint. Every tap is weighted down where its color, albedo or normal differs from those
+// of the pixel being filtered, so edges and texture survive. The colors are divided by the first-hit albedo before
+// filtering and multiplied back after, so only the lighting is blurred, not the textures it lights.
+namespace Denoiser
+{
+	struct Settings
+	{
+		int iterations = 5;					// the footprint is 4 * 2^iterations - 3 pixels wide
+		float_type sigma_color = 4;			// relative to the brightness of the brighter pixel. halves every iteration
+		float_type sigma_albedo = .1;
+		int normal_power = 16;				// the weight of a tap is the cosine between the normals to this power
+	};
+
+	// Components of the albedo below this keep their color as it is, instead of dividing by nearly 0
+	inline constexpr float_type min_albedo = .01;
+
+	// Keeps the relative color differences of black pixels finite
+	inline constexpr float_type min_brightness = .01;
+
+	// base^exponent by squaring, much cheaper than std::pow for the small exponents of the normal weight
+	inline float_type power(float_type base, int exponent)
+	{
+		float_type result = 1;
+		for (; exponent > 0; exponent >>= 1, base *= base)
+		{
+			if (exponent & 1)
+				result *= base;
+		}
+		return result;
+	}
+
+	inline float_type luminance(const Color& color)
+	{
+		return .2126f * color.x() + .7152f * color.y() + .0722f * color.z();
+	}
+
+	// Returns the denoised image, with the same samples per pixel as image
+	inline AccumulationBuffer denoise(const AccumulationBuffer& image, const FeatureBuffer& features, const Settings& settings = {})
+	{
+		const int width = image.width();
+		const int height = image.height();
+		const auto pixel_count = static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+		auto index = [width](int row, int col) { return static_cast<std::size_t>(row) * static_cast<std::size_t>(width) + static_cast<std::size_t>(col); };
+
+		std::vector<Color> albedo(pixel_count), modulation(pixel_count);
+		std::vector<Vector3D> normal(pixel_count);
+		std::vector<Color> current(pixel_count), next(pixel_count);
+		Parallel::rows(height, [&](int row_min, int row_max) {
+			for (int j = row_min; j < row_max; ++j)
+			{
+				for (int i = 0; i < width; ++i)
+				{
+					std::size_t p = index(j, i);
+					albedo[p] = features.albedo(j, i);
+					normal[p] = features.normal(j, i);
+					for (std::size_t c = 0; c < 3; ++c)
+						modulation[p][c] = albedo[p][c] < min_albedo ? 1 : albedo[p][c];
+					Color color = image.average(j, i);
+					current[p] = Color{color.x() / modulation[p].x(), color.y() / modulation[p].y(), color.z() / modulation[p].z()};
+				}
+			}
+		});
+
+		constexpr float_type kernel[3] = {3.0 / 8, 1.0 / 4, 1.0 / 16};	// B3 spline, by distance from the center
+		float_type sigma_color = settings.sigma_color;
+		for (int iteration = 0; iteration < settings.iterations; ++iteration)
+		{
+			const int step = 1 << iteration;
+			const float_type inverse_color_variance = 1 / (sigma_color * sigma_color);
+			const float_type inverse_albedo_variance = 1 / (settings.sigma_albedo * settings.sigma_albedo);
+			Parallel::rows(height, [&](int row_min, int row_max) {
+				for (int j = row_min; j < row_max; ++j)
+				{
+					for (int i = 0; i < width; ++i)
+					{
+						std::size_t p = index(j, i);
+						const Color& color_p = current[p];
+						const Vector3D& normal_p = normal[p];
+						bool has_normal_p = !normal_p.near_zero();
+						float_type brightness_p = luminance(color_p);
+
+						Color sum {0, 0, 0};
+						float_type weight_sum = 0;
+						for (int dy = -2; dy <= 2; ++dy)
+						{
+							int row = j + dy * step;
+							if (row < 0 || row >= height)
+								continue;
+							for (int dx = -2; dx <= 2; ++dx)
+							{
+								int col = i + dx * step;
+								if (col < 0 || col >= width)
+									continue;
+								std::size_t q = index(row, col);
+								float_type weight = kernel[std::abs(dx)] * kernel[std::abs(dy)];
+								// relative to the brighter of the two, so that fireflies spread their energy instead of losing it
+								float_type brightness = std::max(brightness_p, luminance(current[q]));
+								float_type color_scale = inverse_color_variance / (brightness * brightness + min_brightness);
+								weight *= std::exp(-(color_p - current[q]).length_squared() * color_scale
+												   - (albedo[p] - albedo[q]).length_squared() * inverse_albedo_variance);
+								const Vector3D& normal_q = normal[q];
+								if (has_normal_p || !normal_q.near_zero())
+									weight *= power(std::max(float_type{0}, normal_p.dot(normal_q)), settings.normal_power);
+								sum += weight * current[q];
+								weight_sum += weight;
+							}
+						}
+						next[p] = sum / weight_sum;		// the center tap always has weight
+					}
+				}
+			});
+			std::swap(current, next);
+			sigma_color /= 2;
+		}
+
+		AccumulationBuffer denoised {width, height};
+		const auto samples = static_cast<float_type>(image.samples_per_pixel());
+		for (int j = 0; j < height; ++j)
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				std::size_t p = index(j, i);
+				Color color = current[p] * modulation[p];
+				denoised.add(j, i, ColorSum{color.x() * samples, color.y() * samples, color.z() * samples});
+			}
+		}
+		denoised.add_samples(image.samples_per_pixel());
+		return denoised;
+	}
+};
+
+#endif
@@ -0,0 +1,558 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "Constants.h"
+
+extern char** environ;
+
+// This header-only Distributed namespace spreads the tiles of a frame over worker processes, on this machine or
+// others, without a scheduler service. A Coordinator listens on a Unix domain socket (unix:<path>) or a TCP port
+// (<host>:<port>), starts any local workers itself, and hands every worker a few tile jobs at a time. Workers
+// build the same world from the seed that the coordinator sends them, render each tile with the seed it has in
+// a local render, and send back its sums of color samples, so the merged frame is the same as a local one.
+// The tiles of a worker whose connection is lost, that stalls in the middle of a message or that takes far longer
+// to return a tile than the slowest tile returned so far are handed to the others. TCP connections to workers are
+// kept alive, so that a worker host that disappears without closing them is noticed too.
+// Messages are sent in the byte order of the coordinator, so every worker must share its architecture.
+namespace Distributed
+{
+	struct Settings
+	{
+		int local_workers = 0;			// worker processes started on this machine
+		std::string address {};			// unix:<path> or <host>:<port> that the coordinator listens on. empty disables
+		bool external = false;			// whether workers started elsewhere are expected to connect to address
+		std::string program {};			// the executable that local workers are started from
+		std::string output_stem {};		// the output filename that local workers are started with
+		double job_timeout_seconds = 60;	// the least time a worker is given to return a tile before it is dropped
+
+		bool coordinating() const { return !address.empty(); }
+	};
+
+	enum class MessageType : std::uint32_t { hello = 1, ready = 2, job = 3, result = 4, shutdown = 5 };
+
+	// Sent to every worker as soon as it connects: what it needs to build the same world and camera
+	struct Hello
+	{
+		char magic[8] = {'R', 'T', 'D', 'I', 'S', 'T', '1', '\0'};
+		std::uint64_t seed = 0;
+		std::int32_t width = 0;
+		std::int32_t height = 0;
+		std::uint32_t float_size = sizeof(float_type);
+		std::uint32_t packets = 0;
+		std::uint32_t wavefront = 0;
+	};
+
+	// The samples of one pass over one tile. A result is the job followed by the sums of its pixels in raster order
+	struct TileJob
+	{
+		std::int32_t row_min = 0;
+		std::int32_t row_max = 0;
+		std::int32_t col_min = 0;
+		std::int32_t col_max = 0;
+		std::int64_t samples = 0;
+		std::uint64_t pass_seed = 0;
+
+		double pixel_samples() const { return static_cast<double>(row_max - row_min) * static_cast<double>(col_max - col_min) * static_cast<double>(samples); }
+		std::size_t sum_count() const { return 3 * static_cast<std::size_t>(row_max - row_min) * static_cast<std::size_t>(col_max - col_min); }
+	};
+
+	struct MessageHeader
+	{
+		MessageType type;
+		std::uint32_t size;
+	};
+
+	// A socket that is closed when it is destroyed
+	class Socket
+	{
+	public:
+		explicit Socket(int fd = -1) : m_fd{fd} {}
+		Socket(Socket&& other) noexcept : m_fd{other.m_fd} { other.m_fd = -1; }
+		Socket& operator=(Socket&& other) noexcept
+		{
+			std::swap(m_fd, other.m_fd);
+			return *this;
+		}
+		Socket(const Socket&) = delete;
+		Socket& operator=(const Socket&) = delete;
+		~Socket()
+		{
+			if (m_fd != -1)
+				close(m_fd);
+		}
+
+		int fd() const { return m_fd; }
+
+	private:
+		int m_fd;
+	};
+
+	// The path of a unix:<path> address, or an empty string for a TCP address
+	inline std::string unix_path(const std::string& address)
+	{
+		const std::string prefix = "unix:";
+		return address.compare(0, prefix.size(), prefix) == 0 ? address.substr(prefix.size()) : std::string{};
+	}
+
+	// Calls use(fd, address, length) with a new socket for every candidate of address, until it returns true.
+	// Throws std::invalid_argument if address is malformed, and std::runtime_error if no candidate succeeds
+	template <typename UseFunction>
+	Socket open_socket(const std::string& address, bool passive, const UseFunction& use)
+	{
+		std::string path = unix_path(address);
+		if (!path.empty())
+		{
+			sockaddr_un unix_address {};
+			unix_address.sun_family = AF_UNIX;
+			if (path.size() >= sizeof(unix_address.sun_path))
+				throw std::invalid_argument("Unix socket path '" + path + "' is too long");
+			std::memcpy(unix_address.sun_path, path.c_str(), path.size() + 1);
+			Socket socket {::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+			if (socket.fd() != -1 && use(socket.fd(), reinterpret_cast<const sockaddr*>(&unix_address), sizeof(unix_address)))
+				return socket;
+			throw std::runtime_error("Error: Unable to " + std::string{passive ? "listen on " : "connect to "} + address + ": " + std::strerror(errno));
+		}
+		std::size_t colon = address.rfind(':');
+		if (colon == std::string::npos)
+			throw std::invalid_argument("Address '" + address + "' is neither unix:<path> nor <host>:<port>");
+		std::string host = address.substr(0, colon);
+		std::string port = address.substr(colon + 1);
+		addrinfo hints {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = passive ? AI_PASSIVE : 0;
+		addrinfo* candidates = nullptr;
+		if (int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &candidates); error != 0)
+			throw std::runtime_error("Error: Unable to resolve " + address + ": " + gai_strerror(error));
+		for (addrinfo* candidate = candidates; candidate != nullptr; candidate = candidate->ai_next)
+		{
+			Socket socket {::socket(candidate->ai_family, candidate->ai_socktype | SOCK_CLOEXEC, candidate->ai_protocol)};
+			if (socket.fd() != -1 && use(socket.fd(), candidate->ai_addr, candidate->ai_addrlen))
+			{
+				freeaddrinfo(candidates);
+				return socket;
+			}
+		}
+		freeaddrinfo(candidates);
+		throw std::runtime_error("Error: Unable to " + std::string{passive ? "listen on " : "connect to "} + address + ": " + std::strerror(errno));
+	}
+
+	// A socket that accepts the connections of workers. An existing Unix socket file is replaced
+	inline Socket listen_on(const std::string& address)
+	{
+		if (std::string path = unix_path(address); !path.empty())
+			unlink(path.c_str());
+		return open_socket(address, true, [](int fd, const sockaddr* socket_address, socklen_t length) {
+			int reuse = 1;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+			return bind(fd, socket_address, length) == 0 && listen(fd, SOMAXCONN) == 0;
+		});
+	}
+
+	// A socket connected to the coordinator at address
+	inline Socket connect_to(const std::string& address)
+	{
+		return open_socket(address, false, [](int fd, const sockaddr* socket_address, socklen_t length) {
+			return connect(fd, socket_address, length) == 0;
+		});
+	}
+
+	// Sends all of data, retrying partial and interrupted sends. Returns false if the peer is gone
+	inline bool send_all(int fd, const void* data, std::size_t size)
+	{
+		auto bytes = static_cast<const char*>(data);
+		while (size > 0)
+		{
+			ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+			if (sent == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			bytes += sent;
+			size -= static_cast<std::size_t>(sent);
+		}
+		return true;
+	}
+
+	// Receives exactly size bytes. Returns false if the peer is gone
+	inline bool receive_all(int fd, void* data, std::size_t size)
+	{
+		auto bytes = static_cast<char*>(data);
+		while (size > 0)
+		{
+			ssize_t received = recv(fd, bytes, size, 0);
+			if (received == -1 && errno == EINTR)
+				continue;
+			if (received <= 0)
+				return false;
+			bytes += received;
+			size -= static_cast<std::size_t>(received);
+		}
+		return true;
+	}
+
+	// Sends a message of the given parts, one after another. Returns false if the peer is gone
+	inline bool send_message(int fd, MessageType type, const void* first = nullptr, std::size_t first_size = 0,
+							 const void* second = nullptr, std::size_t second_size = 0)
+	{
+		MessageHeader header {type, static_cast<std::uint32_t>(first_size + second_size)};
+		return send_all(fd, &header, sizeof(header)) && send_all(fd, first, first_size) && send_all(fd, second, second_size);
+	}
+
+	// Receives the next message into payload. Returns false if the peer is gone or the message is larger than max_size,
+	// which is checked before the payload is allocated
+	inline bool receive_message(int fd, MessageType& type, std::vector<char>& payload, std::size_t max_size)
+	{
+		MessageHeader header {};
+		if (!receive_all(fd, &header, sizeof(header)) || header.size > max_size)
+			return false;
+		type = header.type;
+		payload.resize(header.size);
+		return receive_all(fd, payload.data(), payload.size());
+	}
+
+	// Hands out the tile jobs of every pass to the workers that connect to it, and merges their results
+	class Coordinator
+	{
+	public:
+		// Listens on the address of settings and starts its local workers.
+		// Throws std::runtime_error if the socket cannot be opened or a worker cannot be started
+		Coordinator(const Settings& settings, const Hello& hello) :
+			m_settings{settings},
+			m_hello{hello},
+			m_listener{listen_on(settings.address)}
+		{
+			for (int w = 0; w < settings.local_workers; ++w)
+				m_children.push_back(spawn_worker());
+			std::cout << "Distributed: listening on " << settings.address << " with " << settings.local_workers << " local workers" << std::endl;
+		}
+
+		Coordinator(const Coordinator&) = delete;
+		Coordinator& operator=(const Coordinator&) = delete;
+
+		// Stops every worker and waits for the local ones to exit. A local worker that was dropped because it hung
+		// is killed once the others have had message_timeout_seconds to exit
+		~Coordinator()
+		{
+			for (const Connection& worker : m_workers)
+				send_message(worker.socket.fd(), MessageType::shutdown);
+			m_workers.clear();
+			constexpr int checks_per_second = 10;
+			for (pid_t child : m_children)
+			{
+				for (int checks = 0; waitpid(child, nullptr, WNOHANG) == 0; ++checks)
+				{
+					if (checks == message_timeout_seconds * checks_per_second)
+						kill(child, SIGKILL);
+					usleep(1000000 / checks_per_second);
+				}
+			}
+			if (std::string path = unix_path(m_settings.address); !path.empty())
+				unlink(path.c_str());
+		}
+
+		// Renders every job on the workers, calling merge(job, sums) on this thread for each finished one.
+		// Once cancelled() returns true, the jobs that have not been sent are dropped, and those in flight finished.
+		// Throws std::runtime_error if every worker is lost and no other can connect
+		template <typename MergeFunction, typename CancelledFunction>
+		void render_pass(const std::vector<TileJob>& jobs, const MergeFunction& merge, const CancelledFunction& cancelled)
+		{
+			std::deque<TileJob> pending(jobs.begin(), jobs.end());
+			std::size_t finished = 0;
+			std::size_t dropped = 0;
+			std::vector<char> payload;
+			while (finished + dropped < jobs.size())
+			{
+				if (cancelled())
+				{
+					dropped += pending.size();
+					pending.clear();
+					if (finished + dropped == jobs.size())
+						break;
+				}
+				for (Connection& worker : m_workers)
+				{
+					while (worker.ready && worker.in_flight.size() < jobs_in_flight && !pending.empty())
+					{
+						if (worker.in_flight.empty())
+							worker.last_progress = Clock::now();
+						worker.in_flight.push_back(pending.front());
+						pending.pop_front();
+						send_message(worker.socket.fd(), MessageType::job, &worker.in_flight.back(), sizeof(TileJob));
+					}
+				}
+				drop_late_workers(pending);
+				wait_for_workers_or_fail();
+
+				std::vector<pollfd> fds {{m_listener.fd(), POLLIN, 0}};
+				for (const Connection& worker : m_workers)
+					fds.push_back({worker.socket.fd(), POLLIN, 0});
+				constexpr int poll_timeout_ms = 1000;	// how often lost local workers are noticed when none is connected
+				if (poll(fds.data(), fds.size(), poll_timeout_ms) <= 0)
+					continue;
+				if (fds[0].revents & POLLIN)
+					accept_worker();
+				for (std::size_t w = fds.size() - 1; w > 0; --w)
+				{
+					if (fds[w].revents == 0)
+						continue;
+					Connection& worker = m_workers[w - 1];
+					MessageType type {};
+					//a worker only ever sends an empty ready message, or the result of its oldest job
+					std::size_t max_size = worker.in_flight.empty() ? 0 : result_size(worker.in_flight.front());
+					if (!receive_message(worker.socket.fd(), type, payload, max_size) || !handle_message(worker, type, payload, merge, finished))
+					{
+						lose_worker(w - 1, pending);
+					}
+				}
+			}
+		}
+
+		// Prints how many tiles each worker rendered and how many were handed out again after a worker was lost
+		void report(std::ostream& out) const
+		{
+			out << "Distributed: " << m_workers.size() << " workers connected, " << m_lost << " lost, " << m_requeued << " tiles requeued" << std::endl;
+			for (const Connection& worker : m_workers)
+				out << "  worker " << worker.id << ": " << worker.tiles_done << " tiles" << std::endl;
+		}
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct Connection
+		{
+			Socket socket;
+			int id;
+			bool ready = false;					// whether the worker has built its world
+			std::vector<TileJob> in_flight {};
+			Clock::time_point last_progress {};	// when the oldest job in flight was started: sent to an idle worker, or the job before it returned
+			long tiles_done = 0;
+		};
+
+		// enough that a worker starts its next tile while the result of the last one is being sent and merged
+		constexpr static std::size_t jobs_in_flight = 2;
+		// a worker is dropped once its oldest tile has taken this many times as long as it would at the slowest rate seen
+		constexpr static double late_factor = 10;
+		// how long a worker may take to send the rest of a message it has started, or to accept one
+		constexpr static int message_timeout_seconds = 10;
+		// a connection that has been idle this long is probed, every interval, until count probes are unanswered
+		constexpr static int keepalive_idle_seconds = 10;
+		constexpr static int keepalive_interval_seconds = 5;
+		constexpr static int keepalive_count = 3;
+
+		Settings m_settings;
+		Hello m_hello;
+		Socket m_listener;
+		std::vector<pid_t> m_children;
+		std::vector<Connection> m_workers;
+		int m_next_id = 0;
+		long m_lost = 0;
+		long m_requeued = 0;
+		double m_slowest_seconds_per_sample = 0;	// of the tiles returned so far. 0 until one is
+
+		// Starts a worker process that connects back to the address, with its standard output discarded.
+		// It runs in a process group of its own, so that an interrupt from the terminal only cancels the coordinator,
+		// which then shuts its workers down
+		pid_t spawn_worker() const
+		{
+			std::vector<std::string> arguments {m_settings.program, m_settings.output_stem, "--worker", m_settings.address};
+			std::vector<char*> argv;
+			for (std::string& argument : arguments)
+				argv.push_back(argument.data());
+			argv.push_back(nullptr);
+			posix_spawn_file_actions_t actions;
+			posix_spawn_file_actions_init(&actions);
+			posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+			posix_spawnattr_t attributes;
+			posix_spawnattr_init(&attributes);
+			posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+			posix_spawnattr_setpgroup(&attributes, 0);
+			pid_t child = 0;
+			int error = posix_spawnp(&child, m_settings.program.c_str(), &actions, &attributes, argv.data(), environ);
+			posix_spawnattr_destroy(&attributes);
+			posix_spawn_file_actions_destroy(&actions);
+			if (error != 0)
+				throw std::runtime_error("Error: Unable to start worker " + m_settings.program + ": " + std::strerror(error));
+			return child;
+		}
+
+		// The size of the result message of job
+		static std::size_t result_size(const TileJob& job) { return sizeof(TileJob) + job.sum_count() * sizeof(float_type); }
+
+		void accept_worker()
+		{
+			Socket socket {accept4(m_listener.fd(), nullptr, nullptr, SOCK_CLOEXEC)};
+			if (socket.fd() == -1)
+				return;
+			//reads and writes that stall in the middle of a message fail, instead of freezing the render
+			timeval timeout {message_timeout_seconds, 0};
+			setsockopt(socket.fd(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			setsockopt(socket.fd(), SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+			//fail the reads of a TCP worker whose host is gone. Unix sockets have no keepalive, and ignore these
+			int keepalive = 1, idle = keepalive_idle_seconds, interval = keepalive_interval_seconds, count = keepalive_count;
+			if (setsockopt(socket.fd(), SOL_SOCKET, SO_KEEPALIVE, &keepalive, sizeof(keepalive)) == 0)
+			{
+				setsockopt(socket.fd(), IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+				setsockopt(socket.fd(), IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+				setsockopt(socket.fd(), IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+			}
+			if (!send_message(socket.fd(), MessageType::hello, &m_hello, sizeof(m_hello)))
+				return;
+			m_workers.push_back(Connection{std::move(socket), m_next_id++});
+		}
+
+		// Returns false if the message is not one that a worker sends
+		template <typename MergeFunction>
+		bool handle_message(Connection& worker, MessageType type, const std::vector<char>& payload, const MergeFunction& merge, std::size_t& finished)
+		{
+			if (type == MessageType::ready)
+			{
+				worker.ready = true;
+				return payload.empty();
+			}
+			if (type != MessageType::result || worker.in_flight.empty() || payload.size() < sizeof(TileJob))
+				return false;
+			TileJob job;
+			std::memcpy(&job, payload.data(), sizeof(job));
+			const TileJob& expected = worker.in_flight.front();
+			if (std::memcmp(&job, &expected, sizeof(job)) != 0 || payload.size() != result_size(job))
+				return false;
+			std::vector<float_type> sums(job.sum_count());
+			std::memcpy(sums.data(), payload.data() + sizeof(TileJob), sums.size() * sizeof(float_type));
+			merge(job, sums.data());
+			Clock::time_point now = Clock::now();
+			double seconds = std::chrono::duration<double>(now - worker.last_progress).count();
+			m_slowest_seconds_per_sample = std::max(m_slowest_seconds_per_sample, seconds / job.pixel_samples());
+			worker.in_flight.erase(worker.in_flight.begin());
+			worker.last_progress = now;
+			++worker.tiles_done;
+			++finished;
+			return true;
+		}
+
+		// Hands the jobs of a worker whose connection failed back to the others
+		void lose_worker(std::size_t index, std::deque<TileJob>& pending)
+		{
+			Connection& worker = m_workers[index];
+			std::cout << "Distributed: lost worker " << worker.id << ", requeuing " << worker.in_flight.size() << " tiles" << std::endl;
+			m_requeued += static_cast<long>(worker.in_flight.size());
+			pending.insert(pending.begin(), worker.in_flight.begin(), worker.in_flight.end());
+			m_workers.erase(m_workers.begin() + static_cast<std::ptrdiff_t>(index));
+			++m_lost;
+		}
+
+		// Hands the jobs of every worker that is late with its oldest job back to the others, so that a worker that hangs
+		// does not stall the render. Until a tile has been returned there is no rate to be late by, and no worker is dropped
+		void drop_late_workers(std::deque<TileJob>& pending)
+		{
+			if (m_slowest_seconds_per_sample == 0)
+				return;
+			Clock::time_point now = Clock::now();
+			for (std::size_t w = m_workers.size(); w > 0; --w)
+			{
+				const Connection& worker = m_workers[w - 1];
+				if (worker.in_flight.empty())
+					continue;
+				double timeout = std::max(m_settings.job_timeout_seconds,
+										  late_factor * m_slowest_seconds_per_sample * worker.in_flight.front().pixel_samples());
+				if (std::chrono::duration<double>(now - worker.last_progress).count() > timeout)
+					lose_worker(w - 1, pending);
+			}
+		}
+
+		// Throws if no worker is connected and none can connect anymore: every local worker has exited
+		// and no external workers are expected
+		void wait_for_workers_or_fail()
+		{
+			std::erase_if(m_children, [](pid_t child) { return waitpid(child, nullptr, WNOHANG) == child; });
+			if (m_workers.empty() && m_children.empty() && !m_settings.external)
+				throw std::runtime_error("Error: every worker has exited before the render finished");
+		}
+	};
+
+	// The end of a connection to a coordinator that renders the jobs it is sent
+	class Worker
+	{
+	public:
+		// Connects to the coordinator and receives its Hello.
+		// Throws std::runtime_error if it cannot connect, or the coordinator was built differently
+		explicit Worker(const std::string& address) : m_socket{connect_to(address)}
+		{
+			MessageType type {};
+			std::vector<char> payload;
+			if (!receive_message(m_socket.fd(), type, payload, sizeof(Hello)) || type != MessageType::hello || payload.size() != sizeof(Hello))
+				throw std::runtime_error("Error: " + address + " is not a ray tracer coordinator");
+			std::memcpy(&m_hello, payload.data(), sizeof(m_hello));
+			if (std::memcmp(m_hello.magic, Hello{}.magic, sizeof(m_hello.magic)) != 0 || m_hello.float_size != sizeof(float_type))
+				throw std::runtime_error("Error: the coordinator at " + address + " was built differently");
+		}
+
+		const Hello& hello() const { return m_hello; }
+
+		// Reports that the world is built, then calls render(job, sums) for every job it is sent and returns the sums,
+		// until the coordinator shuts it down or is gone
+		template <typename RenderFunction>
+		void serve(const RenderFunction& render)
+		{
+			if (!send_message(m_socket.fd(), MessageType::ready))
+				return;
+			MessageType type {};
+			std::vector<char> payload;
+			std::vector<float_type> sums;
+			while (receive_message(m_socket.fd(), type, payload, sizeof(TileJob)) && type == MessageType::job && payload.size() == sizeof(TileJob))
+			{
+				TileJob job;
+				std::memcpy(&job, payload.data(), sizeof(job));
+				sums.resize(job.sum_count());
+				render(job, sums.data());
+				if (!send_message(m_socket.fd(), MessageType::result, &job, sizeof(job), sums.data(), sums.size() * sizeof(float_type)))
+					return;
+			}
+		}
+
+	private:
+		Socket m_socket;
+		Hello m_hello;
+	};
+
+	// Prints the speedup and efficiency of rendering with 1 to N workers, from the seconds that each took
+	inline void report_scaling(std::ostream& out, const std::vector<double>& seconds)
+	{
+		out << "Scaling:\n  workers   seconds   speedup   efficiency\n";
+		for (std::size_t n = 0; n < seconds.size(); ++n)
+		{
+			double speedup = seconds[0] / seconds[n];
+			out << "  " << std::setw(7) << n + 1 << std::fixed << std::setprecision(3)
+				<< std::setw(10) << seconds[n] << std::setw(10) << speedup
+				<< std::setw(12) << speedup / static_cast<double>(n + 1) << '\n';
+			out << std::defaultfloat;
+		}
+		out << std::flush;
+	}
+};
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef EXRFILE_H
+#define EXRFILE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "AOVFile.h"
+#include "Parallel.h"
+
+// This header-only EXRFile namespace writes high dynamic range images as single part scanline OpenEXR files, without
+// depending on the OpenEXR library. Channels are stored as 16 bit half or 32 bit floats, uncompressed or with the
+// lossless RLE compression of OpenEXR, so emissive and over-exposed pixels keep their values above 1 and any
+// AOVFile channels can be stored alongside the beauty. Every scanline is its own chunk, and chunks are encoded
+// and compressed in parallel on every hardware thread.
+// See "The OpenEXR File Layout" (https://openexr.com/en/latest/OpenEXRFileLayout.html).
+namespace EXRFile
+{
+	// The values are those of the file format
+	enum class PixelType : std::int32_t { half = 1, single = 2 };
+	enum class Compression : std::uint8_t { none = 0, rle = 1 };
+
+	struct Settings
+	{
+		PixelType pixel_type = PixelType::half;		// channels that are AOVFile::Channel::exact are always single
+		Compression compression = Compression::rle;
+	};
+
+	// Throws std::invalid_argument for names other than half and float
+	inline PixelType parse_pixel_type(const std::string& name)
+	{
+		if (name == "half")
+			return PixelType::half;
+		if (name == "float")
+			return PixelType::single;
+		throw std::invalid_argument("Unknown EXR pixel type '" + name + "', expected half or float");
+	}
+
+	// Throws std::invalid_argument for names other than none and rle
+	inline Compression parse_compression(const std::string& name)
+	{
+		if (name == "none")
+			return Compression::none;
+		if (name == "rle")
+			return Compression::rle;
+		throw std::invalid_argument("Unknown EXR compression '" + name + "', expected none or rle");
+	}
+
+	// The bits of the nearest half precision float, rounding ties to even. Values beyond the range of halves become infinite
+	inline std::uint16_t to_half(float value)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		auto sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000);
+		std::uint32_t magnitude = bits & 0x7fffffff;
+		if (magnitude > 0x7f800000)								// NaN, kept quiet
+			return static_cast<std::uint16_t>(sign | 0x7e00);
+		if (magnitude >= 0x477ff000)							// rounds to 65520 or more
+			return static_cast<std::uint16_t>(sign | 0x7c00);
+		if (magnitude < 0x38800000)								// below 2^-14, a subnormal half: multiples of 2^-24
+		{
+			float scaled;
+			std::memcpy(&scaled, &magnitude, sizeof(scaled));
+			return static_cast<std::uint16_t>(sign | static_cast<std::uint16_t>(std::nearbyint(scaled * 16777216.0f)));
+		}
+		std::uint32_t rebiased = magnitude - 0x38000000;		// exponent bias 127 to 15
+		return static_cast<std::uint16_t>(sign | ((rebiased + 0xfff + ((rebiased >> 13) & 1)) >> 13));
+	}
+
+	// Little endian serialization of the fields of the file
+	class ByteWriter
+	{
+	public:
+		explicit ByteWriter(std::vector<char>& bytes) : m_bytes{bytes} {}
+
+		void u8(std::uint8_t value) { m_bytes.push_back(static_cast<char>(value)); }
+		void u16(std::uint16_t value) { little_endian(value, 2); }
+		void u32(std::uint32_t value) { little_endian(value, 4); }
+		void u64(std::uint64_t value) { little_endian(value, 8); }
+		void i32(std::int32_t value) { u32(static_cast<std::uint32_t>(value)); }
+
+		void f32(float value)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			u32(bits);
+		}
+
+		// null terminated
+		void string(const std::string& value)
+		{
+			m_bytes.insert(m_bytes.end(), value.begin(), value.end());
+			m_bytes.push_back('\0');
+		}
+
+		// the name, type and size of a header attribute, which its value follows
+		void attribute(const std::string& name, const std::string& type, std::int32_t size)
+		{
+			string(name);
+			string(type);
+			i32(size);
+		}
+
+	private:
+		void little_endian(std::uint64_t value, int bytes)
+		{
+			for (int b = 0; b < bytes; ++b)
+				m_bytes.push_back(static_cast<char>((value >> (8 * b)) & 0xff));
+		}
+
+		std::vector<char>& m_bytes;
+	};
+
+	// The run length encoding of OpenEXR: a count byte n >= 0 repeats the next byte n + 1 times, n < 0 copies the next -n bytes
+	inline std::vector<char> run_length_encode(const std::vector<char>& bytes)
+	{
+		constexpr std::ptrdiff_t min_run = 3;
+		constexpr std::ptrdiff_t max_run = 127;
+		std::vector<char> encoded;
+		encoded.reserve(bytes.size() + bytes.size() / max_run + 1);
+		const char* end = bytes.data() + bytes.size();
+		const char* run_start = bytes.data();
+		const char* run_end = run_start + 1;
+		while (run_start < end)
+		{
+			while (run_end < end && *run_start == *run_end && run_end - run_start - 1 < max_run)
+				++run_end;
+			if (run_end - run_start >= min_run)
+			{
+				encoded.push_back(static_cast<char>(run_end - run_start - 1));
+				encoded.push_back(*run_start);
+				run_start = run_end;
+			}
+			else
+			{
+				// copy literally up to the next run of 3 equal bytes
+				while (run_end < end && (run_end + 1 >= end || *run_end != *(run_end + 1) || run_end + 2 >= end || *(run_end + 1) != *(run_end + 2))
+					   && run_end - run_start < max_run)
+					++run_end;
+				encoded.push_back(static_cast<char>(run_start - run_end));
+				encoded.insert(encoded.end(), run_start, run_end);
+				run_start = run_end;
+			}
+			++run_end;
+		}
+		return encoded;
+	}
+
+	// RLE compression splits the bytes into the even and the odd ones, so that the high and low bytes of values
+	// are apart, and stores each byte as its difference to the previous one before run length encoding them
+	inline std::vector<char> rle_compress(const std::vector<char>& bytes)
+	{
+		std::vector<char> reordered(bytes.size());
+		std::size_t half = (bytes.size() + 1) / 2;
+		for (std::size_t b = 0; b < bytes.size(); ++b)
+			reordered[(b % 2 == 0) ? b / 2 : half + b / 2] = bytes[b];
+		for (std::size_t b = reordered.size(); b-- > 1;)
+		{
+			int delta = static_cast<unsigned char>(reordered[b]) - static_cast<unsigned char>(reordered[b - 1]) + 128;
+			reordered[b] = static_cast<char>(delta & 0xff);
+		}
+		return run_length_encode(reordered);
+	}
+
+	// Writes the channels, which are width * height values from the top row, to a temporary file which then replaces filename.
+	// Throws std::invalid_argument if a channel does not match the image, std::runtime_error if the file cannot be written.
+	inline void write(const std::string& filename, int width, int height, const std::vector<AOVFile::Channel>& channels,
+					  const Settings& settings = {})
+	{
+		const auto pixel_count = static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+		for (const AOVFile::Channel& channel : channels)
+		{
+			if (channel.data.size() != pixel_count || channel.name.empty() || channel.name.size() > 255)
+				throw std::invalid_argument("Error: EXR channel '" + channel.name + "' does not match the image");
+		}
+
+		// channels are stored sorted by name
+		std::vector<std::size_t> order(channels.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return channels[a].name < channels[b].name; });
+		auto pixel_type = [&](std::size_t c) { return channels[c].exact ? PixelType::single : settings.pixel_type; };
+
+		std::vector<char> header;
+		ByteWriter writer {header};
+		bool long_names = false;
+		std::int32_t channel_list_size = 1;
+		for (const AOVFile::Channel& channel : channels)
+		{
+			long_names = long_names || channel.name.size() > 31;
+			channel_list_size += static_cast<std::int32_t>(channel.name.size()) + 1 + 16;
+		}
+		writer.u32(20000630);										// magic number
+		writer.u32(2 | (long_names ? 0x400 : 0));					// version 2, single part scanline
+		writer.attribute("channels", "chlist", channel_list_size);
+		for (std::size_t c : order)
+		{
+			writer.string(channels[c].name);
+			writer.i32(static_cast<std::int32_t>(pixel_type(c)));
+			writer.u32(0);											// not perceptually linear, reserved
+			writer.i32(1);											// x and y sampling
+			writer.i32(1);
+		}
+		writer.u8(0);
+		writer.attribute("compression", "compression", 1);
+		writer.u8(static_cast<std::uint8_t>(settings.compression));
+		for (const char* window : {"dataWindow", "displayWindow"})
+		{
+			writer.attribute(window, "box2i", 16);
+			writer.i32(0);
+			writer.i32(0);
+			writer.i32(width - 1);
+			writer.i32(height - 1);
+		}
+		writer.attribute("lineOrder", "lineOrder", 1);
+		writer.u8(0);												// increasing y
+		writer.attribute("pixelAspectRatio", "float", 4);
+		writer.f32(1);
+		writer.attribute("screenWindowCenter", "v2f", 8);
+		writer.f32(0);
+		writer.f32(0);
+		writer.attribute("screenWindowWidth", "float", 4);
+		writer.f32(1);
+		writer.u8(0);
+
+		// every scanline is a chunk: its y, its size and its channels one after another
+		std::vector<std::vector<char>> chunks(static_cast<std::size_t>(height));
+		auto encode_rows = [&](int row_min, int row_max) {
+			std::vector<char> pixels;
+			for (int j = row_min; j < row_max; ++j)
+			{
+				pixels.clear();
+				ByteWriter pixel_writer {pixels};
+				for (std::size_t c : order)
+				{
+					const float* row = channels[c].data.data() + static_cast<std::size_t>(j) * static_cast<std::size_t>(width);
+					bool half = pixel_type(c) == PixelType::half;
+					for (int i = 0; i < width; ++i)
+					{
+						if (half)
+							pixel_writer.u16(to_half(row[i]));
+						else
+							pixel_writer.f32(row[i]);
+					}
+				}
+				std::vector<char> data;
+				if (settings.compression == Compression::rle)
+					data = rle_compress(pixels);
+				if (settings.compression == Compression::none || data.size() >= pixels.size())
+					data = pixels;											// stored as is when compression does not help
+				std::vector<char>& chunk = chunks[static_cast<std::size_t>(j)];
+				ByteWriter chunk_writer {chunk};
+				chunk_writer.i32(j);
+				chunk_writer.i32(static_cast<std::int32_t>(data.size()));
+				chunk.insert(chunk.end(), data.begin(), data.end());
+			}
+		};
+		Parallel::rows(height, encode_rows);
+
+		// the offset table points at every chunk from the start of the file
+		std::vector<char> offsets;
+		ByteWriter offset_writer {offsets};
+		std::uint64_t offset = header.size() + chunks.size() * sizeof(std::uint64_t);
+		for (const std::vector<char>& chunk : chunks)
+		{
+			offset_writer.u64(offset);
+			offset += chunk.size();
+		}
+
+		std::string temp_filename = filename + ".tmp";
+		{
+			std::ofstream out {temp_filename, std::ios::binary | std::ios::trunc};
+			if (!out)
+				throw std::runtime_error("Error: Unable to open EXR file " + temp_filename);
+			out.write(header.data(), static_cast<std::streamsize>(header.size()));
+			out.write(offsets.data(), static_cast<std::streamsize>(offsets.size()));
+			for (const std::vector<char>& chunk : chunks)
+				out.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+			if (!out)
+				throw std::runtime_error("Error: Unable to write EXR file " + temp_filename);
+		}
+		if (std::rename(temp_filename.c_str(), filename.c_str()) != 0)
+			throw std::runtime_error("Error: Unable to replace EXR file " + filename);
+	}
+};
+
+#endif
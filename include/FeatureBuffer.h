@@ -0,0 +1,274 @@
+#ifndef FEATUREBUFFER_H
+#define FEATUREBUFFER_H
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <limits>
+#include "Constants.h"
+#include "Color.h"
+#include "Vector3D.h"
+
+/**
+ * @brief The features of the first surface that a camera ray hit, or of the background if it hit nothing.
+ *
+ */
+struct FeatureSample {
+    Color albedo {};
+    Vector3D unit_normal {};                //facing the camera. 0 if nothing was hit
+    float_type depth = infinity;            //along the viewing direction of the camera
+    int material_id = -1;                   //-1 if nothing was hit
+    int primitive_id = -1;
+};
+
+/**
+ * @brief Stores the features of the first surface that the camera rays of each pixel hit: 
+ * the running sums of its albedo, normal and depth, and the ids of its material and primitive.
+ * The features guide the denoiser, telling it which neighbouring pixels show the same surface, 
+ * and are written out as arbitrary output variables (AOVs) for compositing.
+ * Features converge after a few samples, so they are only sampled until every pixel has max_samples of them.
+ *
+ */
+class FeatureBuffer {
+private:
+    int m_width;
+    int m_height;
+    long m_samples_per_pixel = 0;
+    std::vector<ColorSum> m_albedo_sums;
+    std::vector<Vector3D> m_normal_sums;
+    std::vector<float_type> m_depth_sums;       //over the samples that hit a surface
+    std::vector<std::int32_t> m_hit_counts;
+    std::vector<std::int32_t> m_material_ids;   //of the first sample that hit a surface, as ids cannot be averaged
+    std::vector<std::int32_t> m_primitive_ids;
+
+    constexpr static char features_magic[8] = {'R', 'T', 'F', 'E', 'A', 'T', '2', '\0'};
+
+public:
+    constexpr static long max_samples = 16;    //the feature samples per pixel that are taken at most
+
+    /**
+     * @brief Construct a new Feature Buffer object where no samples have been taken.
+     *
+     * @param width the width of the image in pixels
+     * @param height the height of the image in pixels
+     */
+    FeatureBuffer(int width, int height) :
+        m_width{width},
+        m_height{height},
+        m_albedo_sums(static_cast<unsigned long>(width) * static_cast<unsigned long>(height), ColorSum{0, 0, 0}),
+        m_normal_sums(static_cast<unsigned long>(width) * static_cast<unsigned long>(height), Vector3D{0, 0, 0}),
+        m_depth_sums(static_cast<unsigned long>(width) * static_cast<unsigned long>(height), 0),
+        m_hit_counts(static_cast<unsigned long>(width) * static_cast<unsigned long>(height), 0),
+        m_material_ids(static_cast<unsigned long>(width) * static_cast<unsigned long>(height), -1),
+        m_primitive_ids(static_cast<unsigned long>(width) * static_cast<unsigned long>(height), -1)
+    {}
+
+    int width() const {return m_width;}
+    int height() const {return m_height;}
+
+    /**
+     * @brief Returns the number of feature samples that have been summed into every pixel.
+     *
+     * @return long the samples per pixel
+     */
+    long samples_per_pixel() const {return m_samples_per_pixel;}
+
+    /**
+     * @brief Returns how many of samples new samples per pixel should also sample features,
+     * so that no more than max_samples are taken in total.
+     *
+     * @param samples the samples per pixel of a pass
+     * @return long the feature samples per pixel of the pass
+     */
+    long samples_wanted(long samples) const {
+        return std::clamp(max_samples - m_samples_per_pixel, 0L, samples);
+    }
+
+    /**
+     * @brief Records that every pixel has received some additional number of feature samples.
+     * Should be called once after all pixels have been updated in a pass.
+     *
+     * @param samples the number of feature samples that every pixel received during the pass.
+     */
+    void add_samples(long samples) {m_samples_per_pixel += samples;}
+
+    /**
+     * @brief Adds a sample of the features to the pixel at row row and column col.
+     * Pixels are owned by exactly one tile, so this is safe to call concurrently for different pixels.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @param sample the features of the surface that was hit
+     */
+    void add(int row, int col, const FeatureSample& sample) {
+        unsigned long p = index(row, col);
+        m_albedo_sums[p] += sample.albedo;
+        m_normal_sums[p] += sample.unit_normal;
+        if (sample.material_id < 0) {
+            return;
+        }
+        m_depth_sums[p] += sample.depth;
+        ++m_hit_counts[p];
+        if (m_material_ids[p] < 0) {
+            m_material_ids[p] = sample.material_id;
+            m_primitive_ids[p] = sample.primitive_id;
+        }
+    }
+
+    /**
+     * @brief Returns the average albedo of the pixel at row row and column col.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return Color the average albedo, or black if no samples have been taken
+     */
+    Color albedo(int row, int col) const {
+        if (m_samples_per_pixel == 0) {
+            return Color{0, 0, 0};
+        }
+        return m_albedo_sums[index(row, col)].scale(m_samples_per_pixel);
+    }
+
+    /**
+     * @brief Returns the average normal of the pixel at row row and column col, of unit length.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return Vector3D the average normal, or 0 if no samples hit a surface or their normals cancel out
+     */
+    Vector3D normal(int row, int col) const {
+        const Vector3D& sum = m_normal_sums[index(row, col)];
+        return sum.near_zero() ? Vector3D{0, 0, 0} : sum.unit_vector();
+    }
+
+    /**
+     * @brief Returns the average depth of the surfaces that the pixel at row row and column col shows.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return float_type the depth along the viewing direction, or infinity if no sample hit a surface
+     */
+    float_type depth(int row, int col) const {
+        std::int32_t hits = m_hit_counts[index(row, col)];
+        return hits == 0 ? infinity : m_depth_sums[index(row, col)] / static_cast<float_type>(hits);
+    }
+
+    /**
+     * @brief Returns the id of the material of the first surface that a sample of the pixel at row row and column col hit.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return int the Material::id, or -1 if no sample hit a surface
+     */
+    int material_id(int row, int col) const {return m_material_ids[index(row, col)];}
+
+    /**
+     * @brief Returns the id of the first primitive that a sample of the pixel at row row and column col hit.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return int the HitRecord::primitive_id, or -1 if no sample hit a surface
+     */
+    int primitive_id(int row, int col) const {return m_primitive_ids[index(row, col)];}
+
+    /**
+     * @brief Writes the buffer to a file, so that it can be resumed along with a checkpoint.
+     * The data is written to a temporary file which then replaces filename.
+     * Throws std::runtime_error if the file cannot be written.
+     *
+     * @param filename the name of the file, with path and extension.
+     */
+    void save(const std::string& filename) const {
+        std::string temp_filename = filename + ".tmp";
+        {
+            std::ofstream out {temp_filename, std::ios::binary | std::ios::trunc};
+            if (!out) {
+                throw std::runtime_error("Error: Unable to open feature file " + temp_filename);
+            }
+            auto width = static_cast<std::int32_t>(m_width);
+            auto height = static_cast<std::int32_t>(m_height);
+            auto samples = static_cast<std::int64_t>(m_samples_per_pixel);
+            out.write(features_magic, sizeof(features_magic));
+            out.write(reinterpret_cast<const char*>(&width), sizeof(width));
+            out.write(reinterpret_cast<const char*>(&height), sizeof(height));
+            out.write(reinterpret_cast<const char*>(&samples), sizeof(samples));
+            for (std::size_t p = 0; p < m_albedo_sums.size(); ++p) {
+                const ColorSum& albedo = m_albedo_sums[p];
+                const Vector3D& normal = m_normal_sums[p];
+                float components[7] = {albedo.x(), albedo.y(), albedo.z(), normal.x(), normal.y(), normal.z(), m_depth_sums[p]};
+                std::int32_t counts[3] = {m_hit_counts[p], m_material_ids[p], m_primitive_ids[p]};
+                out.write(reinterpret_cast<const char*>(components), sizeof(components));
+                out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+            }
+            if (!out) {
+                throw std::runtime_error("Error: Unable to write feature file " + temp_filename);
+            }
+        }
+        if (std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+            throw std::runtime_error("Error: Unable to replace feature file " + filename);
+        }
+    }
+
+    /**
+     * @brief Replaces the contents of the buffer with those of a file written by save.
+     * Throws std::runtime_error if the file cannot be read or was written for an image of a different size.
+     *
+     * @param filename the name of the file, with path and extension.
+     */
+    void load(const std::string& filename) {
+        std::ifstream in {filename, std::ios::binary};
+        if (!in) {
+            throw std::runtime_error("Error: Unable to open feature file " + filename);
+        }
+        char magic[sizeof(features_magic)] {};
+        std::int32_t width {}, height {};
+        std::int64_t samples {};
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(&width), sizeof(width));
+        in.read(reinterpret_cast<char*>(&height), sizeof(height));
+        in.read(reinterpret_cast<char*>(&samples), sizeof(samples));
+        if (!in || !std::equal(std::begin(magic), std::end(magic), std::begin(features_magic))) {
+            throw std::runtime_error("Error: " + filename + " is not a feature file");
+        }
+        if (width != m_width || height != m_height) {
+            throw std::runtime_error("Error: feature file " + filename + " was rendered at a different resolution");
+        }
+        for (std::size_t p = 0; p < m_albedo_sums.size(); ++p) {
+            float components[7] {};
+            std::int32_t counts[3] {};
+            in.read(reinterpret_cast<char*>(components), sizeof(components));
+            in.read(reinterpret_cast<char*>(counts), sizeof(counts));
+            m_albedo_sums[p] = ColorSum{components[0], components[1], components[2]};
+            m_normal_sums[p] = Vector3D{components[3], components[4], components[5]};
+            m_depth_sums[p] = components[6];
+            m_hit_counts[p] = counts[0];
+            m_material_ids[p] = counts[1];
+            m_primitive_ids[p] = counts[2];
+        }
+        if (!in) {
+            throw std::runtime_error("Error: feature file " + filename + " is truncated");
+        }
+        m_samples_per_pixel = samples;
+    }
+
+    /**
+     * @brief Returns the name of the feature file that is saved alongside a checkpoint.
+     *
+     * @param checkpoint_filename the name of the checkpoint file
+     * @return std::string the name of the feature file
+     */
+    static std::string filename_for(const std::string& checkpoint_filename) {
+        return checkpoint_filename + ".features";
+    }
+
+private:
+    unsigned long index(int row, int col) const {
+        return static_cast<unsigned long>(row) * static_cast<unsigned long>(m_width) + static_cast<unsigned long>(col);
+    }
+};
+
+#endif
@@ -1,12 +1,15 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include <array>
 #include <memory>
+#include <atomic>
 #include "Constants.h"
 #include "Vector3D.h"
 #include "Ray3D.h"
 #include "Interval.h"
 #include "AABB.h"
+#include "RayPacket.h"
 
 class Material;
 
@@ -23,6 +26,7 @@ struct HitRecord {
     float_type v {};                                //texture surface coordinate
     bool front_face {};                             //true if the collision occured on the same side as the normal
     std::shared_ptr<Material> material_ptr {};      //a shared_ptr to the material that is collided with
+    int primitive_id = -1;                          //the id of the primitive that is collided with
 
     /**
      * @brief Construct a Hit Record object
@@ -45,6 +49,25 @@ struct HitRecord {
 };
 
 
+/**
+ * @brief The closest hits of every ray of a RayPacket found so far.
+ * 
+ */
+struct PacketHits {
+    std::array<HitRecord, RayPacket::size> records {};  //the closest hit of each lane
+    alignas(16) std::array<float_type, RayPacket::size> t_max {};   //the travel distance of each closest hit, or the maximum distance
+
+    /**
+     * @brief Construct a Packet Hits object where no ray has hit anything
+     * 
+     * @param t_max_ the maximum travel distance of every ray
+     */
+    PacketHits(float_type t_max_ = infinity) {
+        t_max.fill(t_max_);
+    }
+};
+
+
 /**
  * @brief An abstract class detailing some object that ligth can collide with.
  * 
@@ -63,12 +86,47 @@ public:
      */
     virtual HitRecord hit(const Ray3D& ray, const Interval& t_interval) const = 0;
 
+    /**
+     * @brief Finds the hits of the active rays of a packet that are closer than their closest hits so far.
+     * By default each ray is tested on its own. Hittables that can cull whole packets at once override this.
+     * 
+     * @param packet The incoming light rays.
+     * @param t_min The minimum travel distance of a valid collision.
+     * @param hits The closest hits so far, which are replaced by any closer hits.
+     * @param active The rays of the packet to test.
+     */
+    virtual void hit_packet(const RayPacket& packet, float_type t_min, PacketHits& hits, RayPacket::Mask active) const {
+        for (int lane = 0; lane < RayPacket::size; ++lane) {
+            if (((active >> lane) & 1) == 0) {
+                continue;
+            }
+            auto l = static_cast<std::size_t>(lane);
+            HitRecord hit_record = hit(packet.ray(lane), Interval{t_min, hits.t_max[l]});
+            if (hit_record.is_hit) {
+                hits.t_max[l] = hit_record.t;
+                hits.records[l] = std::move(hit_record);
+            }
+        }
+    }
+
     /**
      * @brief returns a bouuding box surrounding the Hittable.
      * 
      * @return AABB the bounding box that entirely contains the Hittable.
      */
     virtual AABB bounding_box() const = 0;
+
+protected:
+    /**
+     * @brief Returns a new primitive id, unique among the primitives of the program, 
+     * numbered in the order that they were made. Primitives put it in the HitRecords of their hits.
+     * 
+     * @return int the id
+     */
+    static int next_primitive_id() {
+        static std::atomic<int> next {0};
+        return next++;
+    }
 };
 
 #endif
\ No newline at end of file
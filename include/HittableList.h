@@ -8,6 +8,7 @@
 #include "Ray3D.h"
 #include "Interval.h"
 #include "AABB.h"
+#include "RayPacket.h"
 
 /**
  * @brief A class containing multiple possible Hittable objects.
@@ -71,6 +72,21 @@ public:
         return hit_record;
     }
 
+    /**
+     * @brief Finds the closest hits of a packet of rays with all objects within the list,
+     * keeping the packet together so that objects can cull it as a whole.
+     * 
+     * @param packet The incoming light rays.
+     * @param t_min The minimum travel distance of a valid collision.
+     * @param hits The closest hits so far, which are replaced by any closer hits.
+     * @param active The rays of the packet to test.
+     */
+    void hit_packet(const RayPacket& packet, float_type t_min, PacketHits& hits, RayPacket::Mask active) const override {
+        for (const auto& hittable_ptr : hittables) {
+            hittable_ptr->hit_packet(packet, t_min, hits, active);
+        }
+    }
+
     /**
      * @brief returns the Axis Aligned Bounding Box that contains all hittables in the list.
      * 
@@ -8,6 +8,8 @@
 #include <unistd.h>
 #include <sys/mman.h>
 #include "Constants.h"
+#include "Trace.h"
+#include "PixelEncoder.h"
 
 /**
  * @brief Class that manages a file.
@@ -71,7 +73,7 @@ public:
 template <unsigned long WIDTH, unsigned long HEIGHT>
 class ImageData {
 private:
-    constexpr static int max_line_size = ColorConstants::num_components * (ColorConstants::max_pixel_val_digits+1);
+    constexpr static int max_line_size = PixelEncoder::pixel_size;
 
     using DataUnderlyingType = std::array<std::array<std::array<char, max_line_size>, WIDTH>, HEIGHT>;
     constexpr static long data_size = sizeof(DataUnderlyingType);
@@ -87,6 +89,7 @@ public:
      */
     ImageData(const std::string& filename) : file_descriptor {filename}
     {   
+        Trace::ScopedTimer timer {"image_mmap_setup"};
         //header data 
         std::string header_data =   "P3\n" + std::to_string(WIDTH) + ' ' + std::to_string(HEIGHT) + '\n' +
                                     std::to_string(ColorConstants::max_pixel_val) + '\n';
@@ -134,9 +137,39 @@ public:
                      pixel_data.data(), pixel_data.size());
     } 
 
+    /**
+     * @brief Writes the pixel at row row and column col to the file.
+     * 
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @param components the gamma corrected R, G and B values of the pixel, from 0 to ColorConstants::max_pixel_val
+     */
+    void write_pixel(int row, int col, const int* components) {
+        PixelEncoder::encode_pixel(components, pixel_data(row, col));
+    }
+
+    /**
+     * @brief Writes count consecutive pixels of row row, starting at column col, to the file.
+     * The pixels are encoded straight into the mapped file, without allocating.
+     * 
+     * @param row the row of the pixels, 0 indexed from the top
+     * @param col the column of the first pixel, 0 indexed from the left
+     * @param components the gamma corrected R, G and B values of every pixel, from 0 to ColorConstants::max_pixel_val
+     * @param count the number of pixels
+     */
+    void write_row(int row, int col, const int* components, std::size_t count) {
+        assert(static_cast<std::size_t>(col) + count <= WIDTH && "row out of bounds");
+        PixelEncoder::encode_row(components, count, pixel_data(row, col));
+    }
+
     ~ImageData() {
         munmap(image_data_ptr, data_size);
     }
+
+private:
+    char* pixel_data(int row, int col) {
+        return (*image_data_ptr)[static_cast<unsigned long>(row)][static_cast<unsigned long>(col)].data();
+    }
 };
 
 #endif
\ No newline at end of file
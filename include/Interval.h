@@ -89,8 +89,8 @@ public:
     }
 };
 
-const Interval Interval::empty {+infinity, -infinity};
-const Interval Interval::universe {-infinity, +infinity};
+inline const Interval Interval::empty {+infinity, -infinity};
+inline const Interval Interval::universe {-infinity, +infinity};
 
 /**
  * @brief Shifts both ends of an Interval by some amount.
@@ -99,7 +99,7 @@ const Interval Interval::universe {-infinity, +infinity};
  * @param displacement the amount to shift the Interval by
  * @return Interval the resulting displaced Interval
  */
-Interval operator+(const Interval& interval, float_type displacement) {
+inline Interval operator+(const Interval& interval, float_type displacement) {
     return Interval{interval.min + displacement, interval.max+displacement};
 }
 
@@ -110,7 +110,7 @@ Interval operator+(const Interval& interval, float_type displacement) {
  * @param interval the Interval to move
  * @return Interval the resulting displaced Interval
  */
-Interval operator+(float_type displacement, const Interval& interval) {
+inline Interval operator+(float_type displacement, const Interval& interval) {
     return Interval{interval.min + displacement, interval.max+displacement};
 }
 
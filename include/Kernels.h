@@ -0,0 +1,171 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include "Constants.h"
+
+// This Kernels namespace holds the hot loops of the renderer, which src/kernels compiles once per instruction set,
+// so that one binary uses AVX2 or AVX-512 on the machines that have them.
+// The best supported instruction set is chosen from CPUID on first use, or forced with select().
+// The single ray AABB, Sphere and Quad tests are not kernels: they have no lanes to vectorize, and calling them
+// through the table instead of inlining them into BVH_node::hit made traversal slower with every instruction set.
+// The kernels only take plain arrays and structs: an inline function compiled for one instruction set
+// could otherwise be linked into the code of another.
+namespace Kernels
+{
+	inline constexpr int packet_size = 16;		// the number of rays (lanes) of a packet
+
+	// The rays of a packet as a structure of arrays, [axis][lane]
+	struct PacketRays
+	{
+		alignas(64) float_type origin[3][packet_size] {};
+		alignas(64) float_type direction[3][packet_size] {};
+		alignas(64) float_type inverse_direction[3][packet_size] {};
+	};
+
+	// The plane and planar coordinate vectors of a Quad
+	struct QuadShape
+	{
+		float_type Q[3];			// corner
+		float_type u[3];			// sides
+		float_type v[3];
+		float_type w[3];			// for the planar coordinates of a point
+		float_type normal[3];		// unit normal
+		float_type D;				// plane equation: normal . p = D
+	};
+
+	// The tables of a Perlin noise generator
+	struct PerlinTables
+	{
+		const float_type* vectors;		// the random unit gradient vectors
+		std::size_t vector_stride;		// in float_types
+		const int* perm_x;
+		const int* perm_y;
+		const int* perm_z;
+	};
+
+	// The kernels built for one instruction set
+	struct Table
+	{
+		const char* name;
+
+		// Returns which active lanes travel through the box between t_min and their own t_max
+		std::uint32_t (*packet_box)(const PacketRays& rays, const float_type* box_min, const float_type* box_max,
+									float_type t_min, const float_type* t_max, std::uint32_t active);
+
+		// Returns which active lanes hit a sphere strictly between t_min and their own t_max, and sets t of those lanes
+		std::uint32_t (*packet_sphere)(const PacketRays& rays, const float_type* center, float_type radius,
+									   float_type t_min, const float_type* t_max, std::uint32_t active, float_type* t);
+
+		// Returns which active lanes hit a quad between t_min and their own t_max,
+		// and sets t and the planar coordinates alpha and beta of those lanes
+		std::uint32_t (*packet_quad)(const PacketRays& rays, const QuadShape& quad, float_type t_min, const float_type* t_max,
+									 std::uint32_t active, float_type* t, float_type* alpha, float_type* beta);
+
+		// Perlin turbulence at (x, y, z): the absolute weighted sum of depth octaves of noise
+		float_type (*perlin_turbulence)(const PerlinTables& tables, float_type x, float_type y, float_type z, int depth);
+
+		// Converts count pixel sums, stride float_types apart, to gamma corrected 0-255 components.
+		// scale is 1 / samples per pixel.
+		void (*tonemap_row)(const float_type* sums, std::size_t stride, std::size_t count, float_type scale, int* components);
+	};
+
+	extern const Table baseline_table;
+#if defined(RAYTRACER_X86_KERNELS)
+	extern const Table avx2_table;
+	extern const Table avx512_table;
+#endif
+
+	enum class Isa
+	{
+		baseline,
+		avx2,		// with FMA
+		avx512		// F and VL
+	};
+
+	inline const char* name(Isa isa)
+	{
+		switch (isa)
+		{
+			case Isa::avx2: return "avx2";
+			case Isa::avx512: return "avx512";
+			default: return "baseline";
+		}
+	}
+
+	// Throws std::invalid_argument if text does not name an instruction set
+	inline Isa parse_isa(const std::string& text)
+	{
+		for (Isa isa : { Isa::baseline, Isa::avx2, Isa::avx512 })
+		{
+			if (text == name(isa))
+				return isa;
+		}
+		throw std::invalid_argument("Unknown instruction set '" + text + "', expected baseline, avx2 or avx512");
+	}
+
+	// Returns true if this binary has kernels for isa and the CPU and OS support it
+	inline bool supported(Isa isa)
+	{
+#if defined(RAYTRACER_X86_KERNELS)
+		__builtin_cpu_init();
+		bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		switch (isa)
+		{
+			case Isa::avx2: return avx2;
+			case Isa::avx512: return avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl");
+			default: return true;
+		}
+#else
+		return isa == Isa::baseline;
+#endif
+	}
+
+	// The best instruction set that is supported
+	inline Isa detect()
+	{
+		for (Isa isa : { Isa::avx512, Isa::avx2 })
+		{
+			if (supported(isa))
+				return isa;
+		}
+		return Isa::baseline;
+	}
+
+	inline const Table& table(Isa isa)
+	{
+#if defined(RAYTRACER_X86_KERNELS)
+		if (isa == Isa::avx512)
+			return avx512_table;
+		if (isa == Isa::avx2)
+			return avx2_table;
+#endif
+		return baseline_table;
+	}
+
+	inline const Table*& active_table()
+	{
+		static const Table* active = &table(detect());
+		return active;
+	}
+
+	// The kernels in use
+	inline const Table& active()
+	{
+		return *active_table();
+	}
+
+	// Uses the kernels of isa from now on. Should be called before rendering starts.
+	// Throws std::invalid_argument if isa is not supported.
+	inline void select(Isa isa)
+	{
+		if (!supported(isa))
+			throw std::invalid_argument(std::string("The ") + name(isa) + " kernels are not supported on this machine");
+		active_table() = &table(isa);
+	}
+};
+
+#endif
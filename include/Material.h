@@ -2,11 +2,13 @@
 #define MATERIAL_H
 
 #include <memory>
+#include <atomic>
 #include "Constants.h"
 #include "Ray3D.h"
 #include "Hittable.h"
 #include "Color.h"
 #include "Texture.h"
+#include "ONB.h"
 
 /**
  * @brief Data detailing what happens to light after a collision (a result of either refraction or reflection).
@@ -18,6 +20,27 @@ struct ScatterRecord {
     Color attenuation {};   //the multiplicative factors of (r,g,b) that the light ray undergoes as a result of collision
 };
 
+/**
+ * @brief A direction sampled from the scattering distribution of a Material, with the values needed to weigh it.
+ * f includes the cosine between the direction and the surface normal for surfaces (not for media),
+ * so the path throughput of a sample is multiplied by f / pdf.
+ * 
+ */
+struct BSDFSample {
+    bool success = false;       //false if the light is absorbed
+    Vector3D direction {};      //the direction that the light scatters in
+    Color f {};                 //the scattering function in direction. for specular samples, the throughput weight itself
+    float_type pdf = 0;         //the solid angle density of sampling direction. 1 for specular samples
+    bool is_specular = false;   //sampled from a delta distribution, which eval and pdf cannot evaluate
+};
+
+/**
+ * @brief The concrete type of a Material, so that batches of hits can be grouped by material
+ * and shaded without virtual calls. Materials defined outside of this file are other.
+ * 
+ */
+enum class MaterialKind { lambertian, metal, dielectric, diffuse_lights, isotropic, other, count };
+
 /**
  * @brief The abstract class describing an interface to describe 
  * the light scattering behavior of different object materials.
@@ -25,16 +48,98 @@ struct ScatterRecord {
  */
 class Material {
 public:
+    /**
+     * @brief Construct a new Material object
+     * 
+     * @param kind_ the concrete type of the material
+     */
+    explicit Material(MaterialKind kind_ = MaterialKind::other) : m_kind{kind_}, m_id{next_id()} {}
+
     virtual ~Material() {}
 
     /**
-     * @brief Returns information about how light scatters after colliding with an object.
+     * @brief Returns the concrete type of the material.
+     * 
+     * @return MaterialKind the concrete type
+     */
+    MaterialKind kind() const {
+        return m_kind;
+    }
+
+    /**
+     * @brief Returns the id of the material, unique among the materials of the program, 
+     * numbered in the order that they were made.
+     * 
+     * @return int the id
+     */
+    int id() const {
+        return m_id;
+    }
+
+    /**
+     * @brief Samples a direction that light scatters in after colliding with the material.
+     * By default, Materials absorb all light.
+     * 
+     * @param ray_in The incoming light ray.
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @return BSDFSample the sampled direction, its scattering function value and its density
+     */
+    virtual BSDFSample sample(const Ray3D& /*ray_in*/, const HitRecord& /*hit_record*/) const {
+        return BSDFSample{};
+    }
+
+    /**
+     * @brief Returns the scattering function of the material for light that scatters in direction, 
+     * including the cosine term like BSDFSample::f. Specular materials return black.
+     * 
+     * @param ray_in The incoming light ray.
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @param direction The direction that the light scatters in.
+     * @return Color the scattering function value
+     */
+    virtual Color eval(const Ray3D& /*ray_in*/, const HitRecord& /*hit_record*/, const Vector3D& /*direction*/) const {
+        return Color{0, 0, 0};
+    }
+
+    /**
+     * @brief Returns the solid angle density with which sample chooses direction. Specular materials return 0.
+     * 
+     * @param ray_in The incoming light ray.
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @param direction The direction that the light scatters in.
+     * @return float_type the density
+     */
+    virtual float_type pdf(const Ray3D& /*ray_in*/, const HitRecord& /*hit_record*/, const Vector3D& /*direction*/) const {
+        return 0;
+    }
+
+    /**
+     * @brief Returns information about how light scatters after colliding with an object: 
+     * a sampled scattered ray and the attenuation of the path, f / pdf.
      * 
      * @param ray_in The incoming light ray.
      * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
      * @return ScatterRecord detailing how the light behaves after the collision 
      */
-    virtual ScatterRecord scatter(const Ray3D& ray_in, const HitRecord& hit_record) const = 0;
+    ScatterRecord scatter(const Ray3D& ray_in, const HitRecord& hit_record) const {
+        return to_scatter_record(ray_in, hit_record, sample(ray_in, hit_record));
+    }
+
+    /**
+     * @brief Converts a sample of the scattering distribution to the scattered ray and the attenuation of the path.
+     * 
+     * @param ray_in The incoming light ray.
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @param sample The sample of the material that was hit.
+     * @return ScatterRecord detailing how the light behaves after the collision 
+     */
+    static ScatterRecord to_scatter_record(const Ray3D& ray_in, const HitRecord& hit_record, const BSDFSample& sample) {
+        if (!sample.success || !(sample.pdf > 0)) {
+            return ScatterRecord{};
+        }
+        Ray3D ray_out {hit_record.point, sample.direction, ray_in.time()};
+        return ScatterRecord{true, ray_out, sample.is_specular ? sample.f : sample.f / sample.pdf};
+    }
 
     /**
      * @brief Returns the Color emitted by the material, specified by a light-emitting material's Texture.
@@ -49,13 +154,33 @@ public:
     virtual Color emitted(float_type u, float_type v, const Vector3D& position) const {
         return Color{0, 0, 0};
     }
+
+    /**
+     * @brief Returns the color of the material at a hit, the albedo feature that guides the denoiser.
+     * By default, Materials without a color of their own (glass, lights) are white.
+     * 
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @return Color The albedo
+     */
+    virtual Color surface_albedo(const HitRecord& /*hit_record*/) const {
+        return Color{1, 1, 1};
+    }
+
+private:
+    MaterialKind m_kind;
+    int m_id;
+
+    static int next_id() {
+        static std::atomic<int> next {0};
+        return next++;
+    }
 };
 
 /**
  * @brief A diffuse (matte) material: randomly scatters in a hemisphere on the side of collision (the surface normal).
  * 
  */
-class Lambertian : public Material { 
+class Lambertian final : public Material {
 private:
     std::shared_ptr<Texture> albedo;
 
@@ -65,33 +190,67 @@ public:
      * 
      * @param scalar the RGB multiplicative factors that light colliding with this material will undergo
      */
-    Lambertian(const Color& scalar) : albedo{std::make_shared<SolidColorTexture>(scalar)} {}
+    Lambertian(const Color& scalar) : Material{MaterialKind::lambertian}, albedo{std::make_shared<SolidColorTexture>(scalar)} {}
     
     /**
      * @brief Construct a new Lambertian object whose surface maps to some texture 
      * 
      * @param texture_ptr the std::shared_ptr to some Texture. 
      */
-    Lambertian(std::shared_ptr<Texture> texture_ptr) : albedo{texture_ptr} {}
+    Lambertian(std::shared_ptr<Texture> texture_ptr) : Material{MaterialKind::lambertian}, albedo{texture_ptr} {}
 
     /**
-     * @brief Returns information about how light scatters as a result of diffuse object collision.
+     * @brief Samples a diffuse scattering direction with a density proportional to its cosine to the normal, 
+     * which is the lambertian scattering equation, so f / pdf is the albedo.
      * 
      * @param ray_in The incoming light ray.
      * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
-     * @return ScatterRecord detailing how the light behaves after the collision 
+     * @return BSDFSample the sampled direction, its scattering function value and its density
      */
-    ScatterRecord scatter(const Ray3D& ray_in, const HitRecord& hit_record) const override {
-        constexpr bool success = true;  //always successful
-        ////lambertian scattering equation: scattering proportional to cos(x), 
-        //where x is the angle between normal and scatter direction
-        Vector3D scatter_direction = Vector3D::random_sphere_unit_vector() + hit_record.unit_normal;    
-        //catch degenerate scatter direction
-        if (scatter_direction.near_zero()) {
-            scatter_direction = hit_record.unit_normal;
+    BSDFSample sample(const Ray3D& /*ray_in*/, const HitRecord& hit_record) const override {
+        Vector3D local_direction = Vector3D::random_cosine_direction();
+        float_type cosine = local_direction.z();
+        Color f = albedo->value(hit_record.u, hit_record.v, hit_record.point) * (cosine / pi);
+        return BSDFSample{true, ONB{hit_record.unit_normal}.to_world(local_direction), f, cosine / pi, false};
+    }
+
+    /**
+     * @brief Returns the lambertian scattering function, albedo / pi times the cosine of direction to the normal.
+     * 
+     * @param ray_in The incoming light ray.
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @param direction The direction that the light scatters in.
+     * @return Color the scattering function value
+     */
+    Color eval(const Ray3D& /*ray_in*/, const HitRecord& hit_record, const Vector3D& direction) const override {
+        float_type cosine = direction.unit_vector().dot(hit_record.unit_normal);
+        if (cosine <= 0) {
+            return Color{0, 0, 0};
         }
-        Ray3D scatter_ray {hit_record.point, scatter_direction, ray_in.time()};
-        return ScatterRecord{success, scatter_ray, albedo->value(hit_record.u, hit_record.v, hit_record.point)};
+        return albedo->value(hit_record.u, hit_record.v, hit_record.point) * (cosine / pi);
+    }
+
+    /**
+     * @brief Returns the density of the cosine weighted sampling of direction.
+     * 
+     * @param ray_in The incoming light ray.
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @param direction The direction that the light scatters in.
+     * @return float_type the density
+     */
+    float_type pdf(const Ray3D& /*ray_in*/, const HitRecord& hit_record, const Vector3D& direction) const override {
+        float_type cosine = direction.unit_vector().dot(hit_record.unit_normal);
+        return cosine <= 0 ? 0 : cosine / pi;
+    }
+
+    /**
+     * @brief Returns the color of the texture at the hit.
+     * 
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @return Color The albedo
+     */
+    Color surface_albedo(const HitRecord& hit_record) const override {
+        return albedo->value(hit_record.u, hit_record.v, hit_record.point);
     }
 };
 
@@ -99,7 +258,7 @@ public:
  * @brief A reflective material that light can collide with.
  * 
  */
-class Metal : public Material {
+class Metal final : public Material {
 private:
     Color albedo;
     float_type fuzz;
@@ -112,21 +271,31 @@ public:
      * @param fuzz_ The "degree of randomness" that the reflected light direction will have.
      * Resulting light will have its direction offset by a sphere of radius fuzz.
      */
-    Metal(const Color& albedo_, float_type fuzz_) : albedo{albedo_}, fuzz{fuzz_ <= 1 ? fuzz_ : 1} {}
+    Metal(const Color& albedo_, float_type fuzz_) : Material{MaterialKind::metal}, albedo{albedo_}, fuzz{fuzz_ <= 1 ? fuzz_ : 1} {}
 
     /**
-     * @brief Returns information about how light scatters as a result of collision with metal.
+     * @brief Samples the reflection of light off of the metal. 
+     * Fuzzed reflections are treated as specular too, since their density has no closed form.
      * 
      * @param ray_in The incoming light ray.
      * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
-     * @return ScatterRecord detailing how the light behaves after the collision 
+     * @return BSDFSample the reflected direction, weighted by the albedo
      */
-    ScatterRecord scatter(const Ray3D& ray_in, const HitRecord& hit_record) const override {
+    BSDFSample sample(const Ray3D& ray_in, const HitRecord& hit_record) const override {
         constexpr bool success = true;  //always reflects
         Vector3D reflected_direction = ray_in.direction().unit_vector().reflect(hit_record.unit_normal);
         Vector3D fuzzed_direction = reflected_direction + fuzz*Vector3D::random_sphere_unit_vector();
-        Ray3D reflected_ray {hit_record.point, fuzzed_direction, ray_in.time()};
-        return ScatterRecord{success, reflected_ray, albedo};
+        return BSDFSample{success, fuzzed_direction, albedo, 1, true};
+    }
+
+    /**
+     * @brief Returns the color that the metal reflects.
+     * 
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @return Color The albedo
+     */
+    Color surface_albedo(const HitRecord& /*hit_record*/) const override {
+        return albedo;
     }
 };
 
@@ -134,7 +303,7 @@ public:
  * @brief Clear material such as water, glass, or diamonds that light can collide with. 
  * 
  */
-class Dielectric : public Material {
+class Dielectric final : public Material {
 private:
     float_type refractive_index;
 
@@ -159,16 +328,17 @@ public:
      * 
      * @param refractive_index_ The index of refraction of the material.
      */
-    Dielectric(float_type refractive_index_) : refractive_index {refractive_index_} {}
+    Dielectric(float_type refractive_index_) : Material{MaterialKind::dielectric}, refractive_index {refractive_index_} {}
 
     /**
-     * @brief Returns information about how light scatters as a result of collision with the dielectric.
+     * @brief Samples the reflection or refraction of light by the dielectric, 
+     * choosing reflection with the probability of the reflectance.
      * 
      * @param ray_in The incoming light ray.
      * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
-     * @return ScatterRecord detailing how the light behaves after the collision 
+     * @return BSDFSample the reflected or refracted direction, which is not attenuated
      */
-    ScatterRecord scatter(const Ray3D& ray_in, const HitRecord& hit_record) const override {
+    BSDFSample sample(const Ray3D& ray_in, const HitRecord& hit_record) const override {
         constexpr bool success = true;  //always reflects
         constexpr Color attenuation {1, 1, 1};
         constexpr float_type air_ri = 1.0;
@@ -177,8 +347,7 @@ public:
         //theta = angle between normal and incident light ray
         float_type cos_theta = fmin(-unit_direction.dot(hit_record.unit_normal), 1.0);  
         Vector3D refracted_direction = unit_direction.refract(hit_record.unit_normal, refraction_ratio, reflectance(cos_theta, refraction_ratio));
-        Ray3D refracted_ray {hit_record.point, refracted_direction, ray_in.time()};
-        return ScatterRecord{success, refracted_ray, attenuation};  
+        return BSDFSample{success, refracted_direction, attenuation, 1, true};
     }
 };
 
@@ -186,33 +355,21 @@ public:
  * @brief A light emitting material, whose light pattern is determined by a shared_ptr<Texture>.
  * 
  */
-class DiffuseLights : public Material {
+class DiffuseLights final : public Material {
 public:
     /**
      * @brief Construct a new Diffuse Lights object
      * 
      * @param emit_ the Texture whose color the light will emit.
      */
-    DiffuseLights(std::shared_ptr<Texture> emit_) : emit{emit_} {}
+    DiffuseLights(std::shared_ptr<Texture> emit_) : Material{MaterialKind::diffuse_lights}, emit{emit_} {}
 
     /**
      * @brief Construct a new Diffuse Lights object
      * 
      * @param color A color that the light will uniformly emit.
      */
-    DiffuseLights(Color color) : emit{std::make_shared<SolidColorTexture>(color)} {}
-
-    /**
-     * @brief Returns information about how light scatters with the Material.
-     * For diffuse lights, there is never scattering.
-     * 
-     * @param ray_in The incoming light ray.
-     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
-     * @return ScatterRecord detailing how the light behaves after the collision 
-     */
-    ScatterRecord scatter(const Ray3D& ray_in, const HitRecord& hit_record) const override {
-        return ScatterRecord{}; //failed scatter
-    }
+    DiffuseLights(Color color) : Material{MaterialKind::diffuse_lights}, emit{std::make_shared<SolidColorTexture>(color)} {}
 
     /**
      * @brief Returns the Color emitted by the Diffuse Lights, specified by the emit Texture.
@@ -235,35 +392,69 @@ private:
  * @brief An isotropic material scatters ligt uniformly in all directions.
  * 
  */
-class Isotropic : public Material {
+class Isotropic final : public Material {
 public:
     /**
      * @brief Construct a new Isotropic object
      * 
      * @param color the Color that will be used to uniformly attenuate any light ray that is scattered by the material.
      */
-    Isotropic(Color color) : albedo {std::make_shared<SolidColorTexture>(color)} {}
+    Isotropic(Color color) : Material{MaterialKind::isotropic}, albedo {std::make_shared<SolidColorTexture>(color)} {}
 
     /**
      * @brief Construct a new Isotropic object
      * 
      * @param albedo_ the Texture that will be used to attenuate any light ray that is scattered by the material.
      */
-    Isotropic(std::shared_ptr<Texture> albedo_) : albedo {albedo_} {}
+    Isotropic(std::shared_ptr<Texture> albedo_) : Material{MaterialKind::isotropic}, albedo {albedo_} {}
 
-        /**
-     * @brief Returns information about how light scatters in the Isotropic material (randomly).
+    /**
+     * @brief Samples a direction that light scatters in, uniformly on the sphere.
+     * The phase function of a medium has no cosine term, so f is the albedo / 4 pi.
      * 
      * @param ray_in The incoming light ray.
      * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
-     * @return ScatterRecord detailing how the light behaves after the collision 
+     * @return BSDFSample the sampled direction, its phase function value and its density
      */
-    ScatterRecord scatter(const Ray3D& ray_in, const HitRecord& hit_record) const override {
+    BSDFSample sample(const Ray3D& /*ray_in*/, const HitRecord& hit_record) const override {
         constexpr bool success = true;  //always successful
         Vector3D random_direction = Vector3D::random_sphere_unit_vector();
-        Ray3D refracted_ray {hit_record.point, random_direction, ray_in.time()};
-        Color attenuation = albedo->value(hit_record.u, hit_record.v, hit_record.point);
-        return ScatterRecord{success, refracted_ray, attenuation};  
+        Color f = albedo->value(hit_record.u, hit_record.v, hit_record.point) / (4 * pi);
+        return BSDFSample{success, random_direction, f, 1 / (4 * pi), false};
+    }
+
+    /**
+     * @brief Returns the isotropic phase function, albedo / 4 pi in every direction.
+     * 
+     * @param ray_in The incoming light ray.
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @param direction The direction that the light scatters in.
+     * @return Color the phase function value
+     */
+    Color eval(const Ray3D& /*ray_in*/, const HitRecord& hit_record, const Vector3D& /*direction*/) const override {
+        return albedo->value(hit_record.u, hit_record.v, hit_record.point) / (4 * pi);
+    }
+
+    /**
+     * @brief Returns the density of uniform sphere sampling, 1 / 4 pi.
+     * 
+     * @param ray_in The incoming light ray.
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @param direction The direction that the light scatters in.
+     * @return float_type the density
+     */
+    float_type pdf(const Ray3D& /*ray_in*/, const HitRecord& /*hit_record*/, const Vector3D& /*direction*/) const override {
+        return 1 / (4 * pi);
+    }
+
+    /**
+     * @brief Returns the color of the texture at the hit.
+     * 
+     * @param hit_record The information about where a light ray collided with a surface, and what the surface was.
+     * @return Color The albedo
+     */
+    Color surface_albedo(const HitRecord& hit_record) const override {
+        return albedo->value(hit_record.u, hit_record.v, hit_record.point);
     }
 
 private:
@@ -0,0 +1,59 @@
+#ifndef ONB_H
+#define ONB_H
+
+#include <cmath>
+#include "Constants.h"
+#include "Vector3D.h"
+
+/**
+ * @brief An orthonormal basis around a unit normal, used to turn directions sampled around the z axis
+ * into directions around the normal.
+ * Built without branches or normalization, following Duff et al., "Building an Orthonormal Basis, Revisited" (2017).
+ *
+ */
+class ONB {
+public:
+    /**
+     * @brief Construct a new ONB object whose w axis is unit_normal.
+     *
+     * @param unit_normal the normal vector of unit length.
+     */
+    ONB(const Vector3D& unit_normal) : m_w{unit_normal} {
+        float_type sign = std::copysign(float_type{1}, unit_normal.z());
+        float_type a = -1 / (sign + unit_normal.z());
+        float_type b = unit_normal.x() * unit_normal.y() * a;
+        m_u = Vector3D{1 + sign * unit_normal.x() * unit_normal.x() * a, sign * b, -sign * unit_normal.x()};
+        m_v = Vector3D{b, sign + unit_normal.y() * unit_normal.y() * a, -unit_normal.y()};
+    }
+
+    const Vector3D& u() const {return m_u;}
+    const Vector3D& v() const {return m_v;}
+    const Vector3D& w() const {return m_w;}
+
+    /**
+     * @brief Converts a vector from the coordinates of the basis to world coordinates.
+     *
+     * @param local the vector, where z is along the normal.
+     * @return Vector3D the vector in world coordinates.
+     */
+    Vector3D to_world(const Vector3D& local) const {
+        return local.x() * m_u + local.y() * m_v + local.z() * m_w;
+    }
+
+    /**
+     * @brief Converts a vector from world coordinates to the coordinates of the basis.
+     *
+     * @param world the vector in world coordinates.
+     * @return Vector3D the vector, where z is along the normal.
+     */
+    Vector3D to_local(const Vector3D& world) const {
+        return Vector3D{world.dot(m_u), world.dot(m_v), world.dot(m_w)};
+    }
+
+private:
+    Vector3D m_u;
+    Vector3D m_v;
+    Vector3D m_w;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef PPMSTREAM_H
+#define PPMSTREAM_H
+
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Constants.h"
+#include "PixelEncoder.h"
+
+/**
+ * @brief Writes a .ppm image one row after another, from the top, to a stream that does not need to be seekable:
+ * standard output, a pipe or a FIFO, as well as a regular file.
+ * Rows are encoded into a buffer that is allocated once, so the memory used does not grow with the image.
+ *
+ */
+class PPMStream {
+public:
+    /**
+     * @brief Opens the stream and writes the header of the image.
+     * Throws std::runtime_error if the target cannot be opened or written.
+     *
+     * @param target the path of the file or FIFO to write to, or "-" for standard output.
+     * Opening a FIFO blocks until it has a reader.
+     * @param width the width of the image in pixels
+     * @param height the height of the image in pixels
+     */
+    PPMStream(const std::string& target, int width, int height) :
+        m_fd{target == "-" ? STDOUT_FILENO : open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)},
+        m_owns_fd{target != "-"},
+        m_width{width},
+        m_height{height},
+        m_row(static_cast<std::size_t>(width) * PixelEncoder::pixel_size)
+    {
+        if (m_fd == -1) {
+            throw std::runtime_error("Error: Unable to open output stream " + target);
+        }
+        std::string header = "P3\n" + std::to_string(width) + ' ' + std::to_string(height) + '\n' +
+                             std::to_string(ColorConstants::max_pixel_val) + '\n';
+        write_all(header.data(), header.size());
+    }
+
+    PPMStream(const PPMStream&) = delete;
+    PPMStream& operator=(const PPMStream&) = delete;
+
+    ~PPMStream() {
+        if (m_owns_fd) {
+            close(m_fd);
+        }
+    }
+
+    /**
+     * @brief Returns the number of rows that have been written.
+     *
+     * @return int the next row to be written, 0 indexed from the top
+     */
+    int rows_written() const {return m_rows_written;}
+
+    /**
+     * @brief Writes the next row of the image.
+     * Throws std::runtime_error if the write fails, or if every row has already been written.
+     *
+     * @param components the gamma corrected R, G and B values of every pixel of the row, from the left
+     */
+    void write_row(const int* components) {
+        if (m_rows_written == m_height) {
+            throw std::runtime_error("Error: every row of the output stream has already been written");
+        }
+        PixelEncoder::encode_row(components, static_cast<std::size_t>(m_width), m_row.data());
+        write_all(m_row.data(), m_row.size());
+        ++m_rows_written;
+    }
+
+private:
+    int m_fd;
+    bool m_owns_fd;
+    int m_width;
+    int m_height;
+    int m_rows_written = 0;
+    std::vector<char> m_row;
+
+    /**
+     * @brief Writes all of data, retrying the partial writes of pipes and interrupted writes.
+     * Throws std::runtime_error if the write fails.
+     *
+     */
+    void write_all(const char* data, std::size_t size) {
+        while (size > 0) {
+            ssize_t written = write(m_fd, data, size);
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("Error: Unable to write to the output stream");
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    }
+};
+
+#endif
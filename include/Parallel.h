@@ -0,0 +1,28 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+// This header-only Parallel namespace splits work over rows into one band of rows per hardware thread.
+// It suits passes whose rows all cost about the same, such as filtering or encoding an image, where the
+// recursive tiling of Camera::parallel_render_tile would start far more threads than there is work for.
+namespace Parallel
+{
+	// Runs row_function(row_min, row_max) over bands of rows on every hardware thread, the first band on this one
+	template <typename RowFunction>
+	void rows(int height, const RowFunction& row_function)
+	{
+		int bands = std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, std::max(height, 1));
+		std::vector<std::future<void>> futures;
+		for (int band = 1; band < bands; ++band)
+			futures.push_back(std::async(std::launch::async, row_function, band * height / bands, (band + 1) * height / bands));
+		row_function(0, height / bands);
+		for (auto& future : futures)
+			future.get();
+	}
+};
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef PARTIALRENDER_H
+#define PARTIALRENDER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "Constants.h"
+#include "Color.h"
+#include "AccumulationBuffer.h"
+#include "RenderSettings.h"
+#include "Kernels.h"
+#include "PPMStream.h"
+
+/**
+ * @brief The sums of the color samples of a range of samples per pixel, over a window of an image.
+ * A frame can be split into partial renders by sample range, by window, or both, and merged by MergedRender.
+ *
+ * A .partial file is a header (the magic RTPART1, the width and height of the image, the seed, the first and
+ * past the last sample of the range and the window) followed by the R, G and B sums of every pixel of the window
+ * as 32 bit floats, in raster order.
+ *
+ */
+class PartialRender {
+public:
+    /**
+     * @brief What a partial render covers, as stored at the start of its file.
+     *
+     */
+    struct Header {
+        std::int32_t width = 0;
+        std::int32_t height = 0;
+        std::uint64_t seed = 0;
+        std::int64_t sample_begin = 0;      //inclusive
+        std::int64_t sample_end = 0;        //exclusive
+        PixelWindow window {};
+
+        long samples() const {return static_cast<long>(sample_end - sample_begin);}
+    };
+
+    /**
+     * @brief Construct a new Partial Render object of header.window whose sums are all black.
+     *
+     * @param header what the partial render covers
+     */
+    explicit PartialRender(const Header& header) :
+        m_header{header},
+        m_sums(static_cast<std::size_t>(header.window.width()) * static_cast<std::size_t>(header.window.height()), ColorSum{0, 0, 0})
+    {}
+
+    const Header& header() const {return m_header;}
+
+    /**
+     * @brief Returns the sum of the pixel at row row and column col of the image, which must lie in the window.
+     *
+     * @param row the row of the pixel, 0 indexed from the top
+     * @param col the column of the pixel, 0 indexed from the left
+     * @return ColorSum& the sum of the color samples of the pixel
+     */
+    ColorSum& sum(int row, int col) {return m_sums[index(row, col)];}
+    const ColorSum& sum(int row, int col) const {return m_sums[index(row, col)];}
+
+    /**
+     * @brief Writes the partial render to a file.
+     * Throws std::runtime_error if the file cannot be written.
+     *
+     * @param filename the name of the file, with path and extension.
+     */
+    void save(const std::string& filename) const {
+        std::ofstream out {filename, std::ios::binary | std::ios::trunc};
+        if (!out) {
+            throw std::runtime_error("Error: Unable to open partial render file " + filename);
+        }
+        std::int32_t window[4] = {m_header.window.col_min, m_header.window.row_min, m_header.window.col_max, m_header.window.row_max};
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char*>(&m_header.width), sizeof(m_header.width));
+        out.write(reinterpret_cast<const char*>(&m_header.height), sizeof(m_header.height));
+        out.write(reinterpret_cast<const char*>(&m_header.seed), sizeof(m_header.seed));
+        out.write(reinterpret_cast<const char*>(&m_header.sample_begin), sizeof(m_header.sample_begin));
+        out.write(reinterpret_cast<const char*>(&m_header.sample_end), sizeof(m_header.sample_end));
+        out.write(reinterpret_cast<const char*>(window), sizeof(window));
+        for (const ColorSum& sum : m_sums) {
+            float components[3] = {sum.x(), sum.y(), sum.z()};
+            out.write(reinterpret_cast<const char*>(components), sizeof(components));
+        }
+        if (!out) {
+            throw std::runtime_error("Error: Unable to write partial render file " + filename);
+        }
+    }
+
+    /**
+     * @brief Reads the header of a partial render file.
+     * Throws std::runtime_error if the file cannot be read, is not a partial render, or its header is inconsistent.
+     *
+     * @param filename the name of the file, with path and extension.
+     * @return Header what the partial render covers
+     */
+    static Header read_header(const std::string& filename) {
+        std::ifstream in {filename, std::ios::binary};
+        return read_header(in, filename);
+    }
+
+    /**
+     * @brief Reads a partial render file.
+     * Throws std::runtime_error if the file cannot be read, is not a partial render, or is truncated.
+     *
+     * @param filename the name of the file, with path and extension.
+     * @return PartialRender the partial render
+     */
+    static PartialRender load(const std::string& filename) {
+        std::ifstream in {filename, std::ios::binary};
+        PartialRender partial {read_header(in, filename)};
+        for (ColorSum& sum : partial.m_sums) {
+            float components[3] {};
+            in.read(reinterpret_cast<char*>(components), sizeof(components));
+            sum = ColorSum{components[0], components[1], components[2]};
+        }
+        if (!in) {
+            throw std::runtime_error("Error: partial render file " + filename + " is truncated");
+        }
+        return partial;
+    }
+
+private:
+    Header m_header;
+    std::vector<ColorSum> m_sums;   //raster order over the window
+
+    constexpr static char magic[8] = {'R', 'T', 'P', 'A', 'R', 'T', '1', '\0'};
+
+    static Header read_header(std::ifstream& in, const std::string& filename) {
+        if (!in) {
+            throw std::runtime_error("Error: Unable to open partial render file " + filename);
+        }
+        char file_magic[sizeof(magic)] {};
+        Header header;
+        std::int32_t window[4] {};
+        in.read(file_magic, sizeof(file_magic));
+        in.read(reinterpret_cast<char*>(&header.width), sizeof(header.width));
+        in.read(reinterpret_cast<char*>(&header.height), sizeof(header.height));
+        in.read(reinterpret_cast<char*>(&header.seed), sizeof(header.seed));
+        in.read(reinterpret_cast<char*>(&header.sample_begin), sizeof(header.sample_begin));
+        in.read(reinterpret_cast<char*>(&header.sample_end), sizeof(header.sample_end));
+        in.read(reinterpret_cast<char*>(window), sizeof(window));
+        if (!in || !std::equal(std::begin(file_magic), std::end(file_magic), std::begin(magic))) {
+            throw std::runtime_error("Error: " + filename + " is not a partial render file");
+        }
+        header.window = PixelWindow{window[0], window[1], window[2], window[3]};
+        PixelWindow image {0, 0, header.width, header.height};
+        if (header.window.empty() || !image.contains(header.window) || header.sample_begin < 0 || header.sample_end <= header.sample_begin) {
+            throw std::runtime_error("Error: partial render file " + filename + " has an invalid header");
+        }
+        return header;
+    }
+
+    std::size_t index(int row, int col) const {
+        return static_cast<std::size_t>(row - m_header.window.row_min) * static_cast<std::size_t>(m_header.window.width())
+             + static_cast<std::size_t>(col - m_header.window.col_min);
+    }
+};
+
+/**
+ * @brief The sum of any number of partial renders of the same frame, and the samples that every pixel received.
+ *
+ * Partials are added in the order of their sample ranges, whatever order they are given in, so a merge is
+ * reproducible bit for bit. When every partial was rendered in a single pass, the merged sums are those of
+ * a progressive render whose passes end at the same sample counts.
+ *
+ */
+class MergedRender {
+public:
+    /**
+     * @brief Merges partial render files.
+     * Throws std::runtime_error if a file cannot be read, the partials are of different frames,
+     * or two of them cover the same samples of a pixel.
+     *
+     * @param filenames the names of the partial render files, with path and extension, in any order.
+     */
+    explicit MergedRender(const std::vector<std::string>& filenames) :
+        m_headers{sorted_headers(filenames)},
+        m_sums{m_headers.front().first.width, m_headers.front().first.height},
+        m_counts(static_cast<std::size_t>(m_sums.width()) * static_cast<std::size_t>(m_sums.height()), 0)
+    {
+        m_window = m_headers.front().first.window;
+        for (const auto& [header, filename] : m_headers) {
+            add(PartialRender::load(filename));
+            m_window = PixelWindow{std::min(m_window.col_min, header.window.col_min), std::min(m_window.row_min, header.window.row_min),
+                                   std::max(m_window.col_max, header.window.col_max), std::max(m_window.row_max, header.window.row_max)};
+        }
+    }
+
+    /**
+     * @brief Returns the smallest window that covers every partial render.
+     *
+     * @return const PixelWindow& the pixels that the merged image holds
+     */
+    const PixelWindow& window() const {return m_window;}
+
+    /**
+     * @brief Returns the number of partial renders merged.
+     *
+     * @return std::size_t the number of partials
+     */
+    std::size_t partials() const {return m_headers.size();}
+
+    /**
+     * @brief Writes the averaged samples of the window to a .ppm image file, tonemapped as Camera writes its images.
+     * Pixels of the window that no partial covers are black.
+     *
+     * @param filename the name of the file to be written. The file name must include a path and .ppm extension.
+     */
+    void write_image(const std::string& filename) const {
+        PPMStream image {filename, m_window.width(), m_window.height()};
+        std::vector<int> components(3 * static_cast<std::size_t>(m_sums.width()));
+        for (int j = m_window.row_min; j < m_window.row_max; ++j) {
+            //every run of pixels with the same samples is mapped at once, in the pieces that Camera maps
+            for (int i = 0, n = 0; i < m_sums.width(); i += n) {
+                long samples = count(j, i);
+                n = 1;
+                while (n < m_sums.contiguous_pixels(i) && count(j, i + n) == samples) {
+                    ++n;
+                }
+                float_type scale = samples == 0 ? 0 : static_cast<float_type>(1.0 / static_cast<double>(samples));
+                Kernels::active().tonemap_row(m_sums.sums(j, i), AccumulationBuffer::sum_stride, static_cast<std::size_t>(n),
+                                              scale, components.data() + 3 * static_cast<std::size_t>(i));
+            }
+            image.write_row(components.data() + 3 * static_cast<std::size_t>(m_window.col_min));
+        }
+    }
+
+private:
+    std::vector<std::pair<PartialRender::Header, std::string>> m_headers;
+    AccumulationBuffer m_sums;
+    std::vector<long> m_counts;     //the samples of every pixel, in raster order
+    PixelWindow m_window {};
+
+    long count(int row, int col) const {
+        return m_counts[static_cast<std::size_t>(row) * static_cast<std::size_t>(m_sums.width()) + static_cast<std::size_t>(col)];
+    }
+
+    void add(const PartialRender& partial) {
+        const PixelWindow& window = partial.header().window;
+        for (int j = window.row_min; j < window.row_max; ++j) {
+            for (int i = window.col_min; i < window.col_max; ++i) {
+                m_sums.add(j, i, partial.sum(j, i));
+                m_counts[static_cast<std::size_t>(j) * static_cast<std::size_t>(m_sums.width()) + static_cast<std::size_t>(i)]
+                    += partial.header().samples();
+            }
+        }
+    }
+
+    /**
+     * @brief Reads the headers of partial render files and sorts them by sample range, then by window.
+     * Throws std::runtime_error if there are none, they are of different frames, or two of them overlap.
+     *
+     */
+    static std::vector<std::pair<PartialRender::Header, std::string>> sorted_headers(const std::vector<std::string>& filenames) {
+        if (filenames.empty()) {
+            throw std::runtime_error("Error: there are no partial renders to merge");
+        }
+        std::vector<std::pair<PartialRender::Header, std::string>> headers;
+        for (const std::string& filename : filenames) {
+            headers.emplace_back(PartialRender::read_header(filename), filename);
+        }
+        auto key = [](const PartialRender::Header& header) {
+            return std::tuple{header.sample_begin, header.window.row_min, header.window.col_min};
+        };
+        std::sort(headers.begin(), headers.end(), [&](const auto& a, const auto& b) {return key(a.first) < key(b.first);});
+        for (std::size_t a = 0; a < headers.size(); ++a) {
+            const auto& [first, first_name] = headers[a];
+            const PartialRender::Header& reference = headers.front().first;
+            if (first.width != reference.width || first.height != reference.height || first.seed != reference.seed) {
+                throw std::runtime_error("Error: " + first_name + " is not a partial render of the same frame as " + headers.front().second);
+            }
+            for (std::size_t b = a + 1; b < headers.size(); ++b) {
+                const auto& [second, second_name] = headers[b];
+                const PixelWindow& u = first.window;
+                const PixelWindow& v = second.window;
+                bool windows_overlap = u.col_min < v.col_max && v.col_min < u.col_max && u.row_min < v.row_max && v.row_min < u.row_max;
+                bool samples_overlap = first.sample_begin < second.sample_end && second.sample_begin < first.sample_end;
+                if (windows_overlap && samples_overlap) {
+                    throw std::runtime_error("Error: " + first_name + " and " + second_name + " render the same samples of some pixels");
+                }
+            }
+        }
+        return headers;
+    }
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include "Constants.h"
 #include "Random.h"
 #include "Vector3D.h"
+#include "Kernels.h"
 
 /**
  * @brief Generates Perlin noise.
@@ -38,13 +39,13 @@ public:
      * @return float_type the noise value from [-1, 1]
      */
     float_type noise(const Vector3D& point) const {
-        auto u = point.x() - floor(point.x());
-        auto v = point.y() - floor(point.y());
-        auto w = point.z() - floor(point.z());
+        auto u = point.x() - std::floor(point.x());
+        auto v = point.y() - std::floor(point.y());
+        auto w = point.z() - std::floor(point.z());
 
-        auto i = static_cast<int>(floor(point.x()));
-        auto j = static_cast<int>(floor(point.y()));
-        auto k = static_cast<int>(floor(point.z()));
+        auto i = static_cast<int>(std::floor(point.x()));
+        auto j = static_cast<int>(std::floor(point.y()));
+        auto k = static_cast<int>(std::floor(point.z()));
 
         Vector3D sample_vecs[2][2][2];
 
@@ -69,18 +70,11 @@ public:
      * @param depth The number of frequencies of the point to include in the weighted sum.
      * @return float_type the noise value from [0, 1]
      */
-    float_type turbulence(Vector3D point, int depth = 7) const {
-        //weighted sum of the frequencies of point
-        float_type accum = 0;
-        float_type weight = 1;
-        for (int i = 0; i < depth; ++i) {
-            accum += weight*noise(point);
-            weight *= .5;
-            point *= 2;    
-        }
-        
-        //map value to [0, 1]
-        return fabs(accum);
+    float_type turbulence(const Vector3D& point, int depth = 7) const {
+        //weighted sum of the frequencies of point, mapped to [0, 1] by the turbulence kernel
+        Kernels::PerlinTables tables {random_vecs[0].m_vec.data(), sizeof(Vector3D) / sizeof(float_type), 
+                                      perm_x.data(), perm_y.data(), perm_z.data()};
+        return Kernels::active().perlin_turbulence(tables, point.x(), point.y(), point.z(), depth);
     }
 
 private:   
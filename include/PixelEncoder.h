@@ -0,0 +1,89 @@
+#ifndef PIXELENCODER_H
+#define PIXELENCODER_H
+
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include "Constants.h"
+
+/**
+ * @brief Encodes gamma corrected pixel components as the ASCII text of a .ppm image, without allocating.
+ * Every pixel is written as exactly pixel_size characters: each component left aligned in a field of
+ * max_pixel_val_digits characters and followed by a space, except for the last which is followed by a newline.
+ * The text of every component value is looked up in a table, so encoding a pixel is 3 fixed size copies.
+ *
+ */
+class PixelEncoder {
+public:
+    constexpr static int field_size = ColorConstants::max_pixel_val_digits + 1;       //the digits and separator of a component
+    constexpr static int pixel_size = ColorConstants::num_components * field_size;
+
+    /**
+     * @brief Writes the text of a pixel to destination.
+     * Components outside of 0 to ColorConstants::max_pixel_val are clamped to it.
+     *
+     * @param components the gamma corrected R, G and B values of the pixel
+     * @param destination where the pixel_size characters of the pixel are written
+     */
+    static void encode_pixel(const int* components, char* destination) {
+        for (int c = 0; c < ColorConstants::num_components; ++c) {
+            int value = std::clamp(components[c], 0, ColorConstants::max_pixel_val);
+            const Table& fields = table(c == ColorConstants::num_components - 1);
+            std::memcpy(destination + c * field_size, fields[static_cast<std::size_t>(value)].data(), field_size);
+        }
+    }
+
+    /**
+     * @brief Writes the text of a row of consecutive pixels to destination.
+     *
+     * @param components the gamma corrected R, G and B values of every pixel, one pixel after another
+     * @param count the number of pixels
+     * @param destination where the count * pixel_size characters of the pixels are written
+     */
+    static void encode_row(const int* components, std::size_t count, char* destination) {
+        for (std::size_t i = 0; i < count; ++i) {
+            encode_pixel(components + ColorConstants::num_components * i, destination + pixel_size * i);
+        }
+    }
+
+private:
+    using Field = std::array<char, field_size>;
+    using Table = std::array<Field, ColorConstants::max_pixel_val + 1>;
+
+    /**
+     * @brief Builds the text of every component value, left aligned and padded with spaces.
+     *
+     * @param separator the character that ends every field
+     * @return Table the fields, indexed by component value
+     */
+    constexpr static Table make_table(char separator) {
+        Table table {};
+        for (int value = 0; value <= ColorConstants::max_pixel_val; ++value) {
+            Field& field = table[static_cast<std::size_t>(value)];
+            field.fill(' ');
+            int digits = 1;
+            for (int rest = value / 10; rest > 0; rest /= 10) {
+                ++digits;
+            }
+            for (int d = digits - 1, rest = value; d >= 0; --d, rest /= 10) {
+                field[static_cast<std::size_t>(d)] = static_cast<char>('0' + rest % 10);
+            }
+            field[field_size - 1] = separator;
+        }
+        return table;
+    }
+
+    /**
+     * @brief Returns the fields of every component value.
+     *
+     * @param last whether the fields end the pixel
+     * @return const Table& the fields, indexed by component value
+     */
+    static const Table& table(bool last) {
+        constexpr static Table fields = make_table(' ');
+        constexpr static Table last_fields = make_table('\n');
+        return last ? last_fields : fields;
+    }
+};
+
+#endif
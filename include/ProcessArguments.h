@@ -2,15 +2,62 @@
 #define PROCESSARGUMENTS_H
 
 #include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <cstring>
+#include <limits>
 #include <string>
+#include <stdexcept>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <random>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include "RenderSettings.h"
+#include "Kernels.h"
 
 /**
- * @brief Extracts the desired filename from the main argument. 
- * 
+ * @brief The options that the ray tracer was invoked with.
+ *
+ */
+struct RenderOptions {
+    std::string filename {};        //the .ppm filename with relative path
+    RenderSettings render_settings {};
+    std::string trace_filename {};  //where the Chrome trace-event JSON is written. empty disables tracing
+    std::optional<Kernels::Isa> isa {};     //forces the kernels of an instruction set. detected from the CPU if empty
+    std::string worker_address {};  //the coordinator that tiles are rendered for instead of an image. empty renders an image
+    bool scaling = false;           //render with 1 to every local worker in turn, and report the scaling efficiency
+};
+
+/**
+ * @brief The options that partial renders are merged with.
+ *
+ */
+struct MergeOptions {
+    std::string filename {};                    //the .ppm filename with relative path
+    std::vector<std::string> partial_filenames {};  //the partial render files, with path and extension
+};
+
+/**
+ * @brief The options that the render server is started with.
+ *
+ */
+struct ServeOptions {
+    std::string address {};             //unix:<path> or localhost:<port> that the server listens on
+    std::size_t scene_capacity = 4;     //the built worlds that are kept
+    std::size_t texture_capacity = 8;   //the decoded textures that are kept
+    std::string output_directory = "..";    //the out paths of requests are relative to it, like the images of the other commands
+};
+
+/**
+ * @brief Extracts the desired filename from the main argument.
+ *
  * @param argv a filename. Must not contain a '.', to avoid user provided extensions.
  * @return std::string that is the extensionless filename
  */
@@ -26,23 +73,419 @@ inline std::string extract_filename(char *argv[]) {
 }
 
 /**
- * @brief Takes the main argument, returns a .ppm filename with relative path.
- * Throws an error if main is provided more than one argument, or the file contains a '.'.
- * 
+ * @brief Returns the usage message of the program.
+ *
+ * @param program_name the name the program was invoked with (argv[0])
+ * @return std::string the usage message
+ */
+inline std::string usage(const std::string& program_name) {
+    return "Usage: " + program_name + " <output_filename> [options]\n"
+           "       " + program_name + " merge <output_filename> <partial>...\n"
+           "       " + program_name + " serve <unix:path|localhost:port> [--scenes <n>] [--textures <n>] [--output-dir <dir>]\n"
+           "       " + program_name + " submit <address> render scene=<name> out=<path>.ppm [spp=<n>] [seed=<n>] [priority=<n>]\n"
+           "                                 [crop=x0,y0,x1,y1] [camera=cx,cy,cz,tx,ty,tz[,vfov]] | status | shutdown\n"
+           "Options:\n"
+           "  --spp <n>                  target samples per pixel (default: the scene's samples_per_pixel)\n"
+           "  --pass-spp <n>             samples added to every pixel per progressive pass\n"
+           "  --checkpoint-passes <n>    write a preview image and checkpoint every n passes\n"
+           "  --checkpoint-seconds <s>   write a preview image and checkpoint every s seconds\n"
+           "  --resume                   continue from the checkpoint of <output_filename> if it exists\n"
+           "  --time-budget <s>          keep adding passes until s seconds have passed (--spp becomes a cap)\n"
+           "  --trace                    write phase and per-tile spans to <output_filename>.trace.json\n"
+           "  --heatmap                  also write per-pixel cost heatmaps to <output_filename>_heat_<metric>.ppm\n"
+           "  --seed <n>                 make the world and render deterministic\n"
+           "  --packets                  trace camera rays in packets of 4x4 pixels\n"
+           "  --wavefront                trace the paths of each tile breadth-first, shading hits grouped by material\n"
+           "  --denoise                  filter the noise out of the final image, guided by first-hit albedo and normals\n"
+           "  --aov                      also write depth, normal, albedo, id and sample count channels to <output_filename>.aov\n"
+           "  --exr                      also write the image as OpenEXR to <output_filename>.exr, with any --aov channels\n"
+           "  --exr-type <half|float>    the pixel type of the OpenEXR color channels (default: half)\n"
+           "  --exr-compression <c>      none or rle (default: rle)\n"
+           "  --stream <path|->          stream the image row by row to a pipe, FIFO or stdout (-) instead of the .ppm file\n"
+           "  --crop <x0,y0,x1,y1>       only render the columns x0 to x1 and rows y0 to y1 (exclusive) of the image\n"
+           "  --crop-full                write the whole image, black outside of --crop, instead of only the crop\n"
+           "  --workers <n>              render the tiles on n local worker processes, merging their results\n"
+           "  --listen <address>         also accept workers at unix:<path> or <host>:<port>, e.g. from other hosts\n"
+           "  --worker <address>         render tiles for the coordinator at address instead of an image\n"
+           "  --scaling                  with --workers n, render with 1 to n workers and report the scaling efficiency\n"
+           "  --sample-range <a>,<b>     only take samples a to b (exclusive) and write their sums to <output_filename>.partial\n"
+           "  --isa <name>               use the baseline, avx2 or avx512 kernels (default: the best the CPU supports)\n"
+           "  --progress <s>             print the progress and ETA of the render on stderr every s seconds\n"
+           "                             (default: every second if stderr is a terminal)\n"
+           "  --no-progress              never print the progress of the render\n"
+           "Ctrl-C cancels the render at the next tile and writes the samples taken so far; a second Ctrl-C exits at once.";
+}
+
+/**
+ * @brief Parses the value that follows an option as a positive integer.
+ * Throws std::invalid_argument if the value is missing, not an integer or does not fit in Integer.
+ *
+ * @tparam Integer the type of the value
+ * @param argc The number of arguments passed into main.
+ * @param argv The arguments passed into main.
+ * @param i the index of the option. Advanced past the value.
+ * @return Integer the parsed value
+ */
+template <typename Integer>
+inline Integer parse_positive_integer(int argc, char *argv[], int& i) {
+    std::string option = argv[i];
+    if (i + 1 >= argc) {
+        throw std::invalid_argument(option + " requires a value");
+    }
+    std::string value = argv[++i];
+    constexpr auto max = static_cast<long long>(std::min<unsigned long long>(std::numeric_limits<Integer>::max(), std::numeric_limits<long long>::max()));
+    long long number = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc{} || end != value.data() + value.size() || number < 1 || number > max) {
+        throw std::invalid_argument(option + " requires an integer from 1 to " + std::to_string(max) + ", got '" + value + "'");
+    }
+    return static_cast<Integer>(number);
+}
+
+/**
+ * @brief Parses the value that follows an option as a positive, finite number.
+ * Throws std::invalid_argument if the value is missing or not a positive number that fits in Number.
+ *
+ * @tparam Number the floating point type of the value
+ * @param argc The number of arguments passed into main.
+ * @param argv The arguments passed into main.
+ * @param i the index of the option. Advanced past the value.
+ * @return Number the parsed value
+ */
+template <typename Number>
+inline Number parse_positive_value(int argc, char *argv[], int& i) {
+    static_assert(std::is_floating_point_v<Number>, "counts are parsed by parse_positive_integer");
+    std::string option = argv[i];
+    if (i + 1 >= argc) {
+        throw std::invalid_argument(option + " requires a value");
+    }
+    std::string value = argv[++i];
+    std::size_t parsed_length = 0;
+    double number = 0;
+    try {
+        number = std::stod(value, &parsed_length);
+    }
+    catch (const std::exception&) {
+        parsed_length = 0;
+    }
+    if (parsed_length != value.size() || !(number > 0) || !std::isfinite(number) 
+        || number > static_cast<double>(std::numeric_limits<Number>::max())) {
+        throw std::invalid_argument(option + " requires a positive number, got '" + value + "'");
+    }
+    return static_cast<Number>(number);
+}
+
+/**
+ * @brief Parses the value that follows an option as a window of pixels, written x0,y0,x1,y1:
+ * the first column and row, and the column and row past the last.
+ * Throws std::invalid_argument if the value is missing, malformed or an empty window.
+ *
+ * @param argc The number of arguments passed into main.
+ * @param argv The arguments passed into main.
+ * @param i the index of the option. Advanced past the value.
+ * @return PixelWindow the parsed window
+ */
+inline PixelWindow parse_window(int argc, char *argv[], int& i) {
+    std::string option = argv[i];
+    if (i + 1 >= argc) {
+        throw std::invalid_argument(option + " requires a value");
+    }
+    std::string value = argv[++i];
+    int bounds[4] {};
+    std::size_t position = 0;
+    bool valid = true;
+    for (int b = 0; b < 4 && valid; ++b) {
+        std::size_t parsed_length = 0;
+        try {
+            bounds[b] = std::stoi(value.substr(position), &parsed_length);
+        }
+        catch (const std::exception&) {
+            parsed_length = 0;
+        }
+        position += parsed_length;
+        char expected = (b < 3) ? ',' : '\0';
+        valid = parsed_length > 0 && bounds[b] >= 0 && (position < value.size() ? value[position] : '\0') == expected;
+        ++position;
+    }
+    PixelWindow window {bounds[0], bounds[1], bounds[2], bounds[3]};
+    if (!valid || window.empty()) {
+        throw std::invalid_argument(option + " requires x0,y0,x1,y1 with x0 < x1 and y0 < y1, got '" + value + "'");
+    }
+    return window;
+}
+
+/**
+ * @brief Parses the value that follows an option as a range of samples per pixel, written a,b: 
+ * the first sample and the sample past the last.
+ * Throws std::invalid_argument if the value is missing, malformed or an empty range.
+ *
+ * @param argc The number of arguments passed into main.
+ * @param argv The arguments passed into main.
+ * @param i the index of the option. Advanced past the value.
+ * @return std::pair<long, long> the first and past the last sample of the range
+ */
+inline std::pair<long, long> parse_sample_range(int argc, char *argv[], int& i) {
+    std::string option = argv[i];
+    if (i + 1 >= argc) {
+        throw std::invalid_argument(option + " requires a value");
+    }
+    std::string value = argv[++i];
+    long begin = -1, end = -1;
+    try {
+        std::size_t comma = value.find(',');
+        std::size_t begin_length = 0, end_length = 0;
+        begin = std::stol(value.substr(0, comma), &begin_length);
+        end = std::stol(value.substr(comma + 1), &end_length);
+        if (comma == std::string::npos || begin_length != comma || comma + 1 + end_length != value.size()) {
+            begin = end = -1;
+        }
+    }
+    catch (const std::exception&) {
+        begin = end = -1;
+    }
+    if (begin < 0 || end <= begin) {
+        throw std::invalid_argument(option + " requires a,b with 0 <= a < b, got '" + value + "'");
+    }
+    return {begin, end};
+}
+
+/**
+ * @brief Takes the arguments of the merge subcommand, returns the options of the merge.
+ * Throws an error if no output filename or partial render is provided, or the filename contains a '.'.
+ *
+ * @param argc The number of arguments passed into main.
+ * @param argv The arguments passed into main, where argv[1] is merge.
+ * @return MergeOptions the options of the merge
+ */
+inline MergeOptions process_merge_arguments(int argc, char *argv[]) {
+    if (argc < 4 || argv[2][0] == '-') {
+        throw std::invalid_argument(usage(argv[0]));
+    }
+    MergeOptions options;
+    options.filename = "../" + extract_filename(argv + 1) + ".ppm";
+    options.partial_filenames.assign(argv + 3, argv + argc);
+    return options;
+}
+
+/**
+ * @brief Takes the arguments of the serve subcommand, returns the options of the render server.
+ * Throws an error if no address is provided or an option is invalid.
+ *
+ * @param argc The number of arguments passed into main.
+ * @param argv The arguments passed into main, where argv[1] is serve.
+ * @return ServeOptions the options of the server
+ */
+inline ServeOptions process_serve_arguments(int argc, char *argv[]) {
+    if (argc < 3 || argv[2][0] == '-') {
+        throw std::invalid_argument(usage(argv[0]));
+    }
+    ServeOptions options;
+    options.address = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--scenes") {
+            options.scene_capacity = parse_positive_integer<std::size_t>(argc, argv, i);
+        }
+        else if (option == "--textures") {
+            options.texture_capacity = parse_positive_integer<std::size_t>(argc, argv, i);
+        }
+        else if (option == "--output-dir") {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option + " requires a value");
+            }
+            options.output_directory = argv[++i];
+        }
+        else {
+            throw std::invalid_argument("Unknown option '" + option + "'\n" + usage(argv[0]));
+        }
+    }
+    return options;
+}
+
+/**
+ * @brief Takes the main arguments, returns the options of the render, including a .ppm filename with relative path.
+ * Throws an error if main is not provided a filename, an option is invalid, or the file contains a '.'.
+ *
  * @param argc The number of arguments passed into main.
  * @param argv The arguments passed into main.
- * @return std::string .ppm filename with relative path
+ * @return RenderOptions the options of the render
  */
-inline std::string process_arguments(int argc, char *argv[]) {
-    if (argc != 2) {
-        throw std::invalid_argument("Usage: " + std::string(argv[0]) + " <output_filename>");
+inline RenderOptions process_arguments(int argc, char *argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        throw std::invalid_argument(usage(argv[0]));
     }
 
     std::string relative_path = "../";
     std::string file_extension = ".ppm";
-    std::string filename = relative_path + extract_filename(argv) + file_extension;
-    return filename;
+    std::string checkpoint_extension = ".ckpt";
+    std::string trace_extension = ".trace.json";
+    std::string aov_extension = ".aov";
+    std::string exr_extension = ".exr";
+    std::string socket_extension = ".sock";
+    std::string partial_extension = ".partial";
+    std::string output_stem = relative_path + extract_filename(argv);
+
+    RenderOptions options;
+    options.filename = output_stem + file_extension;
+    RenderSettings& settings = options.render_settings;
+    settings.progress_every_seconds = isatty(STDERR_FILENO) ? 1 : 0;
+    bool progressive = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--spp") {
+            settings.samples_per_pixel = parse_positive_integer<int>(argc, argv, i);
+        }
+        else if (option == "--pass-spp") {
+            settings.samples_per_pass = parse_positive_integer<int>(argc, argv, i);
+        }
+        else if (option == "--checkpoint-passes") {
+            settings.checkpoint_every_passes = parse_positive_integer<int>(argc, argv, i);
+            progressive = true;
+        }
+        else if (option == "--checkpoint-seconds") {
+            settings.checkpoint_every_seconds = parse_positive_value<float_type>(argc, argv, i);
+            progressive = true;
+        }
+        else if (option == "--time-budget") {
+            settings.time_budget_seconds = parse_positive_value<float_type>(argc, argv, i);
+        }
+        else if (option == "--trace") {
+            options.trace_filename = output_stem + trace_extension;
+        }
+        else if (option == "--heatmap") {
+            settings.heatmap_filename_stem = output_stem;
+        }
+        else if (option == "--seed") {
+            settings.seed = parse_positive_integer<unsigned int>(argc, argv, i);
+        }
+        else if (option == "--isa") {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option + " requires a value");
+            }
+            options.isa = Kernels::parse_isa(argv[++i]);
+        }
+        else if (option == "--packets") {
+            settings.packets = true;
+        }
+        else if (option == "--wavefront") {
+            settings.wavefront = true;
+        }
+        else if (option == "--denoise") {
+            settings.denoise = true;
+        }
+        else if (option == "--aov") {
+            settings.aov_filename = output_stem + aov_extension;
+        }
+        else if (option == "--exr") {
+            settings.exr_filename = output_stem + exr_extension;
+        }
+        else if (option == "--exr-type") {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option + " requires a value");
+            }
+            settings.exr.pixel_type = EXRFile::parse_pixel_type(argv[++i]);
+        }
+        else if (option == "--stream") {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option + " requires a value");
+            }
+            settings.stream_target = argv[++i];
+        }
+        else if (option == "--crop") {
+            settings.crop = parse_window(argc, argv, i);
+        }
+        else if (option == "--crop-full") {
+            settings.crop_full_size = true;
+        }
+        else if (option == "--exr-compression") {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option + " requires a value");
+            }
+            settings.exr.compression = EXRFile::parse_compression(argv[++i]);
+        }
+        else if (option == "--workers") {
+            settings.distribute.local_workers = parse_positive_integer<int>(argc, argv, i);
+        }
+        else if (option == "--listen") {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option + " requires a value");
+            }
+            settings.distribute.address = argv[++i];
+            settings.distribute.external = true;
+        }
+        else if (option == "--worker") {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option + " requires a value");
+            }
+            options.worker_address = argv[++i];
+        }
+        else if (option == "--sample-range") {
+            std::tie(settings.sample_range_begin, settings.sample_range_end) = parse_sample_range(argc, argv, i);
+            settings.partial_filename = output_stem + partial_extension;
+        }
+        else if (option == "--scaling") {
+            options.scaling = true;
+        }
+        else if (option == "--progress") {
+            settings.progress_every_seconds = parse_positive_value<float_type>(argc, argv, i);
+        }
+        else if (option == "--no-progress") {
+            settings.progress_every_seconds = 0;
+        }
+        else if (option == "--resume") {
+            settings.resume = true;
+            progressive = true;
+        }
+        else {
+            throw std::invalid_argument("Unknown option '" + option + "'\n" + usage(argv[0]));
+        }
+    }
+
+    if (settings.packets && settings.wavefront) {
+        throw std::invalid_argument("--packets and --wavefront cannot be combined");
+    }
+    if (settings.crop_full_size && !settings.cropped()) {
+        throw std::invalid_argument("--crop-full requires --crop");
+    }
+    if (settings.partial()) {
+        if (!settings.seeded()) {
+            throw std::invalid_argument("--sample-range requires --seed, so that every partial render sees the same world");
+        }
+        if (progressive || settings.samples_per_pixel > 0 || settings.crop_full_size || settings.streaming() 
+            || settings.samples_features() || settings.writes_exr() || settings.cost_heatmaps()) {
+            throw std::invalid_argument("--sample-range cannot be combined with checkpoints, --resume, --spp, --crop-full, "
+                                        "--stream, --denoise, --aov, --exr or --heatmap");
+        }
+    }
+    if (settings.distribute.local_workers > 0 && settings.distribute.address.empty()) {
+        settings.distribute.address = "unix:" + output_stem + socket_extension;
+    }
+    if (settings.distributed()) {
+        if (settings.streaming() || settings.samples_features() || settings.cost_heatmaps()) {
+            throw std::invalid_argument("--stream, --denoise, --aov and --heatmap cannot be combined with --workers or --listen");
+        }
+        settings.distribute.program = argv[0];
+        settings.distribute.output_stem = extract_filename(argv);
+        //workers build the world from the seed, so a distributed render is always seeded
+        while (!settings.seeded()) {
+            settings.seed = std::random_device{}();
+        }
+    }
+    if (options.scaling && settings.distribute.local_workers == 0) {
+        throw std::invalid_argument("--scaling requires --workers");
+    }
+    if (progressive) {
+        settings.checkpoint_filename = output_stem + checkpoint_extension;
+    }
+    if (progressive || settings.time_budgeted()) {
+        //progressive renders default to small passes so that previews, checkpoints and deadlines are frequent
+        constexpr int default_progressive_pass_samples = 4;
+        if (settings.samples_per_pass == 0) {
+            settings.samples_per_pass = default_progressive_pass_samples;
+        }
+    }
+    return options;
 }
 
 
-#endif
\ No newline at end of file
+#endif
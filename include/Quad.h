@@ -2,6 +2,8 @@
 #define QUAD_H
 
 #include <memory>
+#include <array>
+#include <bit>
 #include <cmath>
 #include "Constants.h"
 #include "Vector3D.h"
@@ -9,6 +11,9 @@
 #include "Material.h"
 #include "Hittable.h"
 #include "AABB.h"
+#include "RenderStats.h"
+#include "RayPacket.h"
+#include "Kernels.h"
 
 /**
  * @brief Represents a quadrilateral (specifically parallelogram) object that can interact with light rays.
@@ -34,7 +39,8 @@ public:
         D{unit_normal.dot(Q_)},             //Ax+By+Cz: (A,B,C) is unit normal, (x,y,z) is some point on quad (Q)
         w{u_.cross(v_) / (u_.cross(v_).dot(u_.cross(v_)))}, //p = P - Q = au + bv: a = w dot (p x v)    b = w dot (u x p)
         material_ptr{material_ptr_}, 
-        bbox{AABB{Q_, Q_+u_+v_}.pad(min_thickness)}      //Q+u+v = opposing corner of Q
+        bbox{AABB{Q_, Q_+u_+v_}.pad(min_thickness)},     //Q+u+v = opposing corner of Q
+        shape{make_shape(Q, u, v, w, unit_normal, D)}
     {}
 
     /**
@@ -46,11 +52,12 @@ public:
      * @return HitRecord The resulting collision data.
      */
     HitRecord hit(const Ray3D& ray, const Interval& t_interval) const override {
+        RenderStats::count_primitive_test(RenderStats::Primitive::quad);
         auto denominator = unit_normal.dot(ray.direction());
 
         //no hit if the ray is parallel to the plane
         constexpr float_type epsilon = 1e-8;
-        if (fabs(denominator) < epsilon) {
+        if (std::fabs(denominator) < epsilon) {
             return HitRecord{false};
         }
 
@@ -69,15 +76,36 @@ public:
             return false;
         }
 
-        //successful hit: fill in hit vector information
-        HitRecord hit_record {true};
-        hit_record.point = intersection;
-        hit_record.t  = t;
-        hit_record.u = alpha;   //planar coordinate
-        hit_record.v = beta;    //planar coordinate
-        hit_record.set_face_and_normal(ray, unit_normal);
-        hit_record.material_ptr = material_ptr;
-        return hit_record;
+        return make_hit_record(ray, intersection, t, alpha, beta);
+    }
+
+    /**
+     * @brief Intersects the active rays of a packet with the Quad at once, using the packet kernel.
+     * 
+     * @param packet the rays
+     * @param t_min the minimum travel distance of every ray
+     * @param hits the closest hit of each ray so far, updated where the Quad is closer
+     * @param active the rays to test
+     */
+    void hit_packet(const RayPacket& packet, float_type t_min, PacketHits& hits, RayPacket::Mask active) const override {
+        if (std::popcount(active) < RayPacket::min_kernel_lanes) {
+            Hittable::hit_packet(packet, t_min, hits, active);
+            return;
+        }
+        for (RayPacket::Mask lanes = active; lanes != 0; lanes &= lanes - 1) {
+            RenderStats::count_primitive_test(RenderStats::Primitive::quad);
+        }
+
+        alignas(64) std::array<float_type, RayPacket::size> t, alpha, beta;
+        RayPacket::Mask hit_lanes = Kernels::active().packet_quad(packet.rays(), shape, t_min, hits.t_max.data(), active, 
+                                                                  t.data(), alpha.data(), beta.data());
+        for (int lane = 0; lane < RayPacket::size; ++lane) {
+            if (((hit_lanes >> lane) & 1) != 0) {
+                auto l = static_cast<std::size_t>(lane);
+                hits.t_max[l] = t[l];
+                hits.records[l] = make_hit_record(packet.ray(lane), packet.ray(lane).at(t[l]), t[l], alpha[l], beta[l]);
+            }
+        }
     }
 
     /**
@@ -99,6 +127,36 @@ private:
     Vector3D w;             //useful for computing a, b in P = Q + au + bv 
     std::shared_ptr<Material> material_ptr;
     AABB bbox;
+    Kernels::QuadShape shape;   //the plane and vectors above, for the packet kernel
+    int id {next_primitive_id()};
+
+    /**
+     * @brief Fills in the hit record of a ray that hits the Quad.
+     * 
+     * @param ray the ray
+     * @param intersection the hit point
+     * @param t the travel distance of the ray to the hit point
+     * @param alpha the u coordinate of the hit point
+     * @param beta the v coordinate of the hit point
+     * @return HitRecord the hit
+     */
+    HitRecord make_hit_record(const Ray3D& ray, const Vector3D& intersection, float_type t, float_type alpha, float_type beta) const {
+        HitRecord hit_record {true};
+        hit_record.point = intersection;
+        hit_record.t  = t;
+        hit_record.u = alpha;   //planar coordinate
+        hit_record.v = beta;    //planar coordinate
+        hit_record.set_face_and_normal(ray, unit_normal);
+        hit_record.material_ptr = material_ptr;
+        hit_record.primitive_id = id;
+        return hit_record;
+    }
+
+    static Kernels::QuadShape make_shape(const Vector3D& Q, const Vector3D& u, const Vector3D& v, 
+                                         const Vector3D& w, const Vector3D& unit_normal, float_type D) {
+        return Kernels::QuadShape{{Q.x(), Q.y(), Q.z()}, {u.x(), u.y(), u.z()}, {v.x(), v.y(), v.z()}, 
+                                  {w.x(), w.y(), w.z()}, {unit_normal.x(), unit_normal.y(), unit_normal.z()}, D};
+    }
 
     /**
      * @brief Given the hit point in plane coordinates, return whether it is 
@@ -2,11 +2,13 @@
 #define RANDOM_MT_H
 
 #include <chrono>
+#include <cstdint>
 #include <random>
 #include "Constants.h"
 
-// This header-only Random namespace implements a self-seeding Mersenne Twister
+// This header-only Random namespace implements a self-seeding Mersenne Twister per thread
 // It can be included into as many code files as needed (The inline keyword avoids ODR violations)
+// Each thread seeds its own generator, so render threads never contend for (or race on) a shared one.
 namespace Random
 {
 	inline std::mt19937 init()
@@ -22,20 +24,36 @@ namespace Random
 	}
 
 	// Here's our std::mt19937 PRNG object
-	// The inline keyword also means we only have one global instance for our whole program
-	inline std::mt19937 mt{ init() };
+	// The inline keyword also means we only have one instance per thread for our whole program
+	inline thread_local std::mt19937 mt{ init() };
+
+	// Mixes value into seed (the splitmix64 finalizer), so that deterministic renders can derive
+	// well distributed, independent seeds for every pass and tile from a single seed
+	inline std::uint64_t mix_seed(std::uint64_t seed, std::uint64_t value)
+	{
+		std::uint64_t z = seed + 0x9e3779b97f4a7c15ULL * (value + 1);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	// Reseeds the generator of the calling thread
+	inline void seed(std::uint64_t seed)
+	{
+		mt.seed(static_cast<std::mt19937::result_type>(seed ^ (seed >> 32)));
+	}
 
 	// Generate a random float_type between [min, max]
 	inline float_type random_float(float_type min, float_type max)
 	{
 		std::uniform_real_distribution<float_type> distribution{ min, max };
-		return distribution(mt); // and then generate a random number from our global generator
+		return distribution(mt); // and then generate a random number from our thread's generator
 	}
 
 	// Generate a random int between [min, max]
 	inline int random_int(int min, int max) {
 		std::uniform_int_distribution<int> distribution{ min, max };
-		return distribution(mt); // and then generate a random number from our global generator
+		return distribution(mt); // and then generate a random number from our thread's generator
 	}
 };
 
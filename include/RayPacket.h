@@ -0,0 +1,82 @@
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+#include <array>
+#include <cstdint>
+#include "Constants.h"
+#include "Vector3D.h"
+#include "Ray3D.h"
+#include "AABB.h"
+#include "Kernels.h"
+
+/**
+ * @brief A packet of coherent rays, such as the camera rays of a square block of pixels,
+ * that are traced through a BVH together.
+ * The rays are also stored as a structure of arrays, so that the kernels of Kernels.h test many rays per instruction.
+ *
+ */
+class RayPacket {
+public:
+    constexpr static int width = 4;                 //packets hold the rays of width x width pixel blocks
+    constexpr static int size = width * width;      //the number of rays (lanes) in a packet
+    using Mask = std::uint32_t;                     //bit i is set if lane i is active
+    constexpr static Mask all_lanes = (Mask{1} << size) - 1;
+    constexpr static int min_kernel_lanes = 4;      //primitives test packets with fewer active lanes one ray at a time
+    static_assert(size == Kernels::packet_size, "RayPacket and the packet kernels must agree on the packet size");
+
+    /**
+     * @brief Sets the ray of a lane.
+     *
+     * @param lane the lane, from 0 to size - 1
+     * @param ray the ray
+     */
+    void set(int lane, const Ray3D& ray) {
+        auto l = static_cast<std::size_t>(lane);
+        m_rays[l] = ray;
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            m_soa.origin[axis][l] = ray.origin()[axis];
+            m_soa.direction[axis][l] = ray.direction()[axis];
+            m_soa.inverse_direction[axis][l] = 1 / ray.direction()[axis];
+        }
+    }
+
+    /**
+     * @brief Returns the ray of a lane.
+     *
+     * @param lane the lane, from 0 to size - 1
+     * @return const Ray3D& the ray
+     */
+    const Ray3D& ray(int lane) const {
+        return m_rays[static_cast<std::size_t>(lane)];
+    }
+
+    /**
+     * @brief Returns which of the active rays travel through a bounding box between t_min and their own t_max.
+     *
+     * @param box the bounding box
+     * @param t_min the minimum travel distance of every ray
+     * @param t_max the maximum travel distance of each ray, e.g. the distance to its closest hit so far
+     * @param active the rays to test
+     * @return Mask the active rays that travel through the box
+     */
+    Mask hit_box(const AABB& box, float_type t_min, const std::array<float_type, size>& t_max, Mask active) const {
+        const float_type box_min[3] = {box.x.min, box.y.min, box.z.min};
+        const float_type box_max[3] = {box.x.max, box.y.max, box.z.max};
+        return Kernels::active().packet_box(m_soa, box_min, box_max, t_min, t_max.data(), active);
+    }
+
+    /**
+     * @brief Returns the rays as a structure of arrays, for the packet kernels.
+     *
+     * @return const Kernels::PacketRays& the origins, directions and inverse directions of every lane
+     */
+    const Kernels::PacketRays& rays() const {
+        return m_soa;
+    }
+
+private:
+    std::array<Ray3D, size> m_rays {};
+    Kernels::PacketRays m_soa {};
+};
+
+#endif
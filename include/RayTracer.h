@@ -0,0 +1,154 @@
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The API of the raytracer_core library, for embedding the renderer in other programs.
+ * It only exposes plain types, so programs that use it do not compile the renderer's headers,
+ * and include/raytracer_c.h wraps it for C and other languages.
+ *
+ */
+namespace RayTracer {
+
+/**
+ * @brief Returns the names of the scenes that can be built.
+ *
+ * @return std::vector<std::string> the names, as in SceneInfo.h
+ */
+std::vector<std::string> scene_names();
+
+/**
+ * @brief The pixels of a rectangle of an image. The minimums are inclusive and the maximums exclusive.
+ *
+ */
+struct Window {
+    int col_min = 0;
+    int row_min = 0;
+    int col_max = 0;
+    int row_max = 0;
+};
+
+/**
+ * @brief What to render, and how.
+ *
+ */
+struct RenderRequest {
+    int samples_per_pixel = 0;          //0 uses the scene's samples_per_pixel
+    int samples_per_pass = 0;           //samples added to every pixel between progress reports. 0 renders them in one pass
+    float time_budget_seconds = 0;      //stop before the next pass would end after this much time. 0 has no budget
+    unsigned int seed = 0;              //makes the render deterministic. 0 leaves the generators self-seeded
+    bool crop = false;                  //only render the pixels of crop_window
+    Window crop_window {};
+    bool packets = false;               //trace camera rays in packets of coherent rays
+    bool wavefront = false;             //trace the paths of each tile breadth-first, in waves of rays
+};
+
+/**
+ * @brief How far a render has got, reported after every pass.
+ *
+ */
+struct Progress {
+    long samples_per_pixel = 0;         //the samples that every pixel has received
+    long target_samples = 0;            //the samples per pixel that the render stops at. 0 if only a time budget stops it
+    double elapsed_seconds = 0;
+};
+
+using ProgressCallback = std::function<void(const Progress&)>;
+
+/**
+ * @brief Stops a render at its next tile when cancelled, from any thread.
+ *
+ */
+class CancelToken {
+public:
+    void cancel() {m_cancelled.store(true, std::memory_order_relaxed);}
+    bool cancelled() const {return m_cancelled.load(std::memory_order_relaxed);}
+    const std::atomic<bool>& flag() const {return m_cancelled;}
+
+private:
+    std::atomic<bool> m_cancelled {false};
+};
+
+/**
+ * @brief A rendered image, as 8 bit gamma corrected R, G and B components of every pixel in raster order.
+ *
+ */
+struct Image {
+    int width = 0;
+    int height = 0;
+    long samples_per_pixel = 0;         //fewer than requested if the render was cancelled or ran out of time
+    bool cancelled = false;
+    std::vector<std::uint8_t> rgb {};
+};
+
+/**
+ * @brief A built scene: its world inside a Bounding Volume Hierarchy and its camera.
+ * Copies share the same world, which any number of threads may render at once.
+ *
+ */
+class Scene {
+public:
+    /**
+     * @brief Builds the scene named name.
+     * Throws std::invalid_argument if there is no such scene, and std::runtime_error if its textures cannot be loaded.
+     *
+     * @param name the name of the scene, one of scene_names()
+     * @param seed if not 0, the seed that the random parts of the world are built from, as with --seed
+     * @return Scene the scene
+     */
+    static Scene build(const std::string& name, unsigned int seed = 0);
+
+    const std::string& name() const;
+    int width() const;
+    int height() const;
+
+    /**
+     * @brief Progressively renders an image of the scene into memory.
+     * Throws std::invalid_argument if the crop window does not fit in the image.
+     *
+     * @param request what to render, and how.
+     * @param progress if set, called on the rendering thread after every pass.
+     * @param cancel if not null, checked before every tile. A cancelled render returns the samples taken so far.
+     * @return Image the image, the size of the crop window if there is one
+     */
+    Image render(const RenderRequest& request, const ProgressCallback& progress = {}, const CancelToken* cancel = nullptr) const;
+
+    struct Impl;    //the world and camera of a scene type, defined in src/core/RayTracer.cpp
+
+private:
+    explicit Scene(std::shared_ptr<const Impl> impl) : m_impl{std::move(impl)} {}
+
+    std::shared_ptr<const Impl> m_impl;
+};
+
+/**
+ * @brief Runs a render server at address until a client shuts it down. See RenderServer.h for its protocol.
+ *
+ * Throws std::invalid_argument if address is not a Unix socket or a loopback address, since clients are not authenticated.
+ *
+ * @param address unix:<path> or localhost:<port>
+ * @param scene_capacity the number of built scenes that are kept
+ * @param texture_capacity the number of decoded texture files that are kept
+ * @param output_directory the directory that the out paths of requests are relative to. Images are never written outside of it.
+ */
+void serve(const std::string& address, std::size_t scene_capacity, std::size_t texture_capacity, const std::string& output_directory);
+
+/**
+ * @brief Sends a request line to the render server at address and copies its replies to out, until it closes the connection.
+ * Throws std::runtime_error if the server cannot be reached.
+ *
+ */
+void submit(const std::string& address, const std::string& request, std::ostream& out);
+
+}
+
+#endif
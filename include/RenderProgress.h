@@ -0,0 +1,146 @@
+#ifndef RENDERPROGRESS_H
+#define RENDERPROGRESS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "TimeFunction.h"
+
+/**
+ * @brief Counts the tiles and pixel samples of a render as threads finish them, and estimates when it will be done.
+ * Any thread may read the counts while the render runs.
+ *
+ */
+class RenderProgress {
+public:
+    /**
+     * @brief Resets the counts and starts timing a render.
+     *
+     * @param total_samples the pixel samples that the render takes when it is done, or 0 if only a time budget ends it.
+     * @param time_budget_seconds the time budget of the render, or 0 if it has none.
+     */
+    void start(long long total_samples, double time_budget_seconds) {
+        m_tiles.store(0, std::memory_order_relaxed);
+        m_samples.store(0, std::memory_order_relaxed);
+        m_total_samples = total_samples;
+        m_time_budget_seconds = time_budget_seconds;
+        m_stopwatch.reset();
+    }
+
+    /**
+     * @brief Records that a tile has been rendered. Safe to call from any thread.
+     *
+     * @param samples the pixel samples taken for the tile: its pixels times the samples of every pixel.
+     */
+    void add_tile(long long samples) {
+        m_tiles.fetch_add(1, std::memory_order_relaxed);
+        m_samples.fetch_add(samples, std::memory_order_relaxed);
+    }
+
+    long tiles() const {return m_tiles.load(std::memory_order_relaxed);}
+    long long samples() const {return m_samples.load(std::memory_order_relaxed);}
+    double elapsed_seconds() const {return m_stopwatch.elapsed_seconds();}
+
+    /**
+     * @brief Returns how much of the render is done: by samples, or by time if only a time budget ends it.
+     *
+     * @return double the fraction done, from 0 to 1
+     */
+    double fraction() const {
+        double by_samples = m_total_samples > 0 ? static_cast<double>(samples()) / static_cast<double>(m_total_samples) : 0;
+        double by_time = m_time_budget_seconds > 0 ? elapsed_seconds() / m_time_budget_seconds : 0;
+        return std::clamp(std::max(by_samples, by_time), 0.0, 1.0);
+    }
+
+    /**
+     * @brief Estimates the time left from the rate that the render has been going at.
+     *
+     * @return double the seconds left, or a negative number until there is enough to estimate from
+     */
+    double eta_seconds() const {
+        double done = fraction();
+        return done > 0 ? elapsed_seconds() * (1 - done) / done : -1;
+    }
+
+    /**
+     * @brief Returns a line that describes the progress, such as "Progress: 42.0% (96 tiles) 3.1 s elapsed, ETA 4.3 s".
+     *
+     * @return std::string the line, without a newline
+     */
+    std::string line() const {
+        char text[128];
+        double eta = eta_seconds();
+        int length = std::snprintf(text, sizeof(text), "Progress: %5.1f%% (%ld tiles) %.1f s elapsed, ETA ",
+                                   100 * fraction(), tiles(), elapsed_seconds());
+        if (eta < 0) {
+            std::snprintf(text + length, sizeof(text) - static_cast<std::size_t>(length), "?");
+        }
+        else {
+            std::snprintf(text + length, sizeof(text) - static_cast<std::size_t>(length), "%.1f s", eta);
+        }
+        return text;
+    }
+
+private:
+    std::atomic<long> m_tiles {0};
+    std::atomic<long long> m_samples {0};
+    long long m_total_samples = 0;
+    double m_time_budget_seconds = 0;
+    Stopwatch m_stopwatch;
+};
+
+/**
+ * @brief Prints the progress of a render on stderr from a thread of its own, once every interval,
+ * overwriting the same line, until it is destroyed.
+ *
+ */
+class ProgressReporter {
+public:
+    /**
+     * @brief Construct a new Progress Reporter object, which starts reporting.
+     *
+     * @param progress the progress of the render.
+     * @param interval_seconds the time between reports.
+     */
+    ProgressReporter(const RenderProgress& progress, double interval_seconds) :
+        m_progress{progress},
+        m_thread{[this, interval = std::chrono::duration<double>(interval_seconds)] {
+            std::unique_lock lock {m_mutex};
+            while (!m_condition.wait_for(lock, interval, [this] {return m_stopped;})) {
+                std::fprintf(stderr, "\r%s   ", m_progress.line().c_str());
+            }
+        }}
+    {}
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+    /**
+     * @brief Stops reporting, and prints the final progress on a line of its own.
+     *
+     */
+    ~ProgressReporter() {
+        {
+            std::lock_guard lock {m_mutex};
+            m_stopped = true;
+        }
+        m_condition.notify_one();
+        m_thread.join();
+        std::fprintf(stderr, "\r%s   \n", m_progress.line().c_str());
+    }
+
+private:
+    const RenderProgress& m_progress;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopped = false;
+    std::thread m_thread;   //started last, once the members it uses exist
+};
+
+#endif
@@ -0,0 +1,493 @@
+#ifndef RENDERSERVER_H
+#define RENDERSERVER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include "HittableList.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "SceneInfo.h"
+#include "Random.h"
+#include "RenderSettings.h"
+#include "TimeFunction.h"
+#include "Distributed.h"
+#include "rtw_stb_image.h"
+
+// This header-only RenderServer namespace renders jobs for clients of a long running process, so that a scene
+// is built and its textures are decoded once instead of by every render. Clients connect to a Unix domain socket
+// (unix:<path>) or a TCP port on a loopback address (localhost:<port>) and send one request line:
+//   render scene=<name> out=<path>.ppm [spp=<n>] [seed=<n>] [priority=<n>] [crop=x0,y0,x1,y1] [camera=cx,cy,cz,tx,ty,tz[,vfov]]
+//   status
+//   shutdown
+// A render is queued by priority, highest first and in order of arrival within a priority, and the server
+// replies "queued <id>" and then "done <id> ..." or "error <id> ..." when it has run. The out path is relative to the
+// output directory of the server, which images cannot be written outside of. Every connection is read on a thread
+// of its own, and one that sends no request in time is dropped. Jobs run one at a time,
+// each on every hardware thread. Built worlds are kept in a SceneCache by the scene and seed they were built
+// from, and rebuilt if the content of a texture they loaded has changed since; decoded textures are kept by
+// content hash in the rtw_image_cache.
+namespace RenderServer
+{
+	// Calls function with a value of the scene tag of AllScenes named name. Returns false if there is none
+	template <typename Function, typename... Scenes>
+	bool with_scene(SceneList<Scenes...>, const std::string& name, const Function& function)
+	{
+		return ((name == scene_name<Scenes> ? (function(Scenes{}), true) : false) || ...);
+	}
+
+	// A render requested by a client, who is sent its outcome
+	struct Job
+	{
+		long id = 0;
+		int priority = 0;
+		std::string scene {};
+		std::string output {};
+		RenderSettings settings {};
+		std::optional<CameraPose> pose {};
+		Distributed::Socket client {};
+		Stopwatch queued {};
+	};
+
+	// Whether a job runs before another: a higher priority, then an earlier arrival
+	inline bool runs_after(const Job& a, const Job& b)
+	{
+		return a.priority != b.priority ? a.priority < b.priority : a.id > b.id;
+	}
+
+	// Parses a list of count numbers separated by commas, or the first min_count of them, that a float_type can hold.
+	// Throws std::invalid_argument if value is not such a list
+	inline std::vector<double> parse_numbers(const std::string& key, const std::string& value, std::size_t min_count, std::size_t count)
+	{
+		std::vector<double> numbers;
+		std::stringstream stream {value};
+		std::string number;
+		while (std::getline(stream, number, ','))
+		{
+			std::size_t length = 0;
+			try
+			{
+				numbers.push_back(std::stod(number, &length));
+			}
+			catch (const std::exception&)
+			{
+				length = 0;
+			}
+			if (length == 0 || length != number.size() || !std::isfinite(numbers.back())
+				|| std::fabs(numbers.back()) > std::numeric_limits<float_type>::max())
+				throw std::invalid_argument(key + " requires numbers separated by commas, got '" + value + "'");
+		}
+		if (numbers.size() < min_count || numbers.size() > count)
+			throw std::invalid_argument(key + " requires " + std::to_string(count) + " numbers, got '" + value + "'");
+		return numbers;
+	}
+
+	// Parses a list of count integers from min to max separated by commas.
+	// Throws std::invalid_argument if value is not such a list
+	inline std::vector<long long> parse_integers(const std::string& key, const std::string& value, std::size_t count, long long min, long long max)
+	{
+		std::vector<long long> integers;
+		std::stringstream stream {value};
+		std::string number;
+		while (std::getline(stream, number, ','))
+		{
+			long long integer = 0;
+			auto [end, error] = std::from_chars(number.data(), number.data() + number.size(), integer);
+			if (error != std::errc{} || end != number.data() + number.size() || integer < min || integer > max)
+				throw std::invalid_argument(key + (count == 1 ? " requires an integer from " : " requires integers separated by commas from ")
+											+ std::to_string(min) + " to " + std::to_string(max) + ", got '" + value + "'");
+			integers.push_back(integer);
+		}
+		if (integers.size() != count)
+			throw std::invalid_argument(key + " requires " + std::to_string(count) + " integers, got '" + value + "'");
+		return integers;
+	}
+
+	// Parses the key=value words of a render request into a job.
+	// Throws std::invalid_argument if a word is unknown or malformed, or the scene or output is missing
+	inline Job parse_job(std::istream& words)
+	{
+		Job job;
+		std::string word;
+		while (words >> word)
+		{
+			std::size_t equals = word.find('=');
+			if (equals == std::string::npos)
+				throw std::invalid_argument("expected key=value, got '" + word + "'");
+			std::string key = word.substr(0, equals);
+			std::string value = word.substr(equals + 1);
+			if (key == "scene")
+				job.scene = value;
+			else if (key == "out")
+				job.output = value;
+			else if (key == "spp")
+				job.settings.samples_per_pixel = static_cast<int>(parse_integers(key, value, 1, 0, std::numeric_limits<int>::max())[0]);
+			else if (key == "seed")
+				job.settings.seed = static_cast<unsigned int>(parse_integers(key, value, 1, 0, std::numeric_limits<unsigned int>::max())[0]);
+			else if (key == "priority")
+				job.priority = static_cast<int>(parse_integers(key, value, 1, std::numeric_limits<int>::min(), std::numeric_limits<int>::max())[0]);
+			else if (key == "crop")
+			{
+				std::vector<long long> bounds = parse_integers(key, value, 4, 0, std::numeric_limits<int>::max());
+				job.settings.crop = PixelWindow{static_cast<int>(bounds[0]), static_cast<int>(bounds[1]), static_cast<int>(bounds[2]), static_cast<int>(bounds[3])};
+				if (job.settings.crop.empty())
+					throw std::invalid_argument("crop requires x0 < x1 and y0 < y1, got '" + value + "'");
+			}
+			else if (key == "camera")
+			{
+				std::vector<double> pose = parse_numbers(key, value, 6, 7);
+				job.pose = CameraPose{Vector3D{static_cast<float_type>(pose[0]), static_cast<float_type>(pose[1]), static_cast<float_type>(pose[2])},
+									  Vector3D{static_cast<float_type>(pose[3]), static_cast<float_type>(pose[4]), static_cast<float_type>(pose[5])},
+									  pose.size() == 7 ? static_cast<float_type>(pose[6]) : 0};
+				if (pose.size() == 7 && !(pose[6] > 0 && pose[6] < 180))
+					throw std::invalid_argument("camera requires a vfov between 0 and 180 degrees, got '" + value + "'");
+			}
+			else
+				throw std::invalid_argument("unknown key '" + key + "'");
+		}
+		if (!with_scene(AllScenes{}, job.scene, [](auto) {}))
+			throw std::invalid_argument("unknown scene '" + job.scene + "'");
+		if (job.pose)
+		{
+			//the camera basis is built from the view direction and the up direction of the scene, which must not be parallel
+			with_scene(AllScenes{}, job.scene, [&](auto scene) {
+				Vector3D side = CameraParameters<decltype(scene)>::camera_up_direction.cross(job.pose->target - job.pose->center);
+				if (!(side.length_squared() > 0) || !std::isfinite(side.length_squared()))
+					throw std::invalid_argument("camera requires a target away from the center, and not straight above or below it");
+			});
+		}
+		if (job.output.size() < 4 || job.output.compare(job.output.size() - 4, 4, ".ppm") != 0)
+			throw std::invalid_argument("out requires a path ending in .ppm");
+		return job;
+	}
+
+	// Returns the path of the out file of a request in directory.
+	// Throws std::invalid_argument if out is absolute or leaves directory through ..
+	inline std::string output_path(const std::filesystem::path& directory, const std::string& out)
+	{
+		std::filesystem::path path {out};
+		bool escapes = path.is_absolute() || path.has_root_name()
+					|| std::any_of(path.begin(), path.end(), [](const std::filesystem::path& part) { return part == ".."; });
+		if (escapes)
+			throw std::invalid_argument("out must be a path inside the output directory of the server, got '" + out + "'");
+		return (directory / path).string();
+	}
+
+	// Built worlds, keyed by a hash of the scene and seed they were built from. The least recently used are
+	// dropped once there are more than capacity, and a world whose textures have changed on disk is rebuilt
+	class SceneCache
+	{
+	public:
+		explicit SceneCache(std::size_t capacity) : m_capacity{capacity} {}
+
+		// Returns the world of Scene built from seed, building it if it is not cached. Sets hit to whether it was
+		template <typename Scene>
+		std::shared_ptr<const HittableList> world(unsigned int seed, bool& hit)
+		{
+			std::uint64_t key = rtw_image_cache::hash(std::string{scene_name<Scene>} + '#' + std::to_string(seed));
+			for (auto entry = m_entries.begin(); entry != m_entries.end(); ++entry)
+			{
+				if (entry->key != key)
+					continue;
+				hit = std::all_of(entry->textures.begin(), entry->textures.end(), rtw_image_cache::unchanged);
+				if (!hit)
+				{
+					m_entries.erase(entry);
+					break;
+				}
+				m_entries.splice(m_entries.begin(), m_entries, entry);
+				return entry->world;
+			}
+			hit = false;
+			rtw_image_cache::load_recorder textures;
+			if (seed != 0)
+				Random::seed(seed);
+			HittableList world;
+			{
+				Trace::ScopedTimer timer {"make_world"};
+				world = make_world<Scene>();
+			}
+			{
+				Trace::ScopedTimer timer {"build_bvh"};
+				world = HittableList{std::make_shared<BVH_node>(world)};
+			}
+			m_entries.push_front(Entry{key, std::make_shared<const HittableList>(std::move(world)), textures.loaded_files()});
+			while (m_entries.size() > m_capacity)
+				m_entries.pop_back();
+			return m_entries.front().world;
+		}
+
+		std::size_t size() const { return m_entries.size(); }
+
+	private:
+		struct Entry
+		{
+			std::uint64_t key;
+			std::shared_ptr<const HittableList> world;
+			std::vector<rtw_image_cache::loaded_file> textures;		// the texture files that the world loaded
+		};
+
+		std::size_t m_capacity;
+		std::list<Entry> m_entries {};		// most recently used first
+	};
+
+	// Sends a line to a client. A client that has gone away is not an error
+	inline void reply(const Distributed::Socket& client, const std::string& line)
+	{
+		std::string message = line + '\n';
+		Distributed::send_all(client.fd(), message.data(), message.size());
+	}
+
+	// Receives a line of up to max_length characters from a client, without the newline. Returns false if there is none
+	inline bool receive_line(const Distributed::Socket& client, std::string& line)
+	{
+		constexpr std::size_t max_length = 4096;
+		line.clear();
+		char c = 0;
+		while (line.size() < max_length && Distributed::receive_all(client.fd(), &c, 1) && c != '\n')
+			line += c;
+		return c == '\n' || !line.empty();
+	}
+
+	// Returns whether a listening socket only accepts connections from this machine: a Unix socket or a loopback address
+	inline bool is_local(const Distributed::Socket& listener)
+	{
+		sockaddr_storage address {};
+		socklen_t length = sizeof(address);
+		if (getsockname(listener.fd(), reinterpret_cast<sockaddr*>(&address), &length) != 0)
+			return false;
+		if (address.ss_family == AF_UNIX)
+			return true;
+		if (address.ss_family == AF_INET)
+			return (ntohl(reinterpret_cast<const sockaddr_in&>(address).sin_addr.s_addr) >> 24) == 127;
+		if (address.ss_family == AF_INET6)
+			return IN6_IS_ADDR_LOOPBACK(&reinterpret_cast<const sockaddr_in6&>(address).sin6_addr);
+		return false;
+	}
+
+	// Accepts requests on a socket and runs the queued renders on a thread of their own, until it is shut down
+	class Server
+	{
+	public:
+		// Listens on address, writing images under output_directory. Throws std::invalid_argument if address is
+		// not a Unix socket or a loopback address, and std::runtime_error if it cannot listen or there is no such directory
+		Server(const std::string& address, std::size_t scene_capacity, std::size_t texture_capacity, const std::string& output_directory) :
+			m_address{address},
+			m_listener{Distributed::listen_on(address)},
+			m_output_directory{output_directory},
+			m_scenes{scene_capacity}
+		{
+			if (!is_local(m_listener))
+				throw std::invalid_argument("Error: the render server has no authentication, so it only listens on unix:<path> "
+											"or a loopback address such as localhost:<port>, not " + address);
+			if (!std::filesystem::is_directory(m_output_directory))
+				throw std::runtime_error("Error: the output directory " + output_directory + " does not exist");
+			rtw_image_cache::set_capacity(texture_capacity);
+		}
+
+		~Server()
+		{
+			if (std::string path = Distributed::unix_path(m_address); !path.empty())
+				unlink(path.c_str());
+		}
+
+		// Serves requests until a shutdown request, then finishes the queued renders
+		void run()
+		{
+			std::cout << "Render server: listening on " << m_address << ", writing images under " << m_output_directory.string() << std::endl;
+			std::thread renderer {&Server::render_jobs, this};
+			while (!stopping())
+			{
+				pollfd listener {m_listener.fd(), POLLIN, 0};
+				constexpr int poll_timeout_ms = 200;	// how soon a shutdown request stops the accepting
+				if (poll(&listener, 1, poll_timeout_ms) <= 0)
+					continue;
+				Distributed::Socket client {accept4(m_listener.fd(), nullptr, nullptr, SOCK_CLOEXEC)};
+				if (client.fd() == -1)
+					continue;
+				std::lock_guard lock {m_mutex};
+				if (m_connections == max_connections)
+					continue;
+				timeval timeout {request_timeout_seconds, 0};
+				setsockopt(client.fd(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+				++m_connections;
+				std::thread{&Server::serve_connection, this, std::move(client)}.detach();
+			}
+			{
+				std::unique_lock lock {m_mutex};
+				m_connections_changed.wait(lock, [this] { return m_connections == 0; });
+			}
+			m_jobs_changed.notify_one();
+			renderer.join();
+			std::cout << "Render server: stopped" << std::endl;
+		}
+
+	private:
+		constexpr static int request_timeout_seconds = 10;		// a client that sends no request line in this time is dropped
+		constexpr static int max_connections = 64;				// more are closed at once
+
+		std::string m_address;
+		Distributed::Socket m_listener;
+		std::filesystem::path m_output_directory;
+		SceneCache m_scenes;			// only used by the render thread
+		std::mutex m_mutex;
+		std::condition_variable m_jobs_changed;
+		std::condition_variable m_connections_changed;
+		std::vector<Job> m_queue {};	// a heap ordered by runs_after
+		long m_next_id = 1;
+		long m_jobs_done = 0;
+		int m_connections = 0;			// the connections whose request is being read
+		bool m_stopping = false;
+
+		bool stopping()
+		{
+			std::lock_guard lock {m_mutex};
+			return m_stopping;
+		}
+
+		// Reads and handles the request of a connection, on a thread of its own
+		void serve_connection(Distributed::Socket client)
+		{
+			std::string line;
+			if (receive_line(client, line))
+				handle_request(std::move(client), line);
+			//notified under the lock, so that run cannot return before this thread is done with the server
+			std::lock_guard lock {m_mutex};
+			--m_connections;
+			m_connections_changed.notify_one();
+		}
+
+		void handle_request(Distributed::Socket client, const std::string& line)
+		{
+			std::istringstream words {line};
+			std::string command;
+			words >> command;
+			if (command == "shutdown")
+			{
+				{
+					std::lock_guard lock {m_mutex};
+					m_stopping = true;
+				}
+				reply(client, "stopping after the queued jobs");
+				return;
+			}
+			if (command == "status")
+			{
+				auto [hits, misses] = rtw_image_cache::hits_and_misses();
+				std::lock_guard lock {m_mutex};
+				reply(client, "queued " + std::to_string(m_queue.size()) + " done " + std::to_string(m_jobs_done) +
+							  " texture_hits " + std::to_string(hits) + " texture_misses " + std::to_string(misses));
+				return;
+			}
+			if (command != "render")
+			{
+				reply(client, "error unknown request '" + command + "', expected render, status or shutdown");
+				return;
+			}
+			try
+			{
+				Job job = parse_job(words);
+				job.output = output_path(m_output_directory, job.output);
+				std::lock_guard lock {m_mutex};
+				if (m_stopping)
+					throw std::invalid_argument("the server is stopping");
+				job.id = m_next_id++;
+				reply(client, "queued " + std::to_string(job.id));
+				job.client = std::move(client);
+				job.queued.reset();
+				m_queue.push_back(std::move(job));
+				std::push_heap(m_queue.begin(), m_queue.end(), runs_after);
+			}
+			catch (const std::invalid_argument& error)
+			{
+				reply(client, std::string{"error "} + error.what());
+				return;
+			}
+			m_jobs_changed.notify_one();
+		}
+
+		// Runs the queued jobs in order, until the server stops and the queue is empty
+		void render_jobs()
+		{
+			while (true)
+			{
+				Job job;
+				{
+					std::unique_lock lock {m_mutex};
+					m_jobs_changed.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+					if (m_queue.empty())
+						return;
+					std::pop_heap(m_queue.begin(), m_queue.end(), runs_after);
+					job = std::move(m_queue.back());
+					m_queue.pop_back();
+				}
+				try
+				{
+					with_scene(AllScenes{}, job.scene, [&](auto scene) { render_job<decltype(scene)>(job); });
+				}
+				catch (const std::exception& error)
+				{
+					std::cout << "Job " << job.id << " failed: " << error.what() << std::endl;
+					reply(job.client, "error " + std::to_string(job.id) + ' ' + error.what());
+				}
+				std::lock_guard lock {m_mutex};
+				++m_jobs_done;
+			}
+		}
+
+		template <typename Scene>
+		void render_job(const Job& job)
+		{
+			Stopwatch ready_time;
+			bool cached = false;
+			std::shared_ptr<const HittableList> world = m_scenes.world<Scene>(job.settings.seed, cached);
+			CameraPose pose = CameraPose::of<Scene>();
+			if (job.pose)
+			{
+				pose.center = job.pose->center;
+				pose.target = job.pose->target;
+				pose.vfov = job.pose->vfov > 0 ? job.pose->vfov : pose.vfov;
+			}
+			Camera<Scene> camera {pose};
+			double ready_ms = ready_time.elapsed_seconds() * 1e3;
+			std::cout << "Job " << job.id << ": " << job.scene << (cached ? " from the scene cache" : " built")
+					  << ", ready in " << ready_ms << " ms after " << job.queued.elapsed_seconds() * 1e3 - ready_ms << " ms queued" << std::endl;
+			Stopwatch render_time;
+			camera.render(*world, job.output, job.settings);
+			std::ostringstream line;
+			line << "done " << job.id << ' ' << job.output << " scene_cached " << cached << " ready_ms " << ready_ms
+				 << " render_s " << render_time.elapsed_seconds();
+			reply(job.client, line.str());
+		}
+	};
+
+	// Sends a request line to the server at address and copies its replies to out, until the server closes the connection.
+	// Throws std::runtime_error if the server cannot be reached
+	inline void submit(const std::string& address, const std::string& request, std::ostream& out)
+	{
+		Distributed::Socket server = Distributed::connect_to(address);
+		std::string message = request + '\n';
+		if (!Distributed::send_all(server.fd(), message.data(), message.size()))
+			throw std::runtime_error("Error: Unable to send the request to " + address);
+		std::string line;
+		while (receive_line(server, line))
+			out << line << std::endl;
+	}
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef RENDERSETTINGS_H
+#define RENDERSETTINGS_H
+
+#include <atomic>
+#include <string>
+#include "Constants.h"
+#include "EXRFile.h"
+#include "Distributed.h"
+#include "RenderProgress.h"
+
+/**
+ * @brief A rectangle of pixels of the full resolution image.
+ *
+ */
+struct PixelWindow {
+    int col_min = 0;    //inclusive
+    int row_min = 0;    //inclusive
+    int col_max = 0;    //exclusive
+    int row_max = 0;    //exclusive
+
+    int width() const {return col_max - col_min;}
+    int height() const {return row_max - row_min;}
+    bool empty() const {return width() <= 0 || height() <= 0;}
+
+    /**
+     * @brief Returns whether other lies entirely inside this window.
+     *
+     * @param other the window to test
+     * @return true if every pixel of other is in this window
+     * @return false otherwise
+     */
+    bool contains(const PixelWindow& other) const {
+        return other.col_min >= col_min && other.row_min >= row_min && other.col_max <= col_max && other.row_max <= row_max;
+    }
+
+    bool operator==(const PixelWindow&) const = default;
+};
+
+/**
+ * @brief Runtime options that control how a Camera renders an image.
+ * The default values render every sample of the scene in a single pass, without checkpoints.
+ *
+ */
+struct RenderSettings {
+    int samples_per_pixel = 0;                  //target samples per pixel. 0 uses the scene's samples_per_pixel
+    int samples_per_pass = 0;                   //samples added to every pixel per pass. 0 renders all samples in one pass
+    int checkpoint_every_passes = 0;            //write a preview and checkpoint every this many passes. 0 disables
+    float_type checkpoint_every_seconds = 0;    //write a preview and checkpoint every this many seconds. 0 disables
+    std::string checkpoint_filename {};         //where the checkpoint is written. empty disables checkpoints
+    bool resume = false;                        //continue from checkpoint_filename if it exists
+    float_type time_budget_seconds = 0;         //keep rendering passes until this much time has passed. 0 disables
+    std::string heatmap_filename_stem {};       //path and name that cost heatmap filenames start with. empty disables
+    unsigned int seed = 0;                      //makes the render deterministic. 0 leaves the generators self-seeded
+    bool packets = false;                       //trace camera rays in packets of coherent rays
+    bool wavefront = false;                     //trace the paths of each tile breadth-first, in waves of rays
+    bool denoise = false;                       //filter the final image, sampling albedo and normal features to guide it
+    std::string aov_filename {};                //where the beauty and first-hit feature channels are written. empty disables
+    std::string exr_filename {};                //where the final image is also written as HDR OpenEXR, with any AOVs. empty disables
+    EXRFile::Settings exr {};                   //the pixel type and compression of the OpenEXR file
+    std::string stream_target {};               //a path or FIFO, or "-" for stdout, that the image is streamed to row by row
+                                                //instead of being written to the .ppm file. empty disables
+    PixelWindow crop {};                        //the only pixels that are rendered. empty renders the whole image
+    bool crop_full_size = false;                //write the whole image, black outside of crop, instead of only crop
+    Distributed::Settings distribute {};        //the socket and local worker processes that the tiles are rendered on
+    std::string partial_filename {};            //where the sums of the sample range are written instead of the image. empty disables
+    long sample_range_begin = 0;                //the first sample per pixel of a partial render. inclusive
+    long sample_range_end = 0;                  //the sample per pixel that a partial render stops before. exclusive
+    const std::atomic<bool>* cancel = nullptr;  //if set, the render stops at the next tile once it is true, and writes what it has
+    RenderProgress* progress = nullptr;         //if set, counts the tiles and samples rendered, for another thread to read
+    float_type progress_every_seconds = 0;      //print a progress line on stderr this often. 0 disables
+
+    /**
+     * @brief Returns whether the render should periodically write checkpoints.
+     *
+     * @return true if a checkpoint file is configured
+     * @return false otherwise
+     */
+    bool checkpointing() const {
+        return !checkpoint_filename.empty();
+    }
+
+    /**
+     * @brief Returns whether the render is limited by wall-clock time rather than by samples.
+     *
+     * @return true if a time budget is configured
+     * @return false otherwise
+     */
+    bool time_budgeted() const {
+        return time_budget_seconds > 0;
+    }
+
+    /**
+     * @brief Returns whether per-pixel cost heatmaps are written alongside the image.
+     *
+     * @return true if a heatmap filename stem is configured
+     * @return false otherwise
+     */
+    bool cost_heatmaps() const {
+        return !heatmap_filename_stem.empty();
+    }
+
+    /**
+     * @brief Returns whether the render is deterministic, with every tile of every pass seeded from seed.
+     *
+     * @return true if a seed is configured
+     * @return false otherwise
+     */
+    bool seeded() const {
+        return seed != 0;
+    }
+
+    /**
+     * @brief Returns whether arbitrary output variables (AOVs) are written alongside the image.
+     *
+     * @return true if an AOV filename is configured
+     * @return false otherwise
+     */
+    bool aovs() const {
+        return !aov_filename.empty();
+    }
+
+    /**
+     * @brief Returns whether the final image is also written as an OpenEXR file.
+     *
+     * @return true if an OpenEXR filename is configured
+     * @return false otherwise
+     */
+    bool writes_exr() const {
+        return !exr_filename.empty();
+    }
+
+    /**
+     * @brief Returns whether the image is streamed row by row instead of being written to the .ppm file.
+     *
+     * @return true if a stream target is configured
+     * @return false otherwise
+     */
+    bool streaming() const {
+        return !stream_target.empty();
+    }
+
+    /**
+     * @brief Returns whether only a window of the image is rendered.
+     *
+     * @return true if a crop window is configured
+     * @return false otherwise
+     */
+    bool cropped() const {
+        return !crop.empty();
+    }
+
+    /**
+     * @brief Returns whether the tiles are rendered by worker processes instead of this one.
+     *
+     * @return true if the render coordinates workers
+     * @return false otherwise
+     */
+    bool distributed() const {
+        return distribute.coordinating();
+    }
+
+    /**
+     * @brief Returns whether a range of samples is rendered into a partial render file instead of an image.
+     *
+     * @return true if a partial render filename is configured
+     * @return false otherwise
+     */
+    bool partial() const {
+        return !partial_filename.empty();
+    }
+
+    /**
+     * @brief Returns whether the features of the first surface hit in every pixel are sampled during the render.
+     *
+     * @return true if the denoiser or the AOVs need them
+     * @return false otherwise
+     */
+    bool samples_features() const {
+        return denoise || aovs();
+    }
+
+    /**
+     * @brief Returns whether the render has been cancelled. Safe to call from any thread.
+     *
+     * @return true if a cancellation token is set and has been cancelled
+     * @return false otherwise
+     */
+    bool cancelled() const {
+        return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+    }
+};
+
+#endif
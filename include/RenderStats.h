@@ -0,0 +1,161 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <array>
+#include <algorithm>
+#include <string>
+#include <cstdint>
+#include <mutex>
+#include <iostream>
+#include "Constants.h"
+
+// This header-only RenderStats namespace implements cheap per-thread counters of the work done by a render.
+// Each thread increments its own thread_local counters, which are merged when the thread exits.
+// Unless RAYTRACER_STATS is defined (cmake -DRAYTRACER_STATS=ON), every counting function compiles to nothing.
+namespace RenderStats
+{
+#ifdef RAYTRACER_STATS
+	inline constexpr bool enabled = true;
+#else
+	inline constexpr bool enabled = false;
+#endif
+
+	// The types of geometric primitives whose intersection tests are counted
+	enum class Primitive { sphere, quad, constant_medium, count };
+	inline constexpr const char* primitive_names[] = { "Sphere", "Quad", "ConstantMedium" };
+	inline constexpr std::size_t num_primitives = static_cast<std::size_t>(Primitive::count);
+
+	// Paths with more bounces than this are counted in the last histogram bucket
+	inline constexpr std::size_t max_path_length = 64;
+
+	struct Counters
+	{
+		std::uint64_t camera_rays = 0;
+		std::uint64_t bounce_rays = 0;
+		std::uint64_t bvh_nodes_visited = 0;
+		std::array<std::uint64_t, num_primitives> primitive_tests {};
+		std::uint64_t medium_scatter_events = 0;
+		std::array<std::uint64_t, max_path_length + 1> path_lengths {};	// indexed by the number of bounces
+
+		void merge(const Counters& other)
+		{
+			camera_rays += other.camera_rays;
+			bounce_rays += other.bounce_rays;
+			bvh_nodes_visited += other.bvh_nodes_visited;
+			for (std::size_t i = 0; i < num_primitives; ++i)
+				primitive_tests[i] += other.primitive_tests[i];
+			medium_scatter_events += other.medium_scatter_events;
+			for (std::size_t i = 0; i <= max_path_length; ++i)
+				path_lengths[i] += other.path_lengths[i];
+		}
+
+		std::uint64_t total_rays() const { return camera_rays + bounce_rays; }
+
+		std::uint64_t total_primitive_tests() const
+		{
+			std::uint64_t total = 0;
+			for (auto tests : primitive_tests)
+				total += tests;
+			return total;
+		}
+	};
+
+	// The counters of every thread that has exited, guarded by merged_mutex
+	inline std::mutex merged_mutex;
+	inline Counters merged {};
+
+	// Owns a thread's counters, and merges them into the shared total when the thread exits
+	struct ThreadCounters
+	{
+		Counters counters {};
+
+		~ThreadCounters()
+		{
+			std::lock_guard<std::mutex> lock { merged_mutex };
+			merged.merge(counters);
+		}
+	};
+
+	// The counters of the calling thread
+	inline Counters& local()
+	{
+		thread_local ThreadCounters thread_counters;
+		return thread_counters.counters;
+	}
+
+	inline void count_camera_ray()
+	{
+		if constexpr (enabled) ++local().camera_rays;
+	}
+
+	inline void count_bounce_ray()
+	{
+		if constexpr (enabled) ++local().bounce_rays;
+	}
+
+	inline void count_bvh_node()
+	{
+		if constexpr (enabled) ++local().bvh_nodes_visited;
+	}
+
+	inline void count_primitive_test([[maybe_unused]] Primitive primitive)
+	{
+		if constexpr (enabled) ++local().primitive_tests[static_cast<std::size_t>(primitive)];
+	}
+
+	inline void count_medium_scatter()
+	{
+		if constexpr (enabled) ++local().medium_scatter_events;
+	}
+
+	// Records a finished light path that underwent bounces object interactions
+	inline void count_path_length([[maybe_unused]] int bounces)
+	{
+		if constexpr (enabled) ++local().path_lengths[std::min(static_cast<std::size_t>(bounces), max_path_length)];
+	}
+
+	// Returns the counters of all exited threads plus the calling thread.
+	// Worker threads must have been joined for their counts to be included.
+	inline Counters collect()
+	{
+		std::lock_guard<std::mutex> lock { merged_mutex };
+		Counters total = merged;
+		total.merge(local());
+		return total;
+	}
+
+	// Clears the counters of all exited threads and the calling thread
+	inline void reset()
+	{
+		std::lock_guard<std::mutex> lock { merged_mutex };
+		merged = Counters {};
+		local() = Counters {};
+	}
+
+	// Prints the counters along with the throughput and average cost per ray of a render that took seconds
+	inline void report(std::ostream& out, const Counters& counters, double seconds)
+	{
+		auto per_ray = [&](double value) { return counters.total_rays() ? value / static_cast<double>(counters.total_rays()) : 0.0; };
+		out << "Render statistics:\n"
+			<< "  camera rays:            " << counters.camera_rays << '\n'
+			<< "  bounce rays:            " << counters.bounce_rays << '\n'
+			<< "  BVH nodes visited:      " << counters.bvh_nodes_visited << '\n';
+		for (std::size_t i = 0; i < num_primitives; ++i)
+		{
+			std::string label = std::string(primitive_names[i]) + " tests:";
+			out << "  " << label << std::string(24 - label.size(), ' ') << counters.primitive_tests[i] << '\n';
+		}
+		out << "  medium scatter events:  " << counters.medium_scatter_events << '\n'
+			<< "  rays/sec:               " << static_cast<double>(counters.total_rays()) / seconds << '\n'
+			<< "  average cost per ray:   " << per_ray(seconds * 1e9) << " ns, "
+			<< per_ray(static_cast<double>(counters.bvh_nodes_visited)) << " BVH nodes, "
+			<< per_ray(static_cast<double>(counters.total_primitive_tests())) << " primitive tests\n"
+			<< "  path length histogram (bounces: paths):\n";
+		for (std::size_t i = 0; i <= max_path_length; ++i)
+			if (counters.path_lengths[i])
+				out << "    " << i << (i == max_path_length ? "+" : "") << ": " << counters.path_lengths[i] << '\n';
+		out << std::flush;
+	}
+};
+
+#endif
@@ -23,8 +23,8 @@ public:
      */
     RotateY(std::shared_ptr<Hittable> hittable_, float_type rotation_angle_) : 
         hittable{hittable_},
-        sin_theta{sin(degrees_to_radians(rotation_angle_))},
-        cos_theta{cos(degrees_to_radians(rotation_angle_))},
+        sin_theta{std::sin(degrees_to_radians(rotation_angle_))},
+        cos_theta{std::cos(degrees_to_radians(rotation_angle_))},
         bbox{hittable->bounding_box()}  //temporary value
     {   
         //calculate AABB that entire contains the original AABB after rotation
@@ -42,8 +42,8 @@ public:
                     Vector3D temp = object_to_world_space(Vector3D{x, y, z});
 
                     for (int c = 0; c < 3; c++) {
-                        min[c] = fmin(min[c], temp[c]);
-                        max[c] = fmax(max[c], temp[c]);
+                        min[c] = std::fmin(min[c], temp[c]);
+                        max[c] = std::fmax(max[c], temp[c]);
                     }
                 }
             }
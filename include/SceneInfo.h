@@ -18,8 +18,26 @@
 #include "ConstantMedium.h"
 #include "BVH.h"
 
+/**
+ * @brief The name of a scene, used to label its output in benchmarks.
+ * 
+ * @tparam Scene the scene tag
+ */
+template <typename Scene>
+inline constexpr const char* scene_name = "";
+
+/**
+ * @brief A compile time list of scene tags, so that tools can be instantiated for every scene.
+ * 
+ * @tparam Scenes the scene tags
+ */
+template <typename... Scenes>
+struct SceneList {};
+
 //Scene Tag
 struct RandomSphereScene {};
+template <>
+inline constexpr const char* scene_name<RandomSphereScene> = "RandomSphereScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -106,6 +124,8 @@ inline HittableList make_world<RandomSphereScene>() {
 
 //Scene Tag
 struct TwoSpheresScene {};
+template <>
+inline constexpr const char* scene_name<TwoSpheresScene> = "TwoSpheresScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -151,6 +171,8 @@ inline HittableList make_world<TwoSpheresScene>() {
 
 //Scene Tag
 struct EarthScene {};
+template <>
+inline constexpr const char* scene_name<EarthScene> = "EarthScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -197,6 +219,8 @@ inline HittableList make_world<EarthScene>() {
 
 //Scene Tag
 struct TwoPerlinSpheresScene {};
+template <>
+inline constexpr const char* scene_name<TwoPerlinSpheresScene> = "TwoPerlinSpheresScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -241,6 +265,8 @@ inline HittableList make_world<TwoPerlinSpheresScene>() {
 
 //Scene Tag
 struct QuadrilateralsScene {};
+template <>
+inline constexpr const char* scene_name<QuadrilateralsScene> = "QuadrilateralsScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -295,6 +321,8 @@ inline HittableList make_world<QuadrilateralsScene>() {
 
 //Scene Tag
 struct SimpleLightScene {};
+template <>
+inline constexpr const char* scene_name<SimpleLightScene> = "SimpleLightScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -344,6 +372,8 @@ inline HittableList make_world<SimpleLightScene>() {
 
 //Scene Tag
 struct CornellBoxScene {};
+template <>
+inline constexpr const char* scene_name<CornellBoxScene> = "CornellBoxScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -409,6 +439,8 @@ inline HittableList make_world<CornellBoxScene>() {
 
 //Scene Tag
 struct CornellSmokeScene {};
+template <>
+inline constexpr const char* scene_name<CornellSmokeScene> = "CornellSmokeScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -474,6 +506,8 @@ inline HittableList make_world<CornellSmokeScene>() {
 
 //Scene Tag
 struct ComplexCornellScene {};
+template <>
+inline constexpr const char* scene_name<ComplexCornellScene> = "ComplexCornellScene";
 
 /**
  * @brief Defines the Camera parameters for the scene
@@ -575,4 +609,15 @@ inline HittableList make_world<ComplexCornellScene>() {
 }
 
 
+//Every scene defined above
+using AllScenes = SceneList<RandomSphereScene,
+                            TwoSpheresScene,
+                            EarthScene,
+                            TwoPerlinSpheresScene,
+                            QuadrilateralsScene,
+                            SimpleLightScene,
+                            CornellBoxScene,
+                            CornellSmokeScene,
+                            ComplexCornellScene>;
+
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define SPHERE_H
 
 #include <memory>
+#include <array>
+#include <bit>
 #include "Constants.h"
 #include "Hittable.h"
 #include "Vector3D.h"
@@ -10,6 +12,9 @@
 #include "Material.h"
 #include "AABB.h"
 #include "Texture.h"
+#include "RenderStats.h"
+#include "RayPacket.h"
+#include "Kernels.h"
 
 /**
  * @brief Represents a spherical object that can interact with light rays.
@@ -23,6 +28,7 @@ private:
     bool m_is_moving = false;
     Vector3D m_velocity {};
     AABB m_bbox;
+    int m_id {next_primitive_id()};
 
     /**
      * @brief returns an Axis Aligned Bounding Box completely surrounding a stationary Sphere.
@@ -95,6 +101,7 @@ public:
      * If successful hit, returns a valid HitRecord.
      */
     HitRecord hit(const Ray3D& ray, const Interval& t_interval) const override {
+        RenderStats::count_primitive_test(RenderStats::Primitive::sphere);
         Vector3D center = current_center(ray.time());
         //quadratic formula to find where the ray hits the sphere surface
         Vector3D center_to_origin = ray.origin() - center;
@@ -118,19 +125,37 @@ public:
             }
         }
 
-        //pass hit information through hit record
-        HitRecord rec;
-        rec.is_hit = true;
-        rec.t = root;
-        rec.point = ray.at(rec.t);
-        Vector3D outward_unit_normal = (rec.point - m_center) / m_radius;
-        rec.set_face_and_normal(ray, outward_unit_normal);
-        auto uv = get_unit_sphere_uv(outward_unit_normal);
-        rec.u = uv.u;
-        rec.v = uv.v;
-        rec.material_ptr = m_material_ptr;
+        return make_hit_record(ray, root);
+    }
 
-        return rec;
+    /**
+     * @brief Intersects the active rays of a packet with the sphere at once, using the packet kernel.
+     * Moving spheres test each ray on its own, since their center depends on the time of the ray.
+     * 
+     * @param packet the rays
+     * @param t_min the minimum travel distance of every ray
+     * @param hits the closest hit of each ray so far, updated where the sphere is closer
+     * @param active the rays to test
+     */
+    void hit_packet(const RayPacket& packet, float_type t_min, PacketHits& hits, RayPacket::Mask active) const override {
+        if (m_is_moving || std::popcount(active) < RayPacket::min_kernel_lanes) {
+            Hittable::hit_packet(packet, t_min, hits, active);
+            return;
+        }
+        for (RayPacket::Mask lanes = active; lanes != 0; lanes &= lanes - 1) {
+            RenderStats::count_primitive_test(RenderStats::Primitive::sphere);
+        }
+
+        const float_type center[3] = {m_center.x(), m_center.y(), m_center.z()};
+        alignas(64) std::array<float_type, RayPacket::size> t;
+        RayPacket::Mask hit_lanes = Kernels::active().packet_sphere(packet.rays(), center, m_radius, t_min, hits.t_max.data(), active, t.data());
+        for (int lane = 0; lane < RayPacket::size; ++lane) {
+            if (((hit_lanes >> lane) & 1) != 0) {
+                auto l = static_cast<std::size_t>(lane);
+                hits.t_max[l] = t[l];
+                hits.records[l] = make_hit_record(packet.ray(lane), t[l]);
+            }
+        }
     }
 
     /**
@@ -144,6 +169,28 @@ public:
     }
 
 private:
+    /**
+     * @brief Fills in the hit record of a ray that hits the sphere.
+     * 
+     * @param ray the ray
+     * @param root the travel distance of the ray to the hit point
+     * @return HitRecord the hit
+     */
+    HitRecord make_hit_record(const Ray3D& ray, float_type root) const {
+        HitRecord rec;
+        rec.is_hit = true;
+        rec.t = root;
+        rec.point = ray.at(rec.t);
+        Vector3D outward_unit_normal = (rec.point - m_center) / m_radius;
+        rec.set_face_and_normal(ray, outward_unit_normal);
+        auto uv = get_unit_sphere_uv(outward_unit_normal);
+        rec.u = uv.u;
+        rec.v = uv.v;
+        rec.material_ptr = m_material_ptr;
+        rec.primitive_id = m_id;
+        return rec;
+    }
+
     /**
      * @brief finds the center of the Sphere at a given point in time.
      * 
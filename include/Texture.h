@@ -1,6 +1,7 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <cmath>
 #include <memory>
 #include "Constants.h"
 #include "Interval.h"
@@ -203,7 +204,7 @@ public:
         auto scaled_pos = position * scale;
         //turbulence to control the phase of a sine function for undulating stripes
         constexpr int turb_scale = 10;
-        return Color{1, 1, 1} * .5 * (1 + sin(scaled_pos.z() + turb_scale * perlin_noise.turbulence(scaled_pos)));
+        return Color{1, 1, 1} * .5 * (1 + std::sin(scaled_pos.z() + turb_scale * perlin_noise.turbulence(scaled_pos)));
     }
 
 private:
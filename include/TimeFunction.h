@@ -4,9 +4,58 @@
 #include <iostream>
 #include <ctime>
 
+/**
+ * @brief Measures the time elapsed since it was constructed or last reset.
+ *
+ */
+class Stopwatch {
+public:
+    /**
+     * @brief Construct a new Stopwatch object and start measuring.
+     *
+     * @param clock the clock to measure. Defaults to wall-clock time;
+     * CLOCK_THREAD_CPUTIME_ID measures the CPU time of the calling thread.
+     */
+    explicit Stopwatch(clockid_t clock = CLOCK_MONOTONIC) : m_clock{clock} {
+        reset();
+    }
+
+    /**
+     * @brief Restarts the measurement from the current time.
+     *
+     */
+    void reset() {
+        clock_gettime(m_clock, &m_start);
+    }
+
+    /**
+     * @brief Returns the time elapsed since the Stopwatch was constructed or last reset.
+     *
+     * @return long long the elapsed time in nanoseconds
+     */
+    long long elapsed_ns() const {
+        struct timespec now;
+        clock_gettime(m_clock, &now);
+        return (now.tv_sec - m_start.tv_sec) * 1000000000LL + (now.tv_nsec - m_start.tv_nsec);
+    }
+
+    /**
+     * @brief Returns the time elapsed since the Stopwatch was constructed or last reset.
+     *
+     * @return double the elapsed time in seconds
+     */
+    double elapsed_seconds() const {
+        return static_cast<double>(elapsed_ns()) * 1e-9;
+    }
+
+private:
+    clockid_t m_clock;
+    struct timespec m_start;
+};
+
 /**
  * @brief Times the execution time of the callable f with arguments args, printing the results to cout.
- * 
+ *
  * @tparam Callable the type of the callable object
  * @tparam Args the arguments the callable accepts
  * @param f the function to be timed
@@ -14,12 +63,10 @@
  */
 template <typename Callable, typename... Args>
 void time_function (Callable f, Args... args) {
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+    Stopwatch stopwatch;
     f(args...);
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    long long elapsed_ns = (end.tv_sec - start.tv_sec) * 1000000000 + (end.tv_nsec - start.tv_nsec);
+    long long elapsed_ns = stopwatch.elapsed_ns();
     std::cout << "Elapsed time: " << elapsed_ns << " nanoseconds" << std::endl;
 }
 
-#endif
\ No newline at end of file
+#endif
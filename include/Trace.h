@@ -0,0 +1,192 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include "TimeFunction.h"
+
+// This header-only Trace namespace records timed spans of the program's phases and of the tiles rendered by each thread.
+// Spans are only recorded when enabled, so that a long running server or embedding program doesn't collect them forever.
+// Phase spans can be summarized after a render. Tile spans are enabled separately, since a render has thousands of tiles.
+// All spans can be exported as Chrome trace-event JSON, viewable in chrome://tracing or https://ui.perfetto.dev
+namespace Trace
+{
+	struct Event
+	{
+		std::string name;
+		std::string category;
+		long long start_ns;
+		long long duration_ns;
+		int lane;			// the trace viewer row that the span is drawn on
+		std::string args;	// JSON object members, e.g. "\"rows\":\"0-10\""
+	};
+
+	// The clock that all spans are measured against
+	inline const Stopwatch program_clock {};
+
+	inline std::atomic<bool> phase_spans_enabled { false };
+	inline std::atomic<bool> tile_spans_enabled { false };
+
+	inline std::mutex events_mutex;
+	inline std::vector<Event> events {};
+
+	// Lanes are the rows of the trace viewer. A lane is only ever used by one running span or thread at a time,
+	// so the thousands of short-lived std::async threads of a render are drawn on as many rows as actually ran concurrently.
+	inline std::mutex lanes_mutex;
+	inline std::vector<bool> lanes_in_use {};
+
+	inline int acquire_lane()
+	{
+		std::lock_guard<std::mutex> lock { lanes_mutex };
+		for (std::size_t lane = 0; lane < lanes_in_use.size(); ++lane)
+		{
+			if (!lanes_in_use[lane])
+			{
+				lanes_in_use[lane] = true;
+				return static_cast<int>(lane);
+			}
+		}
+		lanes_in_use.push_back(true);
+		return static_cast<int>(lanes_in_use.size() - 1);
+	}
+
+	inline void release_lane(int lane)
+	{
+		std::lock_guard<std::mutex> lock { lanes_mutex };
+		lanes_in_use[static_cast<std::size_t>(lane)] = false;
+	}
+
+	// Holds a lane for the lifetime of the calling thread
+	struct ThreadLane
+	{
+		int lane = acquire_lane();
+		~ThreadLane() { release_lane(lane); }
+	};
+
+	inline int thread_lane()
+	{
+		thread_local ThreadLane thread_lane;
+		return thread_lane.lane;
+	}
+
+	inline void record(Event event)
+	{
+		std::lock_guard<std::mutex> lock { events_mutex };
+		events.push_back(std::move(event));
+	}
+
+	// Times a phase of the program from construction to destruction, if phase spans are enabled
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(std::string name) :
+			m_enabled { phase_spans_enabled.load(std::memory_order_relaxed) },
+			m_name { m_enabled ? std::move(name) : std::string {} },
+			m_start_ns { m_enabled ? program_clock.elapsed_ns() : 0 }
+		{}
+
+		~ScopedTimer()
+		{
+			if (!m_enabled)
+				return;
+			record(Event { std::move(m_name), "phase", m_start_ns, program_clock.elapsed_ns() - m_start_ns, thread_lane(), "" });
+		}
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	private:
+		bool m_enabled;
+		std::string m_name;
+		long long m_start_ns;
+	};
+
+	// Times the rendering of one tile of pixels, if tile spans are enabled
+	class TileSpan
+	{
+	public:
+		TileSpan(int row_min, int row_max, int col_min, int col_max) :
+			m_enabled { tile_spans_enabled.load(std::memory_order_relaxed) },
+			m_row_min { row_min }, m_row_max { row_max }, m_col_min { col_min }, m_col_max { col_max },
+			m_lane { m_enabled ? acquire_lane() : 0 },
+			m_start_ns { m_enabled ? program_clock.elapsed_ns() : 0 }
+		{}
+
+		~TileSpan()
+		{
+			if (!m_enabled)
+				return;
+			std::string args = "\"rows\":\"" + std::to_string(m_row_min) + '-' + std::to_string(m_row_max) +
+							   "\",\"cols\":\"" + std::to_string(m_col_min) + '-' + std::to_string(m_col_max) + '"';
+			record(Event { "tile", "tile", m_start_ns, program_clock.elapsed_ns() - m_start_ns, m_lane, std::move(args) });
+			release_lane(m_lane);
+		}
+
+		TileSpan(const TileSpan&) = delete;
+		TileSpan& operator=(const TileSpan&) = delete;
+
+	private:
+		bool m_enabled;
+		int m_row_min, m_row_max, m_col_min, m_col_max;
+		int m_lane;
+		long long m_start_ns;
+	};
+
+	// Prints the total time spent in each phase, in the order that the phases first finished.
+	// Phases may be nested, e.g. load_texture inside of make_world.
+	inline void report_phases(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock { events_mutex };
+		std::vector<std::pair<std::string, long long>> totals;
+		for (const auto& event : events)
+		{
+			if (event.category != "phase")
+				continue;
+			auto it = std::find_if(totals.begin(), totals.end(), [&](const auto& total) { return total.first == event.name; });
+			if (it == totals.end())
+				totals.emplace_back(event.name, event.duration_ns);
+			else
+				it->second += event.duration_ns;
+		}
+		out << "Phase breakdown:\n";
+		for (const auto& [name, duration_ns] : totals)
+			out << "  " << name << ": " << static_cast<double>(duration_ns) * 1e-6 << " ms\n";
+		out << std::flush;
+	}
+
+	// Writes every recorded span to filename as Chrome trace-event JSON.
+	// Throws std::runtime_error if the file cannot be written.
+	inline void write_chrome_json(const std::string& filename)
+	{
+		std::ofstream out { filename, std::ios::trunc };
+		if (!out)
+			throw std::runtime_error("Error: Unable to open trace file " + filename);
+
+		std::lock_guard<std::mutex> lock { events_mutex };
+		out << std::fixed << std::setprecision(3);	// microseconds with nanosecond resolution
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool first = true;
+		for (const auto& event : events)
+		{
+			out << (first ? "" : ",\n")
+				<< "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\""
+				<< ",\"ts\":" << static_cast<double>(event.start_ns) * 1e-3
+				<< ",\"dur\":" << static_cast<double>(event.duration_ns) * 1e-3
+				<< ",\"pid\":1,\"tid\":" << event.lane
+				<< ",\"args\":{" << event.args << "}}";
+			first = false;
+		}
+		out << "\n]}\n";
+		if (!out)
+			throw std::runtime_error("Error: Unable to write trace file " + filename);
+	}
+};
+
+#endif
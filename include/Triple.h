@@ -4,20 +4,50 @@
 #include <cmath>
 #include <iostream>
 #include <array>
+#include <type_traits>
 #include "Constants.h"
 
+//RAYTRACER_SIMD stores triples in 16 byte aligned SSE registers with a padded 4th lane that is kept at 0.
+//Requires single precision. Ignored if the target does not support SSE.
+#if defined(RAYTRACER_SIMD) && defined(__SSE__)
+#include <xmmintrin.h>
+#define TRIPLE_SIMD 1
+#else
+#define TRIPLE_SIMD 0
+#endif
+
 /**
  * @brief Generates general purpose functions for a derived vector-like class, such as Vector3D or Color.
  * 
+ * With RAYTRACER_SIMD the operations run on SSE registers at runtime, but stay constexpr through a scalar path.
+ * 
  * @tparam Derived: the vector-like class which inherits these member functions.
  */
 template <typename Derived> 
 class Triple {
+    static_assert(!TRIPLE_SIMD || std::is_same_v<float_type, float>, "RAYTRACER_SIMD requires a single precision float_type");
+
 public:
+#if TRIPLE_SIMD
+    alignas(16) std::array<float_type, 4> m_vec {};
+#else
     std::array<float_type, 3> m_vec {};
+#endif
 
     constexpr Triple() = default;
+#if TRIPLE_SIMD
+    //built in a register, so that loading it right after construction does not stall on store forwarding
+    constexpr Triple(float_type x, float_type y, float_type z) {
+        if (std::is_constant_evaluated()) {
+            m_vec = {x, y, z, 0};
+        }
+        else {
+            _mm_store_ps(m_vec.data(), _mm_setr_ps(x, y, z, 0));
+        }
+    }
+#else
     constexpr Triple(float_type x, float_type y, float_type z) : m_vec {x, y, z} {}
+#endif
 
     constexpr float_type x() const {return m_vec[0];}
     constexpr float_type y() const {return m_vec[1];}
@@ -26,9 +56,21 @@ public:
     constexpr float_type operator[](size_t i) const {return m_vec[i];}
     constexpr float_type& operator[](size_t i) {return m_vec[i];}
 
-    constexpr Derived operator-() const {return {-m_vec[0], -m_vec[1], -m_vec[2]};} 
+    constexpr Derived operator-() const {
+#if TRIPLE_SIMD
+        if (!std::is_constant_evaluated()) {
+            return store(_mm_sub_ps(_mm_setzero_ps(), load()));
+        }
+#endif
+        return {-m_vec[0], -m_vec[1], -m_vec[2]};
+    } 
 
     constexpr Derived operator+(const Derived& other) const {
+#if TRIPLE_SIMD
+        if (!std::is_constant_evaluated()) {
+            return store(_mm_add_ps(load(), other.load()));
+        }
+#endif
         return {m_vec[0]+other.m_vec[0], m_vec[1]+other.m_vec[1], m_vec[2]+other.m_vec[2]};
     }
     constexpr Derived& operator+=(const Derived& other) {
@@ -36,6 +78,11 @@ public:
     }
 
     constexpr Derived operator-(const Derived& other) const {
+#if TRIPLE_SIMD
+        if (!std::is_constant_evaluated()) {
+            return store(_mm_sub_ps(load(), other.load()));
+        }
+#endif
         return {m_vec[0]-other.m_vec[0], m_vec[1]-other.m_vec[1], m_vec[2]-other.m_vec[2]};
     }
     constexpr Derived& operator-=(const Derived& other) {
@@ -43,6 +90,11 @@ public:
     }
 
     constexpr Derived operator*(const Derived& other) const {
+#if TRIPLE_SIMD
+        if (!std::is_constant_evaluated()) {
+            return store(_mm_mul_ps(load(), other.load()));
+        }
+#endif
         return {m_vec[0]*other.m_vec[0], m_vec[1]*other.m_vec[1], m_vec[2]*other.m_vec[2]};
     }
     constexpr Derived& operator*=(const Derived& other) {
@@ -50,6 +102,11 @@ public:
     }
 
     constexpr Derived operator*(float_type t) const {
+#if TRIPLE_SIMD
+        if (!std::is_constant_evaluated()) {
+            return store(_mm_mul_ps(load(), _mm_set1_ps(t)));
+        }
+#endif
         return {t*m_vec[0], t*m_vec[1], t*m_vec[2]};
     }
     constexpr Derived& operator*=(float_type t) {
@@ -67,22 +124,67 @@ public:
         return std::sqrt(length_squared());
     }
     constexpr float_type length_squared() const {
+#if TRIPLE_SIMD
+        if (!std::is_constant_evaluated()) {
+            return dot(static_cast<const Derived&>(*this));
+        }
+#endif
         return m_vec[0]*m_vec[0] + m_vec[1]*m_vec[1] + m_vec[2]*m_vec[2];
     }
 
     constexpr float_type dot(const Derived& other) const {
+#if TRIPLE_SIMD
+        if (!std::is_constant_evaluated()) {
+            __m128 products = _mm_mul_ps(load(), other.load());
+            __m128 sums = _mm_add_ps(products, _mm_movehl_ps(products, products));     //x+z, y+0
+            return _mm_cvtss_f32(_mm_add_ss(sums, _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 1, 1, 1))));
+        }
+#endif
         return m_vec[0] * other.m_vec[0] + m_vec[1] * other.m_vec[1] + m_vec[2] * other.m_vec[2];
     }
 
     constexpr Derived cross(const Derived& other) const {
+#if TRIPLE_SIMD
+        if (!std::is_constant_evaluated()) {
+            //(a.yzx * b.zxy) - (a.zxy * b.yzx), the padded lanes stay 0
+            __m128 a = load();
+            __m128 b = other.load();
+            __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+            __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+            __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));      //the cross product in zxy order
+            return store(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+        }
+#endif
         return {m_vec[1]*other.m_vec[2] - m_vec[2]*other.m_vec[1], 
                 m_vec[2]*other.m_vec[0] - m_vec[0]*other.m_vec[2],
                 m_vec[0]*other.m_vec[1] - m_vec[1]*other.m_vec[0]};
     }   
 
     Derived unit_vector() const {
-        return *this / length();
+#if TRIPLE_SIMD
+        //reciprocal square root estimate, refined by one Newton-Raphson step to nearly full precision
+        __m128 length_squared_ = _mm_set1_ps(length_squared());
+        __m128 estimate = _mm_rsqrt_ps(length_squared_);
+        __m128 half_estimate = _mm_mul_ps(_mm_set1_ps(0.5f), estimate);
+        __m128 inverse_length = _mm_mul_ps(half_estimate, 
+            _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(length_squared_, _mm_mul_ps(estimate, estimate))));
+        return store(_mm_mul_ps(load(), inverse_length));
+#else
+        return *this * (1 / length());
+#endif
+    }
+
+private:
+#if TRIPLE_SIMD
+    __m128 load() const {
+        return _mm_load_ps(m_vec.data());
+    }
+    static Derived store(__m128 vec) {
+        Derived result;
+        _mm_store_ps(result.m_vec.data(), vec);
+        return result;
     }
+#endif
 
 };
 
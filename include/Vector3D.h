@@ -2,6 +2,7 @@
 #define VECTOR3D_H
 
 #include <cmath>
+#include <algorithm>
 #include "Constants.h"
 #include "Triple.h"
 #include "Random.h"
@@ -27,12 +28,102 @@ public:
     }
 
     /**
-     * @brief Generates a random vector contained within the unit sphere.
+     * @brief Maps a uniform point of the unit square to a uniform point of the unit disk in the plane z = 0
+     * with Shirley and Chiu's concentric mapping, which keeps neighbouring samples close together.
+     * 
+     * @param u1 uniform in [0, 1)
+     * @param u2 uniform in [0, 1)
+     * @return Vector3D: a point of the unit disk
+     */
+    static Vector3D concentric_disk(float_type u1, float_type u2) {
+        float_type a = 2 * u1 - 1;
+        float_type b = 2 * u2 - 1;
+        if (a == 0 && b == 0) {
+            return Vector3D{0, 0, 0};
+        }
+        float_type radius, phi;
+        if (std::abs(a) > std::abs(b)) {    //the wedges around the x axis
+            radius = a;
+            phi = (pi / 4) * (b / a);
+        }
+        else {                              //the wedges around the y axis
+            radius = b;
+            phi = pi / 2 - (pi / 4) * (a / b);
+        }
+        return Vector3D{radius * std::cos(phi), radius * std::sin(phi), 0};
+    }
+
+    /**
+     * @brief Maps a uniform point of the unit square to a uniform direction with spherical coordinates: 
+     * z = cos(theta) is uniform in [-1, 1], as is the area of the sphere along z.
+     * 
+     * @param u1 uniform in [0, 1)
+     * @param u2 uniform in [0, 1)
+     * @return Vector3D: a vector of length 1
+     */
+    static Vector3D sphere_direction(float_type u1, float_type u2) {
+        float_type z = 1 - 2 * u1;
+        float_type radius = std::sqrt(std::max(float_type{0}, 1 - z * z));
+        float_type phi = 2 * pi * u2;
+        return Vector3D{radius * std::cos(phi), radius * std::sin(phi), z};
+    }
+
+    /**
+     * @brief Maps a uniform point of the unit square to a direction on the hemisphere around the z axis, 
+     * with a density proportional to the cosine of its angle to the z axis (cos(theta) / pi). 
+     * A uniform point on the unit disk in polar coordinates is lifted up onto the hemisphere (Malley's method);
+     * the polar mapping is cheaper than concentric_disk here, and its distortion is irrelevant to a single bounce.
+     * 
+     * @param u1 uniform in [0, 1)
+     * @param u2 uniform in [0, 1)
+     * @return Vector3D: a vector of length 1 with z > 0
+     */
+    static Vector3D cosine_direction(float_type u1, float_type u2) {
+        float_type phi = 2 * pi * u1;
+        float_type radius = std::sqrt(u2);
+        return Vector3D{radius * std::cos(phi), radius * std::sin(phi), std::sqrt(1 - u2)};
+    }
+
+    /**
+     * @brief Generates a random vector contained within the unit sphere: 
+     * a uniform direction scaled by the cube root of a uniform sample, as the volume grows with the radius cubed.
      * 
      * @return Vector3D: a random vector
      */
     static Vector3D random_in_unit_sphere() {
-        //rejection method
+        Vector3D direction = random_sphere_unit_vector();
+        return std::cbrt(Random::random_float(0, 1)) * direction;
+    }
+
+    /**
+     * @brief Generates a random vector in the unit disk located in the plane z = 0.
+     * 
+     * @return Vector3D: a random vector
+     */
+    static Vector3D random_in_unit_disk() {
+        float_type u1 = Random::random_float(0, 1);
+        float_type u2 = Random::random_float(0, 1);
+        return concentric_disk(u1, u2);
+    }
+    
+    /**
+     * @brief Generates a random vector located on the unit sphere (with length 1).
+     * 
+     * @return Vector3D: a random vector
+     */
+    static Vector3D random_sphere_unit_vector() {
+        float_type u1 = Random::random_float(0, 1);
+        float_type u2 = Random::random_float(0, 1);
+        return sphere_direction(u1, u2);
+    }
+
+    /**
+     * @brief Generates a random vector contained within the unit sphere with the rejection method, 
+     * which draws 3 random numbers about 1.9 times on average. Kept for comparison.
+     * 
+     * @return Vector3D: a random vector
+     */
+    static Vector3D random_in_unit_sphere_rejection() {
         while (true) {
             Vector3D vec = random(-1, 1);
             if (vec.length_squared() < 1) {
@@ -42,12 +133,12 @@ public:
     }
 
     /**
-     * @brief Generates a random vector in the unit disk located in the plane z = 0.
+     * @brief Generates a random vector in the unit disk located in the plane z = 0 with the rejection method, 
+     * which draws 2 random numbers about 1.27 times on average. Kept for comparison.
      * 
      * @return Vector3D: a random vector
      */
-    static Vector3D random_in_unit_disk() {
-        //rejection method
+    static Vector3D random_in_unit_disk_rejection() {
         while (true) {
             Vector3D vec {Random::random_float(-1, 1), Random::random_float(-1, 1), 0};
             if (vec.length_squared() < 1) {
@@ -55,14 +146,15 @@ public:
             }
         } 
     }
-    
+
     /**
-     * @brief Generates a random vector located on the unit sphere (with length 1).
+     * @brief Generates a random vector located on the unit sphere by normalizing a rejection sampled point 
+     * of the unit sphere. Kept for comparison.
      * 
      * @return Vector3D: a random vector
      */
-    static Vector3D random_sphere_unit_vector() {
-        return random_in_unit_sphere().unit_vector();
+    static Vector3D random_sphere_unit_vector_rejection() {
+        return random_in_unit_sphere_rejection().unit_vector();
     }
 
     /**
@@ -82,6 +174,18 @@ public:
         }
     }
 
+    /**
+     * @brief Generates a random unit vector on the hemisphere around the z axis, 
+     * with a density proportional to the cosine of its angle to the z axis (cos(theta) / pi).
+     * 
+     * @return Vector3D: a random vector with z >= 0
+     */
+    static Vector3D random_cosine_direction() {
+        float_type u1 = Random::random_float(0, 1);
+        float_type u2 = Random::random_float(0, 1);
+        return cosine_direction(u1, u2);
+    }
+
     /**
      * @brief Returns the reflected Vector3D direction of this off of a surface, given the normal.
      * 
@@ -0,0 +1,68 @@
+#ifndef RAYTRACER_C_H
+#define RAYTRACER_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The C interface of the raytracer_core library, a thin wrapper of include/RayTracer.h for C and for the foreign
+ * function interfaces of other languages. Functions that can fail return 0 on success and -1 on failure,
+ * or NULL for those that return a pointer, and rt_last_error() then describes the failure.
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct rt_scene rt_scene;
+typedef struct rt_cancel_token rt_cancel_token;
+
+/* What to render, and how. rt_render_options_default() fills in the defaults */
+typedef struct rt_render_options {
+    int samples_per_pixel;          /* 0 uses the scene's samples_per_pixel */
+    int samples_per_pass;           /* samples added to every pixel between progress reports. 0 renders them in one pass */
+    float time_budget_seconds;      /* stop before the next pass would end after this much time. 0 has no budget */
+    unsigned int seed;              /* makes the render deterministic. 0 leaves the generators self-seeded */
+    int crop;                       /* if not 0, only render the pixels of crop_window */
+    int crop_window[4];             /* x0, y0, x1, y1: the minimums are inclusive and the maximums exclusive */
+    int packets;                    /* if not 0, trace camera rays in packets of coherent rays */
+    int wavefront;                  /* if not 0, trace the paths of each tile breadth-first, in waves of rays */
+} rt_render_options;
+
+/* Called on the rendering thread after every pass of a render, with the user data passed to rt_render */
+typedef void (*rt_progress_callback)(long samples_per_pixel, long target_samples, double elapsed_seconds, void* user_data);
+
+/* Describes the last failure on this thread */
+const char* rt_last_error(void);
+
+/* The scenes that can be built, by index from 0 to rt_scene_count() - 1 */
+int rt_scene_count(void);
+const char* rt_scene_name(int index);
+
+/* Builds the scene named name, seeding the random parts of its world if seed is not 0. Returns NULL on failure */
+rt_scene* rt_scene_build(const char* name, unsigned int seed);
+void rt_scene_free(rt_scene* scene);
+int rt_scene_width(const rt_scene* scene);
+int rt_scene_height(const rt_scene* scene);
+
+/* A token that cancels a render at its next tile. rt_cancel may be called from any thread, or from a signal handler */
+rt_cancel_token* rt_cancel_token_new(void);
+void rt_cancel_token_free(rt_cancel_token* token);
+void rt_cancel(rt_cancel_token* token);
+
+rt_render_options rt_render_options_default(void);
+
+/*
+ * Renders scene into rgb, which must hold 3 bytes for every pixel of the image, or of the crop window if there is one.
+ * The pixels are written as 8 bit gamma corrected R, G and B components in raster order.
+ * progress and cancel may be NULL. samples_per_pixel, if not NULL, is set to the samples that every pixel received,
+ * and cancelled, if not NULL, to whether the render was cancelled. A cancelled render returns 0 with the samples taken so far.
+ */
+int rt_render(const rt_scene* scene, const rt_render_options* options, uint8_t* rgb, size_t rgb_size,
+              rt_progress_callback progress, void* user_data, const rt_cancel_token* cancel,
+              long* samples_per_pixel, int* cancelled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
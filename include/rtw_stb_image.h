@@ -6,12 +6,138 @@
     #pragma warning (push, 0)
 #endif
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STBI_FAILURE_USERMSG
+// The implementation of stb_image is compiled once, in src/core/stb_image.cpp
 #include "external/stb_image.h"
 
+#include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Trace.h"
+
+// Decoded image files, keyed by a hash of their content and shared by every rtw_image of the same file.
+// The least recently used are dropped once there are more than capacity, so a long running process such as
+// the render server decodes a texture once for every scene that uses it, and again only if the file changes.
+class rtw_image_cache {
+  public:
+    struct decoded_image {
+        unsigned char* data = nullptr;
+        int width = 0, height = 0;
+
+        decoded_image() = default;
+        decoded_image(const decoded_image&) = delete;
+        decoded_image& operator=(const decoded_image&) = delete;
+        ~decoded_image() { stbi_image_free(data); }
+    };
+
+    // A file that an image was loaded from, and the hash of its content when it was
+    struct loaded_file {
+        std::string filename;
+        std::uint64_t content_hash;
+    };
+
+    // Returns the decoded image of a file, or null if the file cannot be read or decoded.
+    static std::shared_ptr<const decoded_image> load(const std::string& filename, int bytes_per_pixel) {
+        std::string content;
+        if (!read_file(filename, content)) return nullptr;
+        std::uint64_t key = hash(content);
+
+        if (recording != nullptr) recording->files.push_back(loaded_file{filename, key});
+
+        std::lock_guard lock {mutex};
+        for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+            if (entry->first == key) {
+                entries.splice(entries.begin(), entries, entry);    // now the most recently used
+                ++hits;
+                return entry->second;
+            }
+        }
+        ++misses;
+        auto image = std::make_shared<decoded_image>();
+        int n = bytes_per_pixel; // Dummy out parameter: original components per pixel
+        image->data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(content.data()), static_cast<int>(content.size()),
+                                            &image->width, &image->height, &n, bytes_per_pixel);
+        if (image->data == nullptr) return nullptr;
+        entries.emplace_front(key, image);
+        while (entries.size() > capacity) entries.pop_back();
+        return image;
+    }
+
+    // Returns whether a file still has the content it had when it was loaded.
+    static bool unchanged(const loaded_file& file) {
+        std::string content;
+        return read_file(file.filename, content) && hash(content) == file.content_hash;
+    }
+
+    // Collects the files that images are loaded from on this thread, in order, and the images that could not be
+    // loaded from any file, for its lifetime. Recorders may be nested; only the innermost one collects.
+    class load_recorder {
+      public:
+        load_recorder() : previous {recording} { recording = this; }
+        ~load_recorder() { recording = previous; }
+
+        load_recorder(const load_recorder&) = delete;
+        load_recorder& operator=(const load_recorder&) = delete;
+
+        const std::vector<loaded_file>& loaded_files() const { return files; }
+        const std::vector<std::string>& failed_images() const { return failures; }
+
+      private:
+        friend class rtw_image_cache;
+
+        std::vector<loaded_file> files {};
+        std::vector<std::string> failures {};
+        load_recorder* previous;
+    };
+
+    // Records that an image could not be loaded from any of the files it was looked for in.
+    static void record_failure(const std::string& image_filename) {
+        if (recording != nullptr) recording->failures.push_back(image_filename);
+    }
+
+    static void set_capacity(std::size_t images) {
+        std::lock_guard lock {mutex};
+        capacity = images;
+        while (entries.size() > capacity) entries.pop_back();
+    }
+
+    // The loads that found their image already decoded, and those that had to decode it.
+    static std::pair<long, long> hits_and_misses() {
+        std::lock_guard lock {mutex};
+        return {hits, misses};
+    }
+
+    // 64 bit FNV-1a
+    static std::uint64_t hash(const std::string& content) {
+        std::uint64_t value = 0xcbf29ce484222325ULL;
+        for (char c : content) {
+            value = (value ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+        }
+        return value;
+    }
+
+  private:
+    inline static std::mutex mutex;
+    inline static std::list<std::pair<std::uint64_t, std::shared_ptr<const decoded_image>>> entries {};  // most recently used first
+    inline static std::size_t capacity = 8;
+    inline static thread_local load_recorder* recording = nullptr;    // the innermost load_recorder of this thread
+    inline static long hits = 0;
+    inline static long misses = 0;
+
+    static bool read_file(const std::string& filename, std::string& content) {
+        std::ifstream in {filename, std::ios::binary};
+        if (!in) return false;
+        content.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+        return true;
+    }
+};
 
 class rtw_image {
   public:
@@ -25,6 +151,7 @@ class rtw_image {
         // parent, on so on, for six levels up. If the image was not loaded successfully,
         // width() and height() will return 0.
 
+        Trace::ScopedTimer timer {"load_texture"};
         auto filename = std::string(image_filename);
         auto imagedir = getenv("RTW_IMAGES");
 
@@ -40,14 +167,16 @@ class rtw_image {
         if (load("../../../../../../texture_images/" + filename)) return;
 
         std::cerr << "ERROR: Could not load image file '" << image_filename << "'.\n";
+        rtw_image_cache::record_failure(image_filename);
     }
 
-    ~rtw_image() { STBI_FREE(data); }
-
     bool load(const std::string filename) {
-        // Loads image data from the given file name. Returns true if the load succeeded.
-        auto n = bytes_per_pixel; // Dummy out parameter: original components per pixel
-        data = stbi_load(filename.c_str(), &image_width, &image_height, &n, bytes_per_pixel);
+        // Loads image data from the given file name, decoding it only if no file of the same content has been.
+        // Returns true if the load succeeded.
+        image = rtw_image_cache::load(filename, bytes_per_pixel);
+        data = image ? image->data : nullptr;
+        image_width = image ? image->width : 0;
+        image_height = image ? image->height : 0;
         bytes_per_scanline = image_width * bytes_per_pixel;
         return data != nullptr;
     }
@@ -68,7 +197,8 @@ class rtw_image {
 
   private:
     const int bytes_per_pixel = 3;
-    unsigned char *data;
+    std::shared_ptr<const rtw_image_cache::decoded_image> image;
+    const unsigned char *data;
     int image_width, image_height;
     int bytes_per_scanline;
 
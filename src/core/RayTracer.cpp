@@ -0,0 +1,151 @@
+// The C++ API of the raytracer_core library. Every scene of AllScenes is compiled here, once,
+// so that programs that embed the renderer only compile include/RayTracer.h.
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "RayTracer.h"
+#include "HittableList.h"
+#include "BVH.h"
+#include "Camera.h"
+#include "SceneInfo.h"
+#include "Random.h"
+#include "RenderSettings.h"
+#include "TimeFunction.h"
+#include "Trace.h"
+#include "rtw_stb_image.h"
+#include "RenderServer.h"
+
+struct RayTracer::Scene::Impl {
+    std::string name;
+    int width = 0;
+    int height = 0;
+
+    virtual ~Impl() = default;
+    virtual Image render(const RenderRequest& request, const ProgressCallback& progress, const CancelToken* cancel) const = 0;
+};
+
+namespace {
+
+/**
+ * @brief The world and camera of the scene SceneTag.
+ *
+ * @tparam SceneTag the type tag of the scene, defined in SceneInfo.h
+ */
+template <typename SceneTag>
+struct SceneImpl : RayTracer::Scene::Impl {
+    HittableList world;
+    Camera<SceneTag> camera {};
+
+    explicit SceneImpl(unsigned int seed) {
+        name = scene_name<SceneTag>;
+        width = CameraParameters<SceneTag>::image_width;
+        height = CameraParameters<SceneTag>::image_height;
+        if (seed != 0) {
+            Random::seed(seed);     //the world and BVH are built on this thread
+        }
+        {
+            Trace::ScopedTimer timer {"make_world"};
+            rtw_image_cache::load_recorder textures;
+            world = make_world<SceneTag>();
+            if (!textures.failed_images().empty()) {
+                throw std::runtime_error("Error: Unable to load the texture " + textures.failed_images().front() + " of " + name);
+            }
+        }
+        {
+            Trace::ScopedTimer timer {"build_bvh"};
+            world = HittableList{std::make_shared<BVH_node>(world)};
+        }
+    }
+
+    RayTracer::Image render(const RayTracer::RenderRequest& request, const RayTracer::ProgressCallback& progress,
+                            const RayTracer::CancelToken* cancel) const override {
+        RenderSettings settings;
+        settings.samples_per_pixel = request.samples_per_pixel;
+        settings.samples_per_pass = request.samples_per_pass;
+        settings.time_budget_seconds = request.time_budget_seconds;
+        settings.seed = request.seed;
+        settings.packets = request.packets;
+        settings.wavefront = request.wavefront;
+        settings.cancel = cancel != nullptr ? &cancel->flag() : nullptr;
+        if (request.crop) {
+            settings.crop = PixelWindow{request.crop_window.col_min, request.crop_window.row_min,
+                                        request.crop_window.col_max, request.crop_window.row_max};
+            if (settings.crop.empty()) {
+                throw std::invalid_argument("Error: the crop window of the render is empty");
+            }
+        }
+        long target_samples = settings.samples_per_pixel > 0 ? settings.samples_per_pixel
+                            : settings.time_budgeted() ? 0 : CameraParameters<SceneTag>::samples_per_pixel;
+
+        RayTracer::Image image;
+        AccumulationBuffer buffer {width, height};
+        Stopwatch render_time;
+        camera.render_passes(world, buffer, settings, [&](const AccumulationBuffer& rendered) {
+            if (progress) {
+                progress(RayTracer::Progress{rendered.samples_per_pixel(), target_samples, render_time.elapsed_seconds()});
+            }
+            return true;
+        });
+        image.cancelled = settings.cancelled();
+
+        image.width = settings.cropped() ? settings.crop.width() : width;
+        image.height = settings.cropped() ? settings.crop.height() : height;
+        image.samples_per_pixel = buffer.samples_per_pixel();
+        image.rgb.resize(3 * static_cast<std::size_t>(image.width) * static_cast<std::size_t>(image.height));
+        camera.write_pixels(buffer, settings, image.rgb.data());
+        return image;
+    }
+};
+
+/**
+ * @brief Collects the names of a list of scenes.
+ *
+ */
+template <typename... Scenes>
+std::vector<std::string> names_of(SceneList<Scenes...>) {
+    return {scene_name<Scenes>...};
+}
+
+}
+
+std::vector<std::string> RayTracer::scene_names() {
+    return names_of(AllScenes{});
+}
+
+RayTracer::Scene RayTracer::Scene::build(const std::string& name, unsigned int seed) {
+    std::shared_ptr<const Impl> impl;
+    RenderServer::with_scene(AllScenes{}, name, [&](auto scene) {
+        impl = std::make_shared<const SceneImpl<decltype(scene)>>(seed);
+    });
+    if (!impl) {
+        throw std::invalid_argument("Error: there is no scene named " + name);
+    }
+    return Scene{impl};
+}
+
+const std::string& RayTracer::Scene::name() const {
+    return m_impl->name;
+}
+
+int RayTracer::Scene::width() const {
+    return m_impl->width;
+}
+
+int RayTracer::Scene::height() const {
+    return m_impl->height;
+}
+
+RayTracer::Image RayTracer::Scene::render(const RenderRequest& request, const ProgressCallback& progress, const CancelToken* cancel) const {
+    return m_impl->render(request, progress, cancel);
+}
+
+void RayTracer::serve(const std::string& address, std::size_t scene_capacity, std::size_t texture_capacity, 
+                      const std::string& output_directory) {
+    RenderServer::Server server {address, scene_capacity, texture_capacity, output_directory};
+    server.run();
+}
+
+void RayTracer::submit(const std::string& address, const std::string& request, std::ostream& out) {
+    RenderServer::submit(address, request, out);
+}
@@ -0,0 +1,142 @@
+// The C interface of the raytracer_core library. No exception leaves these functions:
+// they are caught and recorded for rt_last_error().
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "raytracer_c.h"
+#include "RayTracer.h"
+
+struct rt_scene {
+    RayTracer::Scene scene;
+};
+
+struct rt_cancel_token {
+    RayTracer::CancelToken token;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+/**
+ * @brief Calls function, recording the message of any exception that it throws.
+ *
+ * @return int 0 if it returned, -1 if it threw
+ */
+template <typename Function>
+int recording_errors(const Function& function) {
+    try {
+        function();
+        return 0;
+    }
+    catch (const std::exception& exception) {
+        last_error = exception.what();
+    }
+    catch (...) {
+        last_error = "Error: unknown exception";
+    }
+    return -1;
+}
+
+const std::vector<std::string>& names() {
+    static const std::vector<std::string> scene_names = RayTracer::scene_names();
+    return scene_names;
+}
+
+}
+
+extern "C" {
+
+const char* rt_last_error(void) {
+    return last_error.c_str();
+}
+
+int rt_scene_count(void) {
+    return static_cast<int>(names().size());
+}
+
+const char* rt_scene_name(int index) {
+    if (index < 0 || index >= rt_scene_count()) {
+        last_error = "Error: there is no scene " + std::to_string(index);
+        return nullptr;
+    }
+    return names()[static_cast<std::size_t>(index)].c_str();
+}
+
+rt_scene* rt_scene_build(const char* name, unsigned int seed) {
+    rt_scene* scene = nullptr;
+    recording_errors([&] {
+        scene = new rt_scene{RayTracer::Scene::build(name != nullptr ? name : "", seed)};
+    });
+    return scene;
+}
+
+void rt_scene_free(rt_scene* scene) {
+    delete scene;
+}
+
+int rt_scene_width(const rt_scene* scene) {
+    return scene->scene.width();
+}
+
+int rt_scene_height(const rt_scene* scene) {
+    return scene->scene.height();
+}
+
+rt_cancel_token* rt_cancel_token_new(void) {
+    return new rt_cancel_token{};
+}
+
+void rt_cancel_token_free(rt_cancel_token* token) {
+    delete token;
+}
+
+void rt_cancel(rt_cancel_token* token) {
+    token->token.cancel();
+}
+
+rt_render_options rt_render_options_default(void) {
+    RayTracer::RenderRequest defaults;
+    return rt_render_options{defaults.samples_per_pixel, defaults.samples_per_pass, defaults.time_budget_seconds, defaults.seed,
+                             0, {0, 0, 0, 0}, defaults.packets, defaults.wavefront};
+}
+
+int rt_render(const rt_scene* scene, const rt_render_options* options, uint8_t* rgb, size_t rgb_size,
+              rt_progress_callback progress, void* user_data, const rt_cancel_token* cancel,
+              long* samples_per_pixel, int* cancelled) {
+    return recording_errors([&] {
+        RayTracer::RenderRequest request;
+        request.samples_per_pixel = options->samples_per_pixel;
+        request.samples_per_pass = options->samples_per_pass;
+        request.time_budget_seconds = options->time_budget_seconds;
+        request.seed = options->seed;
+        request.crop = options->crop != 0;
+        request.crop_window = RayTracer::Window{options->crop_window[0], options->crop_window[1], options->crop_window[2], options->crop_window[3]};
+        request.packets = options->packets != 0;
+        request.wavefront = options->wavefront != 0;
+        int width = request.crop ? request.crop_window.col_max - request.crop_window.col_min : scene->scene.width();
+        int height = request.crop ? request.crop_window.row_max - request.crop_window.row_min : scene->scene.height();
+        if (width > 0 && height > 0 && rgb_size < 3 * static_cast<std::size_t>(width) * static_cast<std::size_t>(height)) {
+            throw std::invalid_argument("Error: the pixel buffer is smaller than the image");
+        }
+
+        RayTracer::ProgressCallback report;
+        if (progress != nullptr) {
+            report = [&](const RayTracer::Progress& done) {
+                progress(done.samples_per_pixel, done.target_samples, done.elapsed_seconds, user_data);
+            };
+        }
+        RayTracer::Image image = scene->scene.render(request, report, cancel != nullptr ? &cancel->token : nullptr);
+        std::copy(image.rgb.begin(), image.rgb.end(), rgb);
+        if (samples_per_pixel != nullptr) {
+            *samples_per_pixel = image.samples_per_pixel;
+        }
+        if (cancelled != nullptr) {
+            *cancelled = image.cancelled;
+        }
+    });
+}
+
+}
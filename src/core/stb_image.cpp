@@ -0,0 +1,5 @@
+// The implementation of stb_image, which rtw_stb_image.h only declares, so that it is compiled once
+// instead of by every translation unit that loads textures.
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_FAILURE_USERMSG
+#include "stb_image.h"
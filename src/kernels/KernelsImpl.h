@@ -0,0 +1,246 @@
+#ifndef KERNELSIMPL_H
+#define KERNELSIMPL_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Kernels.h"
+
+// The kernels of Kernels.h. Each file that includes this header defines KERNELS_VECTOR_BYTES, the register width of
+// its instruction set, and one Kernels::Table from these kernels. The packet kernels work on the lanes of a packet
+// KERNELS_VECTOR_BYTES at a time with GCC vector extensions, the others are left to the compiler to vectorize.
+// Everything here has internal linkage and calls no inline functions of other headers,
+// so no code compiled for one instruction set is shared with another.
+#if !defined(KERNELS_VECTOR_BYTES)
+#error "KERNELS_VECTOR_BYTES must be defined before including KernelsImpl.h"
+#endif
+
+namespace
+{
+	using Kernels::packet_size;
+	using Kernels::PacketRays;
+
+	// A vector of lanes, and the result of comparing two, where each lane is all ones or all zeros
+	using Vec = float_type __attribute__((vector_size(KERNELS_VECTOR_BYTES)));
+	using VecMask = decltype(Vec{} < Vec{});
+	constexpr int vec_lanes = KERNELS_VECTOR_BYTES / sizeof(float_type);
+	static_assert(packet_size % vec_lanes == 0, "a packet must be a whole number of vectors");
+
+	inline Vec load(const float_type* lanes)
+	{
+		Vec vec;
+		__builtin_memcpy(&vec, lanes, sizeof(vec));
+		return vec;
+	}
+
+	inline void store(float_type* lanes, Vec vec)
+	{
+		__builtin_memcpy(lanes, &vec, sizeof(vec));
+	}
+
+	inline Vec broadcast(float_type value)
+	{
+		return Vec{} + value;
+	}
+
+	inline Vec min_of(Vec a, Vec b) { return a < b ? a : b; }
+	inline Vec max_of(Vec a, Vec b) { return a < b ? b : a; }
+	inline Vec absolute(Vec a) { return a < 0 ? -a : a; }
+
+	inline float_type square_root(float_type a)
+	{
+		if constexpr (sizeof(float_type) == sizeof(float))
+			return __builtin_sqrtf(a);
+		else
+			return __builtin_sqrt(a);
+	}
+
+	inline Vec square_root(Vec a)
+	{
+		for (int lane = 0; lane < vec_lanes; ++lane)
+			a[lane] = square_root(a[lane]);
+		return a;
+	}
+
+	inline float_type round_down(float_type a)
+	{
+		if constexpr (sizeof(float_type) == sizeof(float))
+			return __builtin_floorf(a);
+		else
+			return __builtin_floor(a);
+	}
+
+	// Packs the lanes of a comparison into the bits of a mask, from bit first_lane
+	inline std::uint32_t to_mask(VecMask hits, int first_lane)
+	{
+		std::uint32_t mask = 0;
+		for (int lane = 0; lane < vec_lanes; ++lane)
+			mask |= static_cast<std::uint32_t>(hits[lane] != 0) << lane;
+		return mask << first_lane;
+	}
+
+	// The bits of the active mask of the lanes from first_lane
+	inline std::uint32_t vector_active(std::uint32_t active, int first_lane)
+	{
+		return (active >> first_lane) & ((std::uint32_t{1} << vec_lanes) - 1);
+	}
+
+	std::uint32_t packet_box(const PacketRays& rays, const float_type* box_min, const float_type* box_max,
+							 float_type t_min, const float_type* t_max, std::uint32_t active)
+	{
+		std::uint32_t hits = 0;
+		for (int first = 0; first < packet_size; first += vec_lanes)
+		{
+			if (vector_active(active, first) == 0)
+				continue;
+			Vec t_near = broadcast(t_min);
+			Vec t_far = load(t_max + first);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				Vec origin = load(rays.origin[axis] + first);
+				Vec inverse_direction = load(rays.inverse_direction[axis] + first);
+				Vec t0 = (box_min[axis] - origin) * inverse_direction;
+				Vec t1 = (box_max[axis] - origin) * inverse_direction;
+				t_near = max_of(t_near, min_of(t0, t1));
+				t_far = min_of(t_far, max_of(t0, t1));
+			}
+			hits |= to_mask(t_near < t_far, first);
+		}
+		return hits & active;
+	}
+
+	std::uint32_t packet_sphere(const PacketRays& rays, const float_type* center, float_type radius,
+								float_type t_min, const float_type* t_max, std::uint32_t active, float_type* t)
+	{
+		std::uint32_t hits = 0;
+		for (int first = 0; first < packet_size; first += vec_lanes)
+		{
+			if (vector_active(active, first) == 0)
+				continue;
+			// as in Sphere::hit: the roots of a*t^2 + 2*half_b*t + c
+			Vec ox = load(rays.origin[0] + first) - center[0];
+			Vec oy = load(rays.origin[1] + first) - center[1];
+			Vec oz = load(rays.origin[2] + first) - center[2];
+			Vec dx = load(rays.direction[0] + first);
+			Vec dy = load(rays.direction[1] + first);
+			Vec dz = load(rays.direction[2] + first);
+			Vec a = dx*dx + dy*dy + dz*dz;
+			Vec half_b = dx*ox + dy*oy + dz*oz;
+			Vec c = ox*ox + oy*oy + oz*oz - radius*radius;
+			Vec discriminant = half_b*half_b - a*c;
+			Vec sqrtd = square_root(max_of(discriminant, broadcast(0)));
+
+			Vec lane_t_max = load(t_max + first);
+			Vec near_root = (-half_b - sqrtd) / a;
+			Vec far_root = (-half_b + sqrtd) / a;
+			VecMask near_hit = (t_min < near_root) & (near_root < lane_t_max);
+			VecMask far_hit = (t_min < far_root) & (far_root < lane_t_max);
+			store(t + first, near_hit ? near_root : far_root);
+			hits |= to_mask((discriminant >= 0) & (near_hit | far_hit), first);
+		}
+		return hits & active;
+	}
+
+	std::uint32_t packet_quad(const PacketRays& rays, const Kernels::QuadShape& quad, float_type t_min, const float_type* t_max,
+							  std::uint32_t active, float_type* t, float_type* alpha, float_type* beta)
+	{
+		constexpr float_type epsilon = 1e-8;	// as in Quad::hit, rays this parallel to the plane miss
+		std::uint32_t hits = 0;
+		for (int first = 0; first < packet_size; first += vec_lanes)
+		{
+			if (vector_active(active, first) == 0)
+				continue;
+			Vec origin[3], direction[3];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				origin[axis] = load(rays.origin[axis] + first);
+				direction[axis] = load(rays.direction[axis] + first);
+			}
+			Vec denominator = quad.normal[0]*direction[0] + quad.normal[1]*direction[1] + quad.normal[2]*direction[2];
+			Vec lane_t = (quad.D - (quad.normal[0]*origin[0] + quad.normal[1]*origin[1] + quad.normal[2]*origin[2])) / denominator;
+
+			// planar coordinates of the hit point: alpha = w . (p x v), beta = w . (u x p)
+			Vec p[3];
+			for (int axis = 0; axis < 3; ++axis)
+				p[axis] = origin[axis] + lane_t*direction[axis] - quad.Q[axis];
+			Vec lane_alpha = quad.w[0]*(p[1]*quad.v[2] - p[2]*quad.v[1]) + quad.w[1]*(p[2]*quad.v[0] - p[0]*quad.v[2])
+						   + quad.w[2]*(p[0]*quad.v[1] - p[1]*quad.v[0]);
+			Vec lane_beta = quad.w[0]*(quad.u[1]*p[2] - quad.u[2]*p[1]) + quad.w[1]*(quad.u[2]*p[0] - quad.u[0]*p[2])
+						  + quad.w[2]*(quad.u[0]*p[1] - quad.u[1]*p[0]);
+
+			store(t + first, lane_t);
+			store(alpha + first, lane_alpha);
+			store(beta + first, lane_beta);
+			VecMask hit = (absolute(denominator) >= epsilon) & (t_min <= lane_t) & (lane_t <= load(t_max + first))
+						& (lane_alpha >= 0) & (lane_alpha <= 1) & (lane_beta >= 0) & (lane_beta <= 1);
+			hits |= to_mask(hit, first);
+		}
+		return hits & active;
+	}
+
+	// As in Perlin::noise: trilinear interpolation of the gradients at the 8 lattice points around the point
+	float_type perlin_noise(const Kernels::PerlinTables& tables, float_type x, float_type y, float_type z)
+	{
+		float_type u = x - round_down(x);
+		float_type v = y - round_down(y);
+		float_type w = z - round_down(z);
+		int i = static_cast<int>(round_down(x));
+		int j = static_cast<int>(round_down(y));
+		int k = static_cast<int>(round_down(z));
+
+		//Hermite cubic to remove Mach bands
+		float_type uu = u*u*(3-2*u);
+		float_type vv = v*v*(3-2*v);
+		float_type ww = w*w*(3-2*w);
+
+		double accum = 0.0;
+		for (int di = 0; di < 2; ++di)
+		{
+			for (int dj = 0; dj < 2; ++dj)
+			{
+				for (int dk = 0; dk < 2; ++dk)
+				{
+					int index = tables.perm_x[(i+di) & 255] ^ tables.perm_y[(j+dj) & 255] ^ tables.perm_z[(k+dk) & 255];
+					const float_type* gradient = tables.vectors + static_cast<std::size_t>(index) * tables.vector_stride;
+					float_type dot = gradient[0]*(u-di) + gradient[1]*(v-dj) + gradient[2]*(w-dk);
+					accum += (di*uu + (1-di)*(1-uu)) * (dj*vv + (1-dj)*(1-vv)) * (dk*ww + (1-dk)*(1-ww)) * dot;
+				}
+			}
+		}
+		return static_cast<float_type>(accum);
+	}
+
+	float_type perlin_turbulence(const Kernels::PerlinTables& tables, float_type x, float_type y, float_type z, int depth)
+	{
+		float_type accum = 0;
+		float_type weight = 1;
+		for (int octave = 0; octave < depth; ++octave)
+		{
+			accum += weight*perlin_noise(tables, x, y, z);
+			weight *= .5;
+			x *= 2;
+			y *= 2;
+			z *= 2;
+		}
+		return accum < 0 ? -accum : accum;
+	}
+
+	// As in Color::write_pixel
+	void tonemap_row(const float_type* sums, std::size_t stride, std::size_t count, float_type scale, int* components)
+	{
+		for (std::size_t pixel = 0; pixel < count; ++pixel)
+		{
+			for (std::size_t c = 0; c < 3; ++c)
+			{
+				float_type gamma = square_root(scale * sums[pixel*stride + c]);
+				components[3*pixel + c] = static_cast<int>(gamma * (ColorConstants::max_pixel_val + .999));
+			}
+		}
+	}
+
+	constexpr Kernels::Table make_table(const char* name)
+	{
+		return Kernels::Table { name, packet_box, packet_sphere, packet_quad, perlin_turbulence, tonemap_row };
+	}
+}
+
+#endif
@@ -0,0 +1,5 @@
+// The kernels compiled for AVX2 and FMA. The compiler flags are set in CMakeLists.txt.
+#define KERNELS_VECTOR_BYTES 32
+#include "KernelsImpl.h"
+
+const Kernels::Table Kernels::avx2_table = make_table("avx2");
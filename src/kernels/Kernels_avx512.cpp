@@ -0,0 +1,5 @@
+// The kernels compiled for AVX-512 F and VL. The compiler flags are set in CMakeLists.txt.
+#define KERNELS_VECTOR_BYTES 64
+#include "KernelsImpl.h"
+
+const Kernels::Table Kernels::avx512_table = make_table("avx512");
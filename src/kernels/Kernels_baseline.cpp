@@ -0,0 +1,5 @@
+// The kernels compiled for the baseline instruction set of the target, which every machine that runs the binary supports.
+#define KERNELS_VECTOR_BYTES 16
+#include "KernelsImpl.h"
+
+const Kernels::Table Kernels::baseline_table = make_table("baseline");
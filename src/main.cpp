@@ -1,3 +1,5 @@
+#include <atomic>
+#include <csignal>
 #include <memory>
 #include <string>
 #include "ProcessArguments.h"
@@ -6,32 +8,162 @@
 #include "SceneInfo.h"
 #include "TimeFunction.h"
 #include "BVH.h"
+#include "Trace.h"
+#include "Random.h"
+#include "Kernels.h"
+#include "Distributed.h"
+#include "PartialRender.h"
+#include "RayTracer.h"
 
 //Scene Tag: defined in SceneInfo.h
 using Scene = ComplexCornellScene;
 
+//set by the first SIGINT, which cancels the render so that it writes what it has. the second one ends the program
+std::atomic<bool> interrupted {false};
+static_assert(std::atomic<bool>::is_always_lock_free, "the interrupt flag must be safe to set from a signal handler");
+
+extern "C" void interrupt(int) {
+    interrupted.store(true, std::memory_order_relaxed);
+    std::signal(SIGINT, SIG_DFL);
+}
+
 /**
- * @brief renders the scene Scene and writes the .ppm file information to filename
+ * @brief builds the world of the scene Scene inside a Bounding Volume Heirarchy
  * 
- * @param filename the .ppm filename that the scene will be written to
+ * @return HittableList the world
  */
-void render_scene(const std::string& filename) {
+HittableList build_world() {
     //get world info
-    HittableList world = make_world<Scene>();
+    HittableList world;
+    {
+        Trace::ScopedTimer timer {"make_world"};
+        world = make_world<Scene>();
+    }
 
     //make Bounding Volume Heirarchy
-    world = HittableList{std::make_shared<BVH_node>(world)};
+    {
+        Trace::ScopedTimer timer {"build_bvh"};
+        world = HittableList{std::make_shared<BVH_node>(world)};
+    }
+    return world;
+}
 
-    //render
+/**
+ * @brief renders tiles of the scene Scene for the coordinator at the options' worker address, until it shuts the worker down
+ * 
+ * @param options the options of the worker
+ */
+void serve_worker(const RenderOptions& options) {
+    Distributed::Worker worker {options.worker_address};
+    const Distributed::Hello& hello = worker.hello();
+    if (hello.width != CameraParameters<Scene>::image_width || hello.height != CameraParameters<Scene>::image_height) {
+        throw std::runtime_error("Error: the coordinator renders a different scene");
+    }
+    Random::seed(hello.seed);   //the same world and BVH as the coordinator's
+    HittableList world = build_world();
     Camera<Scene> camera {};
-    camera.render(world, filename);
+    RenderSettings settings;
+    settings.packets = hello.packets != 0;
+    settings.wavefront = hello.wavefront != 0;
+    AccumulationBuffer scratch {CameraParameters<Scene>::image_width, CameraParameters<Scene>::image_height};
+    worker.serve([&](const Distributed::TileJob& job, float_type* sums) {
+        camera.render_job(world, job, scratch, settings, sums);
+    });
+}
+
+/**
+ * @brief renders the scene Scene and writes the .ppm file information to the options' filename
+ * 
+ * @param options the options of the render, including the .ppm filename that the scene will be written to
+ */
+void render_scene(const RenderOptions& options) {
+    Trace::tile_spans_enabled = !options.trace_filename.empty();
+    if (options.isa) {
+        Kernels::select(*options.isa);
+    }
+    std::cout << "Kernels: " << Kernels::active().name << std::endl;
+    if (!options.worker_address.empty()) {
+        serve_worker(options);
+        return;
+    }
+    Trace::phase_spans_enabled = true;   //a single render, so its phases are summarized at its end
+    if (options.render_settings.seeded()) {
+        Random::seed(options.render_settings.seed);   //the world and BVH are built on this thread
+    }
+
+    HittableList world = build_world();
+
+    //render
+    {
+        Trace::ScopedTimer timer {"render"};
+        Camera<Scene> camera {};
+        RenderSettings settings = options.render_settings;
+        settings.cancel = &interrupted;
+        std::signal(SIGINT, interrupt);
+        if (options.scaling) {
+            //the same frame with 1 to n workers. each render starts its own workers, which build their own worlds
+            std::vector<double> seconds;
+            for (int workers = 1; workers <= options.render_settings.distribute.local_workers && !interrupted; ++workers) {
+                settings.distribute.local_workers = workers;
+                Stopwatch render_time;
+                camera.render(world, options.filename, settings);
+                seconds.push_back(render_time.elapsed_seconds());
+            }
+            Distributed::report_scaling(std::cout, seconds);
+        }
+        else {
+            camera.render(world, options.filename, settings);
+        }
+    }
+
+    Trace::report_phases(std::cout);
+    if (!options.trace_filename.empty()) {
+        Trace::write_chrome_json(options.trace_filename);
+    }
+}
+
+/**
+ * @brief merges the options' partial renders and writes the image to the options' filename
+ * 
+ * @param options the options of the merge
+ */
+void merge_partials(const MergeOptions& options) {
+    std::cout << "Kernels: " << Kernels::active().name << std::endl;
+    MergedRender merged {options.partial_filenames};
+    merged.write_image(options.filename);
+    std::cout << "Merged " << merged.partials() << " partial renders into " << options.filename << std::endl;
 }
 
 int main(int argc, char *argv[]) {
-    //process inputs to get filename
-    std::string filename = process_arguments(argc, argv);
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "merge") {
+        time_function(merge_partials, process_merge_arguments(argc, argv));
+        return 0;
+    }
+    if (command == "serve") {
+        ServeOptions options = process_serve_arguments(argc, argv);
+        RayTracer::serve(options.address, options.scene_capacity, options.texture_capacity, options.output_directory);
+        return 0;
+    }
+    if (command == "submit") {
+        if (argc < 4) {
+            throw std::invalid_argument(usage(argv[0]));
+        }
+        std::string request = argv[3];
+        for (int i = 4; i < argc; ++i) {
+            request += ' ' + std::string{argv[i]};
+        }
+        RayTracer::submit(argv[2], request, std::cout);
+        return 0;
+    }
+    //process inputs to get filename and render options
+    RenderOptions options = process_arguments(argc, argv);
+    //stdout carries the image, so reports go to stderr
+    if (options.render_settings.stream_target == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
     
-    time_function(render_scene, filename);
+    time_function(render_scene, options);
 
     return 0;
 }
\ No newline at end of file